@@ -0,0 +1,92 @@
+#include <vull/bench/bench.hh>
+#include <vull/container/vector.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/random.hh>
+#include <vull/platform/timer.hh>
+
+#include <malloc.h>
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+namespace {
+
+constexpr uint32_t k_frame_count = 2000;
+constexpr uint32_t k_long_lived_count = 20000;
+constexpr uint32_t k_spawn_count = 500;
+constexpr uint32_t k_max_lifetime = 120;
+
+struct Position {
+    VULL_DECLARE_COMPONENT(0);
+    float x, y, z;
+};
+
+struct Velocity {
+    VULL_DECLARE_COMPONENT(1);
+    float x, y, z;
+};
+
+struct Lifetime {
+    VULL_DECLARE_COMPONENT(2);
+    uint32_t frames_left;
+};
+
+double heap_mib() {
+    return static_cast<double>(mallinfo2().uordblks) / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+// Long-lived entities with short-lived projectiles spawned and expiring every frame, as a server would see. Recycling
+// the lowest free index should keep the entity array and sparse pages from growing past the peak live count.
+BENCHMARK_CASE(Entity, Churn) {
+    seed_rand(1234);
+    const auto baseline = heap_mib();
+    EntityManager manager;
+    manager.register_component<Position>();
+    manager.register_component<Velocity>();
+    manager.register_component<Lifetime>();
+    for (uint32_t i = 0; i < k_long_lived_count; i++) {
+        manager.create_entity().add<Position>(0.0f, 0.0f, 0.0f);
+    }
+
+    Vector<EntityId> expired;
+    double heap_high_water = 0.0;
+    uint32_t live_high_water = 0;
+    Timer timer;
+    for (uint32_t frame = 0; frame < k_frame_count; frame++) {
+        for (uint32_t i = 0; i < k_spawn_count; i++) {
+            auto entity = manager.create_entity();
+            entity.add<Position>(0.0f, 0.0f, 0.0f);
+            entity.add<Velocity>(1.0f, 0.0f, 0.0f);
+            entity.add<Lifetime>(vull::linear_rand(1u, k_max_lifetime));
+        }
+        for (auto [entity, position, velocity, lifetime] : manager.view<Position, const Velocity, Lifetime>()) {
+            position.x += velocity.x;
+            if (--lifetime.frames_left == 0) {
+                expired.push(entity);
+            }
+        }
+        for (const auto id : expired) {
+            manager.destroy_entity(id);
+        }
+        expired.clear();
+        heap_high_water = vull::max(heap_high_water, heap_mib() - baseline);
+        live_high_water = vull::max(live_high_water, manager.component_count<Position>());
+    }
+    report("frame", timer.elapsed_ns() / 1000.0 / k_frame_count, "us");
+    report("live high water", live_high_water, "entities");
+    report("heap high water", heap_high_water, "MiB");
+    report("heap", heap_mib() - baseline, "MiB");
+    report("Position memory", manager.component_memory_usage<Position>() / 1024.0, "KiB");
+    report("Velocity memory", manager.component_memory_usage<Velocity>() / 1024.0, "KiB");
+    report("Lifetime memory", manager.component_memory_usage<Lifetime>() / 1024.0, "KiB");
+
+    manager.compact();
+    report("heap after compact", heap_mib() - baseline, "MiB");
+}
@@ -0,0 +1,71 @@
+#include <vull/bench/bench.hh>
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/ecs/sparse_set.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/random.hh>
+#include <vull/platform/timer.hh>
+
+#include <malloc.h>
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+namespace {
+
+constexpr uint32_t k_entity_count = 1000000;
+constexpr uint32_t k_set_count = 30;
+constexpr uint32_t k_entities_per_set = 256;
+
+double heap_mib() {
+    return static_cast<double>(mallinfo2().uordblks) / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+// Thirty components each attached to a few hundred entities spread over a million entity indices. A flat sparse array
+// would cost a full array per component set, regardless of how few entities have the component.
+BENCHMARK_CASE(SparseSet, SparseMemory) {
+    seed_rand(1234);
+    const auto baseline = heap_mib();
+    Vector<SparseSet<EntityId>> sets(k_set_count);
+    Vector<EntityId> indices;
+    EntityId max_index = 0;
+    for (auto &set : sets) {
+        set.initialise<float>();
+        for (uint32_t i = 0; i < k_entities_per_set; i++) {
+            const auto index = vull::linear_rand(0u, k_entity_count - 1);
+            if (!set.contains(index)) {
+                set.emplace<float>(index, 1.0f);
+                indices.push(index);
+                max_index = vull::max(max_index, index);
+            }
+        }
+    }
+    report("heap", heap_mib() - baseline, "MiB");
+    const auto flat_bytes = static_cast<double>(k_set_count) * (max_index + 1) * sizeof(EntityId);
+    report("flat sparse arrays", flat_bytes / (1024.0 * 1024.0), "MiB");
+
+    // Probe every entity against every set, as a multi-component view would.
+    Timer timer;
+    uint32_t found = 0;
+    for (EntityId index = 0; index < k_entity_count; index++) {
+        for (const auto &set : sets) {
+            found += set.contains(index) ? 1 : 0;
+        }
+    }
+    const auto probe_count = static_cast<double>(k_entity_count) * k_set_count;
+    report("contains", probe_count / timer.elapsed() / 1000000.0, "M probes/s");
+    report("found", found, "entities");
+
+    // Pages should be freed once empty.
+    uint32_t next = 0;
+    for (auto &set : sets) {
+        while (!set.empty()) {
+            set.remove(indices[next++]);
+        }
+    }
+    report("heap after removal", heap_mib() - baseline, "MiB");
+}
@@ -0,0 +1,101 @@
+#include <vull/bench/bench.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/random.hh>
+#include <vull/platform/timer.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+namespace {
+
+constexpr uint32_t k_entity_count = 200000;
+constexpr uint32_t k_iteration_count = 20;
+
+struct Position {
+    VULL_DECLARE_COMPONENT(0);
+    float x, y, z;
+};
+
+struct Velocity {
+    VULL_DECLARE_COMPONENT(1);
+    float x, y, z;
+};
+
+struct Mass {
+    VULL_DECLARE_COMPONENT(2);
+    float mass;
+};
+
+// Every entity has a position, with a random half having a velocity and a random half of those having a mass, so that
+// the sets are shuffled relative to each other.
+void populate(EntityManager &manager, bool grouped) {
+    manager.register_component<Position>();
+    manager.register_component<Velocity>();
+    manager.register_component<Mass>();
+    if (grouped) {
+        manager.register_group<Position, Velocity, Mass>();
+    }
+    seed_rand(1234);
+    for (uint32_t i = 0; i < k_entity_count; i++) {
+        manager.create_entity();
+    }
+    for (uint32_t i = 0; i < k_entity_count; i++) {
+        const auto id = linear_rand(0u, k_entity_count - 1);
+        manager.add_component<Position>(i, 0.0f, 0.0f, 0.0f);
+        if (!manager.has_component<Velocity>(id)) {
+            manager.add_component<Velocity>(id, 1.0f, 1.0f, 1.0f);
+            if (i % 2 == 0) {
+                manager.add_component<Mass>(id, 2.0f);
+            }
+        }
+    }
+}
+
+void run_view(bool grouped) {
+    EntityManager manager;
+    populate(manager, grouped);
+    Timer timer;
+    uint32_t visited = 0;
+    for (uint32_t i = 0; i < k_iteration_count; i++) {
+        for (auto [entity, position, velocity, mass] : manager.view<Position, const Velocity, const Mass>()) {
+            position.x += velocity.x / mass.mass;
+            position.y += velocity.y / mass.mass;
+            position.z += velocity.z / mass.mass;
+            visited++;
+        }
+    }
+    report("entities", visited / k_iteration_count, "entities");
+    report("view", timer.elapsed_ns() / (1000000.0 * k_iteration_count), "ms");
+    report("Position memory", manager.component_memory_usage<Position>() / 1024.0, "KiB");
+    report("Velocity memory", manager.component_memory_usage<Velocity>() / 1024.0, "KiB");
+    report("Mass memory", manager.component_memory_usage<Mass>() / 1024.0, "KiB");
+}
+
+} // namespace
+
+BENCHMARK_CASE(EntityView, Single) {
+    EntityManager manager;
+    populate(manager, false);
+    Timer timer;
+    uint32_t visited = 0;
+    for (uint32_t i = 0; i < k_iteration_count; i++) {
+        for (auto [entity, position] : manager.view<Position>()) {
+            position.x += 1.0f;
+            visited++;
+        }
+    }
+    report("entities", visited / k_iteration_count, "entities");
+    report("view", timer.elapsed_ns() / (1000000.0 * k_iteration_count), "ms");
+}
+
+BENCHMARK_CASE(EntityView, Probe) {
+    run_view(false);
+}
+
+BENCHMARK_CASE(EntityView, Group) {
+    run_view(true);
+}
@@ -0,0 +1,89 @@
+#include <vull/bench/bench.hh>
+#include <vull/container/vector.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/world.hh>
+#include <vull/maths/random.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/span_stream.hh>
+#include <vull/support/stream.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+namespace {
+
+constexpr uint32_t k_entity_count = 200000;
+constexpr uint32_t k_iteration_count = 10;
+
+class VectorStream final : public Stream {
+    Vector<uint8_t, size_t> m_bytes;
+
+public:
+    Result<void, StreamError> write(Span<const void> data) override {
+        const auto offset = m_bytes.size();
+        m_bytes.ensure_size(offset + data.size());
+        memcpy(m_bytes.data() + offset, data.data(), data.size());
+        return {};
+    }
+
+    void clear() { m_bytes.clear(); }
+    Span<const void> span() const { return {m_bytes.data(), m_bytes.size()}; }
+};
+
+struct Position {
+    VULL_DECLARE_COMPONENT(0);
+    float x, y, z;
+};
+
+struct Velocity {
+    VULL_DECLARE_COMPONENT(1);
+    float x, y, z;
+};
+
+void register_components(World &world) {
+    world.register_component<Position>();
+    world.register_component<Velocity>();
+}
+
+} // namespace
+
+BENCHMARK_CASE(World, SerialiseDeserialise) {
+    seed_rand(1234);
+    VectorStream stream;
+    {
+        World world;
+        register_components(world);
+        for (uint32_t i = 0; i < k_entity_count; i++) {
+            auto entity = world.create_entity();
+            entity.add<Position>(0.0f, 0.0f, 0.0f);
+            if (linear_rand(0u, 1u) == 0) {
+                entity.add<Velocity>(1.0f, 1.0f, 1.0f);
+            }
+        }
+
+        Timer timer;
+        for (uint32_t i = 0; i < k_iteration_count; i++) {
+            stream.clear();
+            VULL_EXPECT(world.serialise(stream));
+        }
+        report("serialise", timer.elapsed_ns() / (1000000.0 * k_iteration_count), "ms");
+    }
+
+    const auto span = stream.span();
+    report("size", span.size() / (1024.0 * 1024.0), "MiB");
+    Timer timer;
+    for (uint32_t i = 0; i < k_iteration_count; i++) {
+        World world;
+        register_components(world);
+        SpanStream read_stream(span);
+        VULL_EXPECT(world.deserialise(read_stream));
+    }
+    report("deserialise", timer.elapsed_ns() / (1000000.0 * k_iteration_count), "ms");
+}
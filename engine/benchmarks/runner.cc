@@ -0,0 +1,131 @@
+#include <vull/bench/bench.hh>
+#include <vull/container/vector.hh>
+#include <vull/core/log.hh>
+#include <vull/platform/file.hh>
+#include <vull/platform/file_stream.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/algorithm.hh>
+#include <vull/support/args_parser.hh>
+#include <vull/support/result.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/utility.hh>
+
+#include <stdlib.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+// NOLINTBEGIN: these are defined by the linker
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wreserved-identifier"
+extern Benchmark __start_vull_bench_info;
+extern Benchmark __stop_vull_bench_info;
+#pragma clang diagnostic pop
+// NOLINTEND
+
+namespace vull::bench {
+
+VULL_GLOBAL(Benchmark *g_current_benchmark);
+
+} // namespace vull::bench
+
+namespace {
+
+void append_escaped(StringBuilder &sb, StringView string) {
+    for (char ch : string) {
+        if (ch == '"' || ch == '\\') {
+            sb.append('\\');
+        }
+        sb.append(ch);
+    }
+}
+
+struct BenchmarkResult {
+    const Benchmark *benchmark;
+    float time;
+};
+
+// Note that StringBuilder::append has no brace escaping, so literal braces go through extend.
+String build_json(const Vector<BenchmarkResult> &results) {
+    StringBuilder sb;
+    sb.extend(StringView("{\"benchmarks\":["));
+    for (bool first_benchmark = true; const auto &[benchmark, time] : results) {
+        if (!vull::exchange(first_benchmark, false)) {
+            sb.append(',');
+        }
+        sb.extend(StringView("\n{\"name\":\""));
+        append_escaped(sb, benchmark->name);
+        sb.append("\",\"time\":{},\"metrics\":[", time);
+        for (bool first_metric = true; const auto &metric : benchmark->metrics) {
+            if (!vull::exchange(first_metric, false)) {
+                sb.append(',');
+            }
+            sb.extend(StringView("{\"name\":\""));
+            append_escaped(sb, metric.name);
+            sb.append("\",\"value\":{},\"unit\":\"", metric.value);
+            append_escaped(sb, metric.unit);
+            sb.extend(StringView("\"}"));
+        }
+        sb.extend(StringView("]}"));
+    }
+    sb.extend(StringView("\n]}\n"));
+    return sb.build();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool list_benchmarks = false;
+    String json_path;
+    Vector<String> benchmark_filter;
+
+    ArgsParser args_parser("vull-bench", "Vull Benchmark Runner", "0.1.0");
+    args_parser.add_flag(list_benchmarks, "Print all known benchmarks", "list-benchmarks");
+    args_parser.add_option(json_path, "Write the results as JSON to the given path", "json");
+    args_parser.add_argument(benchmark_filter, "benchmark", false);
+    if (auto result = args_parser.parse_args(argc, argv); result != ArgsParseResult::Continue) {
+        return result == ArgsParseResult::ExitSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    const auto benchmarks = vull::make_range(&__start_vull_bench_info, &__stop_vull_bench_info);
+    if (list_benchmarks) {
+        for (const auto &benchmark : benchmarks) {
+            vull::println(benchmark.name);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    Vector<BenchmarkResult> results;
+    for (auto &benchmark : benchmarks) {
+        if (!benchmark_filter.empty() && !vull::contains(benchmark_filter, benchmark.name)) {
+            continue;
+        }
+
+        g_current_benchmark = &benchmark;
+        vull::println("RUN  {}", benchmark.name);
+        Timer timer;
+        benchmark.fn();
+        for (const auto &metric : benchmark.metrics) {
+            vull::println("     {}: {} {}", metric.name, metric.value, metric.unit);
+        }
+        const auto time = timer.elapsed();
+        vull::println("DONE {} in {} s", benchmark.name, time);
+        results.push({&benchmark, time});
+    }
+
+    if (!json_path.empty()) {
+        auto file = vull::open_file(json_path, OpenMode::Create | OpenMode::Truncate | OpenMode::Write);
+        if (file.is_error()) {
+            vull::println("Failed to open {}", json_path);
+            return EXIT_FAILURE;
+        }
+        auto stream = file.value().create_stream();
+        if (stream.write(build_json(results).view()).is_error()) {
+            vull::println("Failed to write {}", json_path);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+#include <vull/bench/bench.hh>
+#include <vull/maths/common.hh>
+#include <vull/platform/timer.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/tasklet/tasklet.hh>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+namespace {
+
+constexpr uint32_t k_burst_size = 4096;
+constexpr uint32_t k_burst_count = 8;
+constexpr uint32_t k_create_count = 500000;
+
+double resident_mib() {
+    // Second field of statm is the resident page count.
+    char buffer[128]{};
+    const int fd = open("/proc/self/statm", O_RDONLY);
+    if (fd < 0) {
+        return 0.0;
+    }
+    [[maybe_unused]] auto bytes_read = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+
+    char *end = nullptr;
+    strtoull(buffer, &end, 10);
+    const auto page_count = strtoull(end, nullptr, 10);
+    return static_cast<double>(page_count * static_cast<uint64_t>(getpagesize())) / (1024.0 * 1024.0);
+}
+
+// Runs bursts of many tasklets which are all alive at once, with every deep_interval-th tasklet (if non-zero) using a lot
+// more stack than the rest, and reports the resident memory at the peak and once idle.
+void run_bursts(uint32_t deep_interval) {
+    const auto baseline = resident_mib();
+    double peak = 0.0;
+    {
+        Scheduler scheduler;
+        scheduler.start([&] {
+            for (uint32_t burst = 0; burst < k_burst_count; burst++) {
+                Latch started(k_burst_size);
+                Latch release(1);
+                Latch done(k_burst_size);
+                for (uint32_t i = 0; i < k_burst_size; i++) {
+                    vull::schedule([&, deep = deep_interval != 0 && i % deep_interval == 0] {
+                        // Touch some of the stack, as a real tasklet would.
+                        volatile uint8_t scratch[8192];
+                        for (uint32_t j = 0; j < sizeof(scratch); j += 4096) {
+                            scratch[j] = 1;
+                        }
+                        if (deep) {
+                            volatile uint8_t deep_scratch[196608];
+                            for (uint32_t j = 0; j < sizeof(deep_scratch); j += 4096) {
+                                deep_scratch[j] = 1;
+                            }
+                        }
+                        started.count_down();
+                        release.wait();
+                        done.count_down();
+                    });
+                }
+                started.wait();
+                peak = vull::max(peak, resident_mib());
+                release.count_down();
+                done.wait();
+            }
+            scheduler.stop();
+        });
+    }
+    report("peak resident", peak - baseline, "MiB");
+    report("resident after bursts", resident_mib() - baseline, "MiB");
+}
+
+} // namespace
+
+// Once the workers go idle, the resident memory should fall back towards the resident limit rather than staying at the
+// peak.
+BENCHMARK_CASE(TaskletAllocator, Burst) {
+    run_bursts(0);
+}
+
+// Stack grown by the occasional deep tasklet should be given back when it finishes, rather than staying resident in the
+// pooled stacks.
+BENCHMARK_CASE(TaskletAllocator, DeepBurst) {
+    run_bursts(16);
+}
+
+// Create and immediately finish tasklets one after the other, which should stay within the per-thread magazines.
+BENCHMARK_CASE(TaskletAllocator, CreateThroughput) {
+    float elapsed = 0.0f;
+    {
+        Scheduler scheduler;
+        scheduler.start([&] {
+            Timer timer;
+            Latch latch(k_create_count);
+            for (uint32_t i = 0; i < k_create_count; i++) {
+                vull::schedule([&] {
+                    latch.count_down();
+                });
+            }
+            latch.wait();
+            elapsed = timer.elapsed();
+            scheduler.stop();
+        });
+    }
+    report("throughput", k_create_count / elapsed, "tasklets/s");
+}
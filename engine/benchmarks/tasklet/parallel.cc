@@ -0,0 +1,82 @@
+#include <vull/bench/bench.hh>
+#include <vull/container/fixed_buffer.hh>
+#include <vull/maths/common.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/tasklet/parallel.hh>
+#include <vull/tasklet/scheduler.hh>
+
+#include <stdint.h>
+#include <unistd.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+namespace {
+
+constexpr uint32_t k_element_count = 1u << 20u;
+constexpr uint32_t k_grain = 1024;
+
+float simulate_work(uint32_t index) {
+    float value = static_cast<float>(index);
+    for (uint32_t i = 0; i < 32; i++) {
+        value = value * 0.5f + 1.0f / (value + 1.0f);
+    }
+    return value;
+}
+
+// Runs fn on schedulers of 1 to N workers, where N is the number of cores (but at least 2), and reports the elapsed
+// time of each relative to a single worker. A plain loop outside of the scheduler is also timed as a baseline.
+template <typename F>
+void run_scaling(F &&fn) {
+    Timer serial_timer;
+    fn();
+    report("serial", serial_timer.elapsed() * 1000.0f, "ms");
+
+    const auto max_worker_count = vull::max(static_cast<uint32_t>(sysconf(_SC_NPROCESSORS_ONLN)), 2u);
+    float single_elapsed = 0.0f;
+    for (uint32_t worker_count = 1; worker_count <= max_worker_count; worker_count *= 2) {
+        float elapsed = 0.0f;
+        {
+            Scheduler scheduler(worker_count);
+            scheduler.start([&] {
+                // Warm up the tasklet allocator first.
+                fn();
+                Timer timer;
+                fn();
+                elapsed = timer.elapsed();
+                scheduler.stop();
+            });
+        }
+        if (worker_count == 1) {
+            single_elapsed = elapsed;
+        }
+        report(vull::format("{} workers", worker_count), elapsed * 1000.0f, "ms");
+        report(vull::format("{} workers speedup", worker_count), single_elapsed / elapsed, "x");
+    }
+}
+
+} // namespace
+
+BENCHMARK_CASE(Parallel, ForScaling) {
+    auto output = FixedBuffer<float>::create_uninitialised(k_element_count);
+    run_scaling([&] {
+        vull::parallel_for(0, k_element_count, k_grain, [&](uint32_t index) {
+            output[index] = simulate_work(index);
+        });
+    });
+}
+
+BENCHMARK_CASE(Parallel, ReduceScaling) {
+    volatile float sink = 0.0f;
+    run_scaling([&] {
+        sink = vull::parallel_reduce<float>(
+            0, k_element_count, k_grain,
+            [](float &sum, uint32_t index) {
+                sum += simulate_work(index);
+            },
+            [](float &sum, float &&other) {
+                sum += other;
+            });
+    });
+}
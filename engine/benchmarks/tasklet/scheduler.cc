@@ -0,0 +1,147 @@
+#include <vull/bench/bench.hh>
+#include <vull/container/vector.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/tasklet/tasklet.hh>
+
+#include <sched.h>
+#include <stdint.h>
+#include <sys/resource.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+namespace {
+
+constexpr uint32_t k_task_count = 200000;
+constexpr uint32_t k_producer_count = 64;
+
+// The steal batch limits to compare, where one is the classic steal-one behaviour.
+constexpr uint32_t k_steal_limits[]{1, 32};
+
+void simulate_work() {
+    volatile uint32_t value = 0;
+    for (uint32_t i = 0; i < 256; i++) {
+        value = value + i;
+    }
+}
+
+uint64_t context_switch_count() {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_nvcsw);
+}
+
+void report_syscalls(StringView prefix, const SchedulerStats &stats, uint64_t context_switches) {
+    const auto scheduled_count = static_cast<double>(stats.scheduled_count);
+    const auto syscall_count = static_cast<double>(stats.park_syscall_count + stats.wake_syscall_count);
+    report(vull::format("{}syscalls", prefix), syscall_count / scheduled_count, "per task");
+    report(vull::format("{}context switches", prefix), static_cast<double>(context_switches) / scheduled_count,
+           "per task");
+}
+
+template <typename F>
+void run_scheduler(uint32_t steal_limit, F &&fn) {
+    const auto switches_before = context_switch_count();
+    SchedulerStats stats{};
+    {
+        Scheduler scheduler;
+        scheduler.set_steal_batch_limit(steal_limit);
+        scheduler.start([&] {
+            fn();
+            stats = scheduler.stats();
+            scheduler.stop();
+        });
+    }
+    report_syscalls(vull::format("steal {} ", steal_limit), stats, context_switch_count() - switches_before);
+}
+
+void report_run(uint32_t steal_limit, float elapsed, Vector<uint64_t> &latencies) {
+    report(vull::format("steal {} throughput", steal_limit), k_task_count / elapsed, "tasks/s");
+    report_distribution(vull::format("steal {} latency", steal_limit), latencies, "ns");
+}
+
+} // namespace
+
+// A single tasklet scheduling everything, so that all other workers must steal to get any work.
+BENCHMARK_CASE(Scheduler, FanOut) {
+    for (uint32_t steal_limit : k_steal_limits) {
+        Vector<uint64_t> latencies(k_task_count);
+        float elapsed = 0.0f;
+        run_scheduler(steal_limit, [&] {
+            Latch latch(k_task_count);
+            Timer timer;
+            for (uint32_t i = 0; i < k_task_count; i++) {
+                vull::schedule([&, i, scheduled_at = timer.elapsed_ns()] {
+                    latencies[i] = timer.elapsed_ns() - scheduled_at;
+                    simulate_work();
+                    latch.count_down();
+                });
+            }
+            latch.wait();
+            elapsed = timer.elapsed();
+        });
+        report_run(steal_limit, elapsed, latencies);
+    }
+}
+
+// Many producers each scheduling a share of the work, all joining on a single latch.
+BENCHMARK_CASE(Scheduler, FanIn) {
+    for (uint32_t steal_limit : k_steal_limits) {
+        Vector<uint64_t> latencies(k_task_count);
+        float elapsed = 0.0f;
+        run_scheduler(steal_limit, [&] {
+            Latch latch(k_task_count);
+            Timer timer;
+            for (uint32_t producer = 0; producer < k_producer_count; producer++) {
+                vull::schedule([&, producer] {
+                    constexpr uint32_t per_producer = k_task_count / k_producer_count;
+                    for (uint32_t i = producer * per_producer; i < (producer + 1) * per_producer; i++) {
+                        vull::schedule([&, i, scheduled_at = timer.elapsed_ns()] {
+                            latencies[i] = timer.elapsed_ns() - scheduled_at;
+                            simulate_work();
+                            latch.count_down();
+                        });
+                    }
+                });
+            }
+            latch.wait();
+            elapsed = timer.elapsed();
+        });
+        report_run(steal_limit, elapsed, latencies);
+    }
+}
+
+// Work submitted from a thread which isn't a worker, going through the injection queue.
+BENCHMARK_CASE(Scheduler, Inject) {
+    Vector<uint64_t> latencies(k_task_count);
+    Latch latch(k_task_count);
+    const auto switches_before = context_switch_count();
+    Scheduler scheduler;
+    scheduler.start([&] {
+        latch.wait();
+        scheduler.stop();
+    });
+
+    Timer timer;
+    for (uint32_t i = 0; i < k_task_count; i++) {
+        const auto scheduled_at = timer.elapsed_ns();
+        while (!scheduler.inject([&, i, scheduled_at] {
+            latencies[i] = timer.elapsed_ns() - scheduled_at;
+            simulate_work();
+            latch.count_down();
+        })) {
+            sched_yield();
+        }
+    }
+    while (!latch.try_wait()) {
+        sched_yield();
+    }
+    report("throughput", k_task_count / timer.elapsed(), "tasks/s");
+    report_distribution("latency", latencies, "ns");
+    report_syscalls("", scheduler.stats(), context_switch_count() - switches_before);
+}
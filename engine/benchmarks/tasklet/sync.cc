@@ -0,0 +1,134 @@
+#include <vull/bench/bench.hh>
+#include <vull/container/array.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/scoped_lock.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/mutex.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/tasklet/semaphore.hh>
+#include <vull/tasklet/shared_mutex.hh>
+#include <vull/tasklet/tasklet.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+namespace {
+
+constexpr uint32_t k_tasklet_count = 64;
+constexpr uint32_t k_operation_count = 20000;
+// One in every k_write_interval operations is a write.
+constexpr uint32_t k_write_interval = 128;
+constexpr uint32_t k_table_size = 256;
+constexpr uint64_t k_wait_ns = 2000;
+
+struct Table {
+    Array<uint32_t, k_table_size> values{};
+
+    uint32_t read(uint32_t seed) const {
+        // Occasionally wait whilst holding the lock, as a tasklet waiting on I/O would. Other readers can only overlap
+        // their waits with this one if the lock is shared.
+        if (seed % 8 == 0) {
+            Timer timer;
+            while (timer.elapsed_ns() < k_wait_ns) {
+                vull::pump_work();
+            }
+        }
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < k_table_size; i += 4) {
+            sum += values[(seed + i) % k_table_size];
+        }
+        return sum;
+    }
+    void write(uint32_t seed) { values[seed % k_table_size]++; }
+};
+
+// Runs a read-mostly workload across many tasklets. The operation is expected to take the lock itself.
+template <typename F>
+float run_read_mostly(F operation) {
+    float elapsed = 0.0f;
+    {
+        Scheduler scheduler;
+        scheduler.start([&] {
+            Timer timer;
+            Latch latch(k_tasklet_count);
+            for (uint32_t i = 0; i < k_tasklet_count; i++) {
+                vull::schedule([&, i] {
+                    volatile uint32_t sink = 0;
+                    for (uint32_t j = 0; j < k_operation_count / k_tasklet_count; j++) {
+                        sink = sink + operation(i * 7919 + j, j % k_write_interval == 0);
+                        if (j % 64 == 0) {
+                            vull::pump_work();
+                        }
+                    }
+                    latch.count_down();
+                });
+            }
+            latch.wait();
+            elapsed = timer.elapsed();
+            scheduler.stop();
+        });
+    }
+    return elapsed;
+}
+
+} // namespace
+
+BENCHMARK_CASE(Sync, ReadMostlyMutex) {
+    Mutex mutex;
+    Table table;
+    const auto elapsed = run_read_mostly([&](uint32_t seed, bool write) {
+        ScopedLock lock(mutex);
+        if (write) {
+            table.write(seed);
+            return 0u;
+        }
+        return table.read(seed);
+    });
+    report("throughput", k_operation_count / elapsed, "ops/s");
+}
+
+BENCHMARK_CASE(Sync, ReadMostlySharedMutex) {
+    SharedMutex mutex;
+    Table table;
+    const auto elapsed = run_read_mostly([&](uint32_t seed, bool write) {
+        if (write) {
+            ScopedLock lock(mutex);
+            table.write(seed);
+            return 0u;
+        }
+        SharedScopedLock lock(mutex);
+        return table.read(seed);
+    });
+    report("throughput", k_operation_count / elapsed, "ops/s");
+}
+
+// Many tasklets funnelled through a small number of permits.
+BENCHMARK_CASE(Sync, Semaphore) {
+    float elapsed = 0.0f;
+    {
+        Scheduler scheduler;
+        scheduler.start([&] {
+            Semaphore semaphore(4);
+            Timer timer;
+            Latch latch(k_tasklet_count);
+            for (uint32_t i = 0; i < k_tasklet_count; i++) {
+                vull::schedule([&] {
+                    for (uint32_t j = 0; j < k_operation_count / k_tasklet_count; j++) {
+                        semaphore.acquire();
+                        if (j % 64 == 0) {
+                            vull::pump_work();
+                        }
+                        semaphore.release();
+                    }
+                    latch.count_down();
+                });
+            }
+            latch.wait();
+            elapsed = timer.elapsed();
+            scheduler.stop();
+        });
+    }
+    report("throughput", k_operation_count / elapsed, "acquires/s");
+}
@@ -0,0 +1,130 @@
+#include <vull/bench/bench.hh>
+#include <vull/container/vector.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/world.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/random.hh>
+#include <vull/platform/file.hh>
+#include <vull/platform/file_stream.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/result.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/vpak/reader.hh>
+#include <vull/vpak/writer.hh>
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+namespace {
+
+constexpr uint32_t k_entity_count = 200000;
+constexpr uint32_t k_texture_size = 8u * 1024u * 1024u;
+constexpr uint32_t k_iteration_count = 10;
+
+struct Position {
+    VULL_DECLARE_COMPONENT(0);
+    float x, y, z;
+};
+
+struct Health {
+    VULL_DECLARE_COMPONENT(1);
+    uint32_t value;
+
+    // Serialised field by field so that deserialising goes through the small read path.
+    static Health deserialise(Stream &stream) { return {VULL_EXPECT(stream.read_varint<uint32_t>())}; }
+    static void serialise(Health &health, Stream &stream) { VULL_EXPECT(stream.write_varint(health.value)); }
+};
+
+void register_components(World &world) {
+    world.register_component<Position>();
+    world.register_component<Health>();
+}
+
+} // namespace
+
+BENCHMARK_CASE(VpakReader, ReadWorld) {
+    seed_rand(1234);
+    auto file = File::from_fd(memfd_create("vull-bench", 0));
+    {
+        vpak::Writer writer(vull::make_unique<FileStream>(file.create_stream()), vpak::CompressionLevel::Fast);
+        World world;
+        register_components(world);
+        for (uint32_t i = 0; i < k_entity_count; i++) {
+            auto entity = world.create_entity();
+            entity.add<Position>(linear_rand(0.0f, 1.0f), 0.0f, 0.0f);
+            entity.add<Health>(linear_rand(0u, 1000u));
+        }
+        VULL_EXPECT(world.serialise(writer, "world"));
+        writer.finish();
+    }
+
+    vpak::Reader reader(vull::move(file));
+    Timer timer;
+    for (uint32_t i = 0; i < k_iteration_count; i++) {
+        World world;
+        register_components(world);
+        auto stream = reader.open("world");
+        VULL_EXPECT(world.deserialise(*stream));
+    }
+    report("read", timer.elapsed_ns() / (1000000.0 * k_iteration_count), "ms");
+    report("size", reader.stat("world")->size / (1024.0 * 1024.0), "MiB");
+}
+
+BENCHMARK_CASE(VpakReader, ReadTexture) {
+    // 16 byte blocks, half of which repeat an earlier block, to be roughly as compressible as BC7 data.
+    seed_rand(1234);
+    Vector<uint8_t> texture;
+    texture.ensure_size(k_texture_size);
+    for (uint32_t block = 0; block < k_texture_size / 16; block++) {
+        auto *data = texture.data() + block * 16;
+        if (block >= 256 && linear_rand(0u, 1u) == 0) {
+            memcpy(data, data - linear_rand(1u, 256u) * 16, 16);
+            continue;
+        }
+        for (uint32_t i = 0; i < 16; i++) {
+            data[i] = static_cast<uint8_t>(linear_rand(0u, 255u));
+        }
+    }
+
+    auto file = File::from_fd(memfd_create("vull-bench", 0));
+    {
+        vpak::Writer writer(vull::make_unique<FileStream>(file.create_stream()), vpak::CompressionLevel::Normal);
+        auto entry = writer.start_entry("texture", vpak::EntryType::Image, true);
+        VULL_EXPECT(entry.write(texture.span()));
+        report("ratio", entry.finish(), "%");
+        writer.finish();
+    }
+
+    vpak::Reader reader(vull::move(file));
+    const auto entry = *reader.stat("texture");
+    Timer serial_timer;
+    auto stream = reader.open("texture");
+    VULL_EXPECT(stream->read(texture.span()));
+    const auto serial_elapsed = serial_timer.elapsed();
+    report("serial", serial_elapsed * 1000.0f, "ms");
+
+    const auto max_worker_count = vull::max(static_cast<uint32_t>(sysconf(_SC_NPROCESSORS_ONLN)), 2u);
+    for (uint32_t worker_count = 1; worker_count <= max_worker_count; worker_count *= 2) {
+        float elapsed = 0.0f;
+        {
+            Scheduler scheduler(worker_count);
+            scheduler.start([&] {
+                Timer timer;
+                VULL_EXPECT(reader.read_entry_parallel(entry, texture.span()));
+                elapsed = timer.elapsed();
+                scheduler.stop();
+            });
+        }
+        report(vull::format("{} workers", worker_count), elapsed * 1000.0f, "ms");
+        report(vull::format("{} workers speedup", worker_count), serial_elapsed / elapsed, "x");
+    }
+}
@@ -0,0 +1,83 @@
+#include <vull/bench/bench.hh>
+#include <vull/container/vector.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/random.hh>
+#include <vull/platform/file.hh>
+#include <vull/platform/file_stream.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/result.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/vpak/pack_file.hh>
+#include <vull/vpak/writer.hh>
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace vull;
+using namespace vull::bench;
+
+namespace {
+
+constexpr uint32_t k_texture_size = 2u * 1024u * 1024u;
+
+// 16 byte blocks, half of which repeat an earlier block, to be roughly as compressible as BC7 data.
+Vector<uint8_t> make_texture() {
+    seed_rand(1234);
+    Vector<uint8_t> texture;
+    texture.ensure_size(k_texture_size);
+    for (uint32_t block = 0; block < k_texture_size / 16; block++) {
+        auto *data = texture.data() + block * 16;
+        if (block >= 256 && linear_rand(0u, 1u) == 0) {
+            memcpy(data, data - linear_rand(1u, 256u) * 16, 16);
+            continue;
+        }
+        for (uint32_t i = 0; i < 16; i++) {
+            data[i] = static_cast<uint8_t>(linear_rand(0u, 255u));
+        }
+    }
+    return texture;
+}
+
+float write_texture(const Vector<uint8_t> &texture, bool seekable, uint32_t zstd_worker_count = 0) {
+    auto file = File::from_fd(memfd_create("vull-bench", 0));
+    vpak::Writer writer(vull::make_unique<FileStream>(file.create_stream()), vpak::CompressionLevel::Normal);
+    writer.set_zstd_worker_count(zstd_worker_count);
+    Timer timer;
+    auto entry = writer.start_entry("texture", vpak::EntryType::Image, seekable);
+    VULL_EXPECT(entry.write(texture.span()));
+    entry.finish();
+    const auto elapsed = timer.elapsed();
+    writer.finish();
+    return elapsed;
+}
+
+} // namespace
+
+BENCHMARK_CASE(VpakWriter, CompressTexture) {
+    const auto texture = make_texture();
+    const auto serial_elapsed = write_texture(texture, true);
+    report("serial", serial_elapsed * 1000.0f, "ms");
+
+    const auto max_worker_count = vull::max(static_cast<uint32_t>(sysconf(_SC_NPROCESSORS_ONLN)), 2u);
+    for (uint32_t worker_count = 1; worker_count <= max_worker_count; worker_count *= 2) {
+        float elapsed = 0.0f;
+        {
+            Scheduler scheduler(worker_count);
+            scheduler.start([&] {
+                elapsed = write_texture(texture, true);
+                scheduler.stop();
+            });
+        }
+        report(vull::format("{} workers", worker_count), elapsed * 1000.0f, "ms");
+        report(vull::format("{} workers speedup", worker_count), serial_elapsed / elapsed, "x");
+    }
+
+    // The single frame of a non-seekable entry can only be split up by zstd itself.
+    report("zstd single thread", write_texture(texture, false) * 1000.0f, "ms");
+    report(vull::format("zstd {} threads", max_worker_count), write_texture(texture, false, max_worker_count) * 1000.0f,
+           "ms");
+}
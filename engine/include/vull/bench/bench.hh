@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vull/container/vector.hh>
+#include <vull/support/algorithm.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/utility.hh>
+
+#include <stdint.h>
+
+namespace vull::bench {
+
+struct Metric {
+    String name;
+    double value;
+    StringView unit;
+};
+
+struct Benchmark {
+    const char *name;
+    void (*fn)();
+    Vector<Metric> metrics;
+};
+
+extern Benchmark *g_current_benchmark;
+
+inline void report(StringView name, double value, StringView unit) {
+    g_current_benchmark->metrics.push({String(name), value, unit});
+}
+
+// Sorts the given samples and reports the median, tail percentiles and maximum.
+template <typename T>
+void report_distribution(StringView name, Vector<T> &samples, StringView unit) {
+    if (samples.empty()) {
+        return;
+    }
+    vull::sort(samples, [](const T &lhs, const T &rhs) {
+        return lhs > rhs;
+    });
+    const auto percentile = [&](uint32_t per_mille) {
+        const auto index = static_cast<uint32_t>((static_cast<uint64_t>(samples.size() - 1) * per_mille) / 1000);
+        return static_cast<double>(samples[index]);
+    };
+    report(vull::format("{} p50", name), percentile(500), unit);
+    report(vull::format("{} p99", name), percentile(990), unit);
+    report(vull::format("{} p99.9", name), percentile(999), unit);
+    report(vull::format("{} max", name), static_cast<double>(samples.last()), unit);
+}
+
+} // namespace vull::bench
+
+#define BENCHMARK_CASE(suite_, case_)                                                                                  \
+    static void suite_##_##case_();                                                                                    \
+    [[gnu::section("vull_bench_info"), gnu::used]] VULL_GLOBAL(                                                        \
+        vull::bench::Benchmark g_##suite_##_##case_##_descriptor){                                                     \
+        .name = #suite_ "." #case_,                                                                                    \
+        .fn = &(suite_##_##case_),                                                                                     \
+    };                                                                                                                 \
+    static void suite_##_##case_()
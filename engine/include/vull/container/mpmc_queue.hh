@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vull/container/array.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/optional.hh> // IWYU pragma: keep
+#include <vull/support/utility.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+// Bounded multi-producer multi-consumer queue, based on https://www.1024cores.net/home/lock-free-algorithms/queues/
+// bounded-mpmc-queue. Each slot has a sequence number which tells producers and consumers whose turn it is.
+template <typename T, unsigned SlotCountShift = 10>
+class MpmcQueue {
+    // Don't wrap pointers in Optional.
+    using RetType = conditional<is_ptr<T>, T, Optional<T>>;
+
+    static constexpr uint32_t k_slot_count = 1u << SlotCountShift;
+    struct Slot {
+        Atomic<uint32_t> sequence;
+        T value{};
+    };
+    Array<Slot, k_slot_count> m_slots{};
+
+    // Keep the indices on separate cache lines to avoid false sharing between producers and consumers.
+    alignas(64) Atomic<uint32_t> m_enqueue_index;
+    alignas(64) Atomic<uint32_t> m_dequeue_index;
+
+public:
+    MpmcQueue();
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue(MpmcQueue &&) = delete;
+    ~MpmcQueue() = default;
+
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(MpmcQueue &&) = delete;
+
+    [[nodiscard]] bool enqueue(T elem);
+    RetType dequeue();
+
+    // Only a snapshot, may be immediately out of date.
+    bool empty() const;
+};
+
+template <typename T, unsigned SlotCountShift>
+MpmcQueue<T, SlotCountShift>::MpmcQueue() {
+    for (uint32_t i = 0; i < k_slot_count; i++) {
+        m_slots[i].sequence.store(i, vull::memory_order_relaxed);
+    }
+}
+
+template <typename T, unsigned SlotCountShift>
+[[nodiscard]] bool MpmcQueue<T, SlotCountShift>::enqueue(T elem) {
+    uint32_t index = m_enqueue_index.load(vull::memory_order_relaxed);
+    while (true) {
+        auto &slot = m_slots[index % k_slot_count];
+        const uint32_t sequence = slot.sequence.load(vull::memory_order_acquire);
+        const auto difference = static_cast<int32_t>(sequence - index);
+        if (difference == 0) {
+            // Slot is free, try to claim it.
+            if (m_enqueue_index.compare_exchange_weak(index, index + 1, vull::memory_order_relaxed)) {
+                slot.value = vull::move(elem);
+                slot.sequence.store(index + 1, vull::memory_order_release);
+                return true;
+            }
+        } else if (difference < 0) {
+            // Slot still holds an element from the previous lap, queue is full.
+            return false;
+        } else {
+            // Another producer claimed the slot.
+            index = m_enqueue_index.load(vull::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T, unsigned SlotCountShift>
+typename MpmcQueue<T, SlotCountShift>::RetType MpmcQueue<T, SlotCountShift>::dequeue() {
+    uint32_t index = m_dequeue_index.load(vull::memory_order_relaxed);
+    while (true) {
+        auto &slot = m_slots[index % k_slot_count];
+        const uint32_t sequence = slot.sequence.load(vull::memory_order_acquire);
+        const auto difference = static_cast<int32_t>(sequence - (index + 1));
+        if (difference == 0) {
+            if (m_dequeue_index.compare_exchange_weak(index, index + 1, vull::memory_order_relaxed)) {
+                T elem = vull::move(slot.value);
+                slot.sequence.store(index + k_slot_count, vull::memory_order_release);
+                return elem;
+            }
+        } else if (difference < 0) {
+            // Slot not yet written, queue is empty.
+            return {};
+        } else {
+            index = m_dequeue_index.load(vull::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T, unsigned SlotCountShift>
+bool MpmcQueue<T, SlotCountShift>::empty() const {
+    const uint32_t index = m_dequeue_index.load(vull::memory_order_relaxed);
+    const uint32_t sequence = m_slots[index % k_slot_count].sequence.load(vull::memory_order_acquire);
+    return static_cast<int32_t>(sequence - (index + 1)) < 0;
+}
+
+} // namespace vull
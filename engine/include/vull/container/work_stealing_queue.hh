@@ -1,30 +1,46 @@
 #pragma once
 
 #include <vull/container/array.hh>
+#include <vull/maths/common.hh>
 #include <vull/support/atomic.hh>
 #include <vull/support/optional.hh> // IWYU pragma: keep
+#include <vull/support/span.hh>
 #include <vull/support/utility.hh>
 
 #include <stdint.h>
 
 namespace vull {
 
-// https://fzn.fr/readings/ppopp13.pdf
+// https://fzn.fr/readings/ppopp13.pdf, extended to allow thieves to take half of the queue at once. To make that safe,
+// the head and tail indices are packed into a single word along with a tag which is bumped on every dequeue and steal,
+// so a thief's claim of a range always fails if anything was removed from underneath it.
 template <typename T, unsigned SlotCountShift = 10>
 class WorkStealingQueue {
+    static_assert(SlotCountShift < 16, "Indices must fit in 16 bits");
+
     // Don't wrap pointers in Optional.
     using RetType = conditional<is_ptr<T>, T, Optional<T>>;
 
     // Max size of the queue, should be a power of two to allow modulo operations to be transformed into cheaper ands.
-    static constexpr int64_t k_slot_count = 1ul << SlotCountShift;
+    static constexpr uint32_t k_slot_count = 1u << SlotCountShift;
     Array<Atomic<T>, k_slot_count> m_slots{};
-    Atomic<int64_t> m_head;
-    Atomic<int64_t> m_tail;
+
+    // Packed as [head:16][tail:16][tag:32], so that the owner can push with a single add to the head.
+    Atomic<uint64_t> m_state;
+
+    static uint16_t head_of(uint64_t state) { return static_cast<uint16_t>(state >> 48u); }
+    static uint16_t tail_of(uint64_t state) { return static_cast<uint16_t>(state >> 32u); }
+    static uint32_t tag_of(uint64_t state) { return static_cast<uint32_t>(state); }
+    static uint32_t size_of(uint64_t state) { return static_cast<uint16_t>(head_of(state) - tail_of(state)); }
+    static uint64_t pack(uint32_t head, uint32_t tail, uint32_t tag) {
+        return (static_cast<uint64_t>(head & 0xffffu) << 48u) | (static_cast<uint64_t>(tail & 0xffffu) << 32u) | tag;
+    }
 
 public:
     [[nodiscard]] bool enqueue(T elem);
     RetType dequeue();
     RetType steal();
+    uint32_t steal_batch(Span<T> buffer);
 
     bool empty() const;
     uint64_t size() const;
@@ -32,78 +48,75 @@ public:
 
 template <typename T, unsigned SlotCountShift>
 [[nodiscard]] bool WorkStealingQueue<T, SlotCountShift>::enqueue(T elem) {
-    int64_t head = m_head.load(vull::memory_order_relaxed);
-    int64_t tail = m_tail.load(vull::memory_order_acquire);
+    const uint64_t state = m_state.load(vull::memory_order_acquire);
 
     // Queue is already full.
-    if (head - tail >= k_slot_count) {
+    if (size_of(state) >= k_slot_count) {
         return false;
     }
 
-    // Store element in slot and bump the head index.
-    m_slots[static_cast<uint32_t>(head % k_slot_count)].store(elem);
-    vull::atomic_thread_fence(vull::memory_order_release);
-    m_head.store(head + 1, vull::memory_order_relaxed);
+    // Store element in slot and bump the head index. Only the owner touches the head, and the slot can't be in use by a
+    // thief since it's outside of [tail, head).
+    m_slots[head_of(state) % k_slot_count].store(elem, vull::memory_order_relaxed);
+    m_state.fetch_add(1ull << 48u, vull::memory_order_release);
     return true;
 }
 
 template <typename T, unsigned SlotCountShift>
 typename WorkStealingQueue<T, SlotCountShift>::RetType WorkStealingQueue<T, SlotCountShift>::dequeue() {
-    int64_t index = m_head.fetch_sub(1, vull::memory_order_relaxed) - 1;
-    vull::atomic_thread_fence(vull::memory_order_seq_cst);
-    int64_t tail = m_tail.load(vull::memory_order_relaxed);
-
-    // If the queue is empty, restore the head index and return nothing.
-    if (tail > index) {
-        m_head.store(index + 1, vull::memory_order_relaxed);
-        return {};
-    }
-
-    T elem = m_slots[static_cast<uint32_t>(index % k_slot_count)].load();
-    if (tail != index) {
-        // This isn't the last element, so we can safely return it now.
-        return elem;
+    uint64_t state = m_state.load(vull::memory_order_acquire);
+    while (size_of(state) != 0) {
+        const auto head = static_cast<uint32_t>(head_of(state) - 1u);
+        T elem = m_slots[head % k_slot_count].load(vull::memory_order_relaxed);
+        if (m_state.compare_exchange_weak(state, pack(head, tail_of(state), tag_of(state) + 1),
+                                          vull::memory_order_acq_rel, vull::memory_order_acquire)) {
+            return elem;
+        }
     }
-
-    // Else, there is only one element left and potential for it to be stolen.
-    if (!m_tail.compare_exchange(tail, tail + 1, vull::memory_order_seq_cst, vull::memory_order_relaxed)) {
-        // Failed race - last element was just stolen.
-        m_head.store(index + 1, vull::memory_order_relaxed);
-        return {};
-    }
-    m_head.store(index + 1, vull::memory_order_relaxed);
-    return elem;
+    return {};
 }
 
 template <typename T, unsigned SlotCountShift>
 typename WorkStealingQueue<T, SlotCountShift>::RetType WorkStealingQueue<T, SlotCountShift>::steal() {
-    int64_t tail = m_tail.load(vull::memory_order_acquire);
-    vull::atomic_thread_fence(vull::memory_order_seq_cst);
-    int64_t head = m_head.load(vull::memory_order_acquire);
-
-    // No available element to take.
-    if (tail >= head) {
-        return {};
+    uint64_t state = m_state.load(vull::memory_order_acquire);
+    while (size_of(state) != 0) {
+        const uint32_t tail = tail_of(state);
+        T elem = m_slots[tail % k_slot_count].load(vull::memory_order_relaxed);
+        if (m_state.compare_exchange_weak(state, pack(head_of(state), tail + 1, tag_of(state) + 1),
+                                          vull::memory_order_acq_rel, vull::memory_order_acquire)) {
+            return elem;
+        }
     }
+    return {};
+}
 
-    T elem = m_slots[static_cast<uint32_t>(tail % k_slot_count)].load();
-    if (!m_tail.compare_exchange(tail, tail + 1, vull::memory_order_seq_cst, vull::memory_order_relaxed)) {
-        // Failed race - item was either dequeued by the queue owner or stolen by another thread.
-        return {};
+// Steals half of the queue (rounded up), limited by the size of the given buffer. Returns the number of elements
+// written to the buffer, oldest first.
+template <typename T, unsigned SlotCountShift>
+uint32_t WorkStealingQueue<T, SlotCountShift>::steal_batch(Span<T> buffer) {
+    uint64_t state = m_state.load(vull::memory_order_acquire);
+    while (size_of(state) != 0) {
+        const uint32_t tail = tail_of(state);
+        const auto count = vull::min((size_of(state) + 1) / 2, static_cast<uint32_t>(buffer.size()));
+        for (uint32_t i = 0; i < count; i++) {
+            buffer[i] = m_slots[(tail + i) % k_slot_count].load(vull::memory_order_relaxed);
+        }
+        if (m_state.compare_exchange_weak(state, pack(head_of(state), tail + count, tag_of(state) + 1),
+                                          vull::memory_order_acq_rel, vull::memory_order_acquire)) {
+            return count;
+        }
     }
-    return elem;
+    return 0;
 }
 
 template <typename T, unsigned SlotCountShift>
 bool WorkStealingQueue<T, SlotCountShift>::empty() const {
-    return m_head.load(vull::memory_order_acquire) <= m_tail.load(vull::memory_order_acquire);
+    return size_of(m_state.load(vull::memory_order_acquire)) == 0;
 }
 
 template <typename T, unsigned SlotCountShift>
 uint64_t WorkStealingQueue<T, SlotCountShift>::size() const {
-    int64_t head = m_head.load(vull::memory_order_acquire);
-    int64_t tail = m_tail.load(vull::memory_order_acquire);
-    return head >= tail ? static_cast<uint64_t>(head - tail) : 0u;
+    return size_of(m_state.load(vull::memory_order_acquire));
 }
 
 } // namespace vull
@@ -10,6 +10,7 @@ enum class BuiltinComponents {
     Collider = 4,
     BoundingBox = 5,
     BoundingSphere = 6,
+    WorldTransform = 7,
 };
 
 } // namespace vull
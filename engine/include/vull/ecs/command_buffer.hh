@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vull/container/array.hh>
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vull {
+
+// An entity created by an EcsCommandBuffer, which only gets a real ID once the buffer is applied.
+class PendingEntity {
+    friend class EcsCommandBuffer;
+
+private:
+    uint32_t m_queue_index;
+    uint32_t m_index;
+
+    PendingEntity(uint32_t queue_index, uint32_t index) : m_queue_index(queue_index), m_index(index) {}
+};
+
+// Records structural changes to an EntityManager, i.e. creating and destroying entities and adding and removing
+// components, to be applied later at a sync point. Commands can be recorded from any tasklet without locking, as each
+// worker thread records into its own queue and allocates components from its own blocks. Each command has a sort key,
+// such as the index of the entity being processed, and apply() runs the commands of all queues ordered by sort key,
+// then in the order they were recorded. For the result to be deterministic, all commands with the same sort key should
+// be recorded from the same tasklet without yielding in between.
+class EcsCommandBuffer {
+    enum class CommandKind : uint8_t {
+        Create,
+        Destroy,
+        Add,
+        Remove,
+    };
+
+    struct Command {
+        uint32_t sort_key;
+        CommandKind kind;
+        // Whether entity is the index of a pending entity in pending_queue, rather than an entity ID.
+        bool pending;
+        uint32_t pending_queue;
+        uint32_t entity;
+        void *component;
+        void (*apply)(EntityManager &, EntityId, void *);
+        void (*destruct)(void *);
+    };
+
+    static constexpr size_t k_block_size = 16384;
+    struct alignas(16) Block {
+        Array<uint8_t, k_block_size> data;
+    };
+
+    // Only touched by one worker whilst recording.
+    struct Queue {
+        Vector<Command> commands;
+        Vector<UniquePtr<Block>> blocks;
+        uint32_t block_index{0};
+        size_t block_head{0};
+        Vector<EntityId> created_ids;
+        uint32_t pending_count{0};
+
+        void *allocate(size_t size, size_t alignment);
+    };
+    Vector<UniquePtr<Queue>> m_queues;
+
+    uint32_t current_queue_index() const;
+    void push(uint32_t sort_key, CommandKind kind, EntityId id, void *component = nullptr,
+              void (*apply)(EntityManager &, EntityId, void *) = nullptr, void (*destruct)(void *) = nullptr);
+    void push(uint32_t sort_key, CommandKind kind, PendingEntity entity, void *component = nullptr,
+              void (*apply)(EntityManager &, EntityId, void *) = nullptr, void (*destruct)(void *) = nullptr);
+    template <typename C, typename... Args>
+    void *make_component(Args &&...args);
+    template <typename C>
+    static void apply_add(EntityManager &manager, EntityId id, void *component);
+    template <typename C>
+    static void apply_remove(EntityManager &manager, EntityId id, void *);
+    template <typename C>
+    static void destruct_component(void *component);
+
+public:
+    // Creates a buffer with a queue for each worker of the current scheduler, as well as one for use outside of a
+    // tasklet.
+    EcsCommandBuffer();
+    EcsCommandBuffer(const EcsCommandBuffer &) = delete;
+    EcsCommandBuffer(EcsCommandBuffer &&) = delete;
+    ~EcsCommandBuffer();
+
+    EcsCommandBuffer &operator=(const EcsCommandBuffer &) = delete;
+    EcsCommandBuffer &operator=(EcsCommandBuffer &&) = delete;
+
+    PendingEntity create_entity(uint32_t sort_key);
+    void destroy_entity(uint32_t sort_key, EntityId id);
+    template <typename C, typename... Args>
+    void add_component(uint32_t sort_key, EntityId id, Args &&...args);
+    template <typename C, typename... Args>
+    void add_component(uint32_t sort_key, PendingEntity entity, Args &&...args);
+    template <typename C>
+    void remove_component(uint32_t sort_key, EntityId id);
+
+    // Applies and then clears all recorded commands. Must not be called whilst commands are being recorded.
+    void apply(EntityManager &manager);
+
+    // Discards all recorded commands.
+    void clear();
+
+    uint32_t command_count() const;
+};
+
+template <typename C, typename... Args>
+void *EcsCommandBuffer::make_component(Args &&...args) {
+    static_assert(sizeof(C) <= k_block_size && alignof(C) <= alignof(Block));
+    auto *component = m_queues[current_queue_index()]->allocate(sizeof(C), alignof(C));
+    return new (component) C(vull::forward<Args>(args)...);
+}
+
+template <typename C>
+void EcsCommandBuffer::apply_add(EntityManager &manager, EntityId id, void *component) {
+    auto &typed = *static_cast<C *>(component);
+    manager.add_component<C>(id, vull::move(typed));
+    typed.~C();
+}
+
+template <typename C>
+void EcsCommandBuffer::apply_remove(EntityManager &manager, EntityId id, void *) {
+    manager.remove_component<C>(id);
+}
+
+template <typename C>
+void EcsCommandBuffer::destruct_component(void *component) {
+    static_cast<C *>(component)->~C();
+}
+
+template <typename C, typename... Args>
+void EcsCommandBuffer::add_component(uint32_t sort_key, EntityId id, Args &&...args) {
+    auto *component = make_component<C>(vull::forward<Args>(args)...);
+    push(sort_key, CommandKind::Add, id, component, &apply_add<C>, &destruct_component<C>);
+}
+
+template <typename C, typename... Args>
+void EcsCommandBuffer::add_component(uint32_t sort_key, PendingEntity entity, Args &&...args) {
+    auto *component = make_component<C>(vull::forward<Args>(args)...);
+    push(sort_key, CommandKind::Add, entity, component, &apply_add<C>, &destruct_component<C>);
+}
+
+template <typename C>
+void EcsCommandBuffer::remove_component(uint32_t sort_key, EntityId id) {
+    push(sort_key, CommandKind::Remove, id, nullptr, &apply_remove<C>);
+}
+
+} // namespace vull
@@ -1,15 +1,24 @@
 #pragma once
 
+#include <vull/container/array.hh>
 #include <vull/container/vector.hh>
 #include <vull/ecs/entity_id.hh>
 #include <vull/ecs/sparse_set.hh>
+#include <vull/support/assert.hh>
 #include <vull/support/optional.hh>
+#include <vull/support/span.hh>
 #include <vull/support/tuple.hh>
+#include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/parallel.hh>
+
+#include <stddef.h>
+#include <stdint.h>
 
 namespace vull {
 
 class EntityManager;
+class WorldSnapshot;
 
 class Entity {
     EntityManager *const m_manager;
@@ -21,86 +30,123 @@ public:
     template <typename C, typename... Args>
     void add(Args &&...args);
     template <typename C>
-    C &get();
+    const C &get();
+    template <typename C>
+    C &get_mut();
     template <typename... Comps>
     bool has();
     template <typename C>
     void remove();
     template <typename C>
-    Optional<C &> try_get();
+    Optional<const C &> try_get();
+    template <typename C>
+    Optional<C &> try_get_mut();
 
     void destroy();
     operator EntityId() const { return m_id; }
 };
 
-template <typename... Comps>
-class EntityIterator;
+namespace detail {
 
+// The range of entities iterated by a view. Either the component sets are packed, in which case the components of the
+// entity at ids[i] are at components[i] and every entity matches, or ids is the dense array of the smallest set and each
+// entity must be checked for the other components. Non-const components are marked as changed when accessed.
 template <typename... Comps>
-class EntityView;
+struct EntityViewRange {
+    EntityManager *manager;
+    const EntityId *ids;
+    Tuple<Comps *...> components;
+    Array<uint32_t *, sizeof...(Comps)> change_ticks;
+    uint32_t count;
+    // Zero if not filtering on changes.
+    uint32_t changed_since;
+    bool packed;
 
-template <typename C>
-class EntityIterator<C> {
-    template <typename...>
-    friend class EntityView;
-
-protected:
-    EntityManager *const m_manager;
-    EntityId *m_current_id;
-    C *m_current_component;
+    template <typename C>
+    static C &access(EntityManager *manager, EntityId id);
+    bool changed(uint32_t index) const;
+    bool matches(uint32_t index) const;
+    template <typename F>
+    decltype(auto) invoke(uint32_t index, F &&fn) const;
+};
 
-    EntityIterator(EntityManager *manager, EntityId *current_id, C *current_component)
-        : m_manager(manager), m_current_id(current_id), m_current_component(current_component) {}
+} // namespace detail
 
-public:
-    bool operator==(const EntityIterator &) const;
-    EntityIterator &operator++();
-    Tuple<Entity, C &> operator*() const;
-};
+template <typename... Comps>
+class EntityView;
 
-template <typename C, typename... Comps>
-class EntityIterator<C, Comps...> : public EntityIterator<C> {
+template <typename... Comps>
+class EntityIterator {
     template <typename...>
     friend class EntityView;
 
 private:
-    EntityId *const m_end_id;
+    detail::EntityViewRange<Comps...> m_range;
+    uint32_t m_index;
 
-    EntityIterator(EntityManager *manager, EntityId *current_id, C *current_component);
+    EntityIterator(const detail::EntityViewRange<Comps...> &range, uint32_t index);
 
 public:
+    bool operator==(const EntityIterator &other) const { return m_index == other.m_index; }
     EntityIterator &operator++();
-    Tuple<Entity, C &, Comps &...> operator*() const;
+    Tuple<Entity, Comps &...> operator*() const;
 };
 
-template <typename C, typename... Comps>
-class EntityView<C, Comps...> {
+template <typename... Comps>
+class EntityView {
     friend EntityManager;
 
 private:
-    EntityManager *const m_manager;
-    SparseSet<EntityId> &m_component_set;
+    detail::EntityViewRange<Comps...> m_range;
 
     EntityView(EntityManager *manager);
 
 public:
-    EntityIterator<C, Comps...> begin() const;
-    EntityIterator<C, Comps...> end() const;
+    EntityIterator<Comps...> begin() const;
+    EntityIterator<Comps...> end() const;
+
+    // Returns a view of only the entities which have had any of the view's components added or mutably accessed after
+    // the given tick, see EntityManager::advance_tick.
+    EntityView changed_since(uint32_t tick) const;
+
+    // Parallel equivalents of iterating the view, built on vull::parallel_reduce. The entities are split between
+    // tasklets in chunks of at least grain entities of the iterated set, and so the callables must be safe to call
+    // concurrently. fn is called as fn(T &accumulator, Entity, Comps &...) or fn(Entity, Comps &...).
+    template <typename T, typename F, typename R>
+    T parallel_reduce(uint32_t grain, F &&fn, R &&combine) const;
+    template <typename F>
+    void parallel_each(uint32_t grain, F &&fn) const;
 };
 
 class EntityManager {
-    template <typename... Comps>
-    friend class EntityIterator;
     template <typename... Comps>
     friend class EntityView;
 
+    // Entities which have all of the group's components are kept at the front of each of the component sets, in the
+    // same order.
+    struct ComponentGroup {
+        Vector<size_t> component_ids;
+        EntityId size{0};
+    };
+
 protected:
     Vector<SparseSet<EntityId>> m_component_sets;
+    Vector<ComponentGroup *> m_component_groups;
+    Vector<UniquePtr<ComponentGroup>> m_groups;
     Vector<EntityId, EntityId> m_entities;
-    EntityId m_free_head;
+    Vector<EntityId, EntityId> m_free_indices;
+    uint32_t m_tick{1};
+
+    void create_group(Span<const size_t> component_ids);
+    void group_entity(ComponentGroup &group, EntityId index);
+    void ungroup_entity(ComponentGroup &group, EntityId index);
+    void rebuild_groups();
+    void rebuild_free_indices();
+    template <typename... Comps>
+    ComponentGroup *owning_group() const;
 
 public:
-    EntityManager();
+    EntityManager() = default;
     EntityManager(const EntityManager &) = delete;
     EntityManager(EntityManager &&) = delete;
     ~EntityManager() = default;
@@ -111,20 +157,65 @@ public:
     template <typename C>
     void register_component();
 
+    // Registers an owning group over the given components, which must already be registered and not owned by another
+    // group. Views of exactly the group's components then become a linear scan over the packed component storage, at
+    // the cost of some extra swapping when the components are added or removed.
+    template <typename C, typename D, typename... Comps>
+    void register_group();
+
     template <typename C, typename... Args>
     void add_component(EntityId id, Args &&...args);
     template <typename C>
-    C &get_component(EntityId id);
+    const C &get_component(EntityId id);
+    template <typename C>
+    C &get_mut_component(EntityId id);
     template <typename C>
     bool has_component(EntityId id);
     template <typename C, typename D, typename... Comps>
     bool has_component(EntityId id);
     template <typename C>
     void remove_component(EntityId id);
+    template <typename C>
+    EntityId component_count() const;
+    template <typename C>
+    size_t component_memory_usage() const;
+
+    // Components are stamped with the current tick whenever they're added or mutably accessed, either through
+    // get_mut_component or a view of the non-const component.
+    template <typename C>
+    void mark_changed(EntityId id);
+    template <typename C>
+    bool changed_since(EntityId id, uint32_t tick);
+
+    // Returns the current tick and starts a new one, so that any changes made afterwards compare as changed since the
+    // returned tick. A consumer of changes can keep the tick returned before its last pass and process everything
+    // changed since it.
+    uint32_t advance_tick() { return m_tick++; }
+    uint32_t tick() const { return m_tick; }
 
+    // Entity IDs carry a version which is bumped each time the index is reused, so that valid() returns false for IDs
+    // of destroyed entities. The lowest free index is always reused first.
     Entity create_entity();
     void destroy_entity(EntityId id);
     bool valid(EntityId id) const;
+
+    // Returns the full ID of the live entity with the given index.
+    EntityId entity_at(EntityId index) const { return m_entities[index]; }
+
+    // Renumbers the live entities to a contiguous range of indices and frees all unused component and sparse storage.
+    // This invalidates all existing entity IDs, including any stored in components. Returns a mapping from each old
+    // index to its new index, with destroyed entities mapping to k_reserved_entity_index.
+    Vector<EntityId> compact();
+
+    // Captures the entity table and all trivially copyable component sets, and starts a new tick. Chunks unchanged
+    // since the previous snapshot, going by their entity indices and change ticks, are shared with it rather than
+    // copied. Changes made through raw storage pointers without marking the component as changed aren't detected.
+    WorldSnapshot snapshot(const WorldSnapshot *previous = nullptr);
+
+    // Restores the state captured by the given snapshot, only copying the chunks changed since it was taken. Restored
+    // components are marked as changed. Components which weren't captured are kept, other than being removed from any
+    // entities which don't exist in the snapshot.
+    void restore(const WorldSnapshot &snapshot);
     template <typename... Comps>
     EntityView<Comps...> view();
 };
@@ -135,10 +226,15 @@ void Entity::add(Args &&...args) {
 }
 
 template <typename C>
-C &Entity::get() {
+const C &Entity::get() {
     return m_manager->get_component<C>(m_id);
 }
 
+template <typename C>
+C &Entity::get_mut() {
+    return m_manager->get_mut_component<C>(m_id);
+}
+
 template <typename... Comps>
 bool Entity::has() {
     return m_manager->has_component<Comps...>(m_id);
@@ -150,89 +246,219 @@ void Entity::remove() {
 }
 
 template <typename C>
-Optional<C &> Entity::try_get() {
-    return has<C>() ? get<C>() : Optional<C &>();
+Optional<const C &> Entity::try_get() {
+    return has<C>() ? get<C>() : Optional<const C &>();
+}
+
+template <typename C>
+Optional<C &> Entity::try_get_mut() {
+    return has<C>() ? get_mut<C>() : Optional<C &>();
 }
 
 inline void Entity::destroy() {
     m_manager->destroy_entity(m_id);
 }
 
+template <typename... Comps>
 template <typename C>
-bool EntityIterator<C>::operator==(const EntityIterator &other) const {
-    return m_current_id == other.m_current_id;
+C &detail::EntityViewRange<Comps...>::access(EntityManager *manager, EntityId id) {
+    if constexpr (is_const<C>) {
+        return manager->template get_component<remove_cv<C>>(id);
+    } else {
+        return manager->template get_mut_component<C>(id);
+    }
 }
 
-template <typename C>
-EntityIterator<C> &EntityIterator<C>::operator++() {
-    m_current_component++;
-    m_current_id++;
-    return *this;
+template <typename... Comps>
+bool detail::EntityViewRange<Comps...>::changed(uint32_t index) const {
+    if (!packed) {
+        return (manager->template changed_since<remove_cv<Comps>>(ids[index], changed_since) || ...);
+    }
+    for (const auto *ticks : change_ticks) {
+        if (ticks[index] > changed_since) {
+            return true;
+        }
+    }
+    return false;
 }
 
-template <typename C>
-Tuple<Entity, C &> EntityIterator<C>::operator*() const {
-    return vull::make_tuple(Entity(m_manager, *m_current_id), vull::ref(*m_current_component));
-}
-
-template <typename C, typename... Comps>
-// NOLINTNEXTLINE: clang-tidy for some reason thinks that current_id can be const.
-EntityIterator<C, Comps...>::EntityIterator(EntityManager *manager, EntityId *current_id, C *current_component)
-    : EntityIterator<C>(manager, current_id, current_component),
-      m_end_id(manager->m_component_sets[C::k_component_id].dense_end()) {
-    while (EntityIterator<C>::m_current_id < m_end_id &&
-           !EntityIterator<C>::m_manager->template has_component<Comps...>(*EntityIterator<C>::m_current_id)) {
-        EntityIterator<C>::operator++();
+template <typename... Comps>
+bool detail::EntityViewRange<Comps...>::matches(uint32_t index) const {
+    if (!packed && !manager->template has_component<Comps...>(ids[index])) {
+        return false;
     }
+    return changed_since == 0 || changed(index);
 }
 
-template <typename C, typename... Comps>
-EntityIterator<C, Comps...> &EntityIterator<C, Comps...>::operator++() {
+template <typename... Comps>
+template <typename F>
+decltype(auto) detail::EntityViewRange<Comps...>::invoke(uint32_t index, F &&fn) const {
+    const auto id = manager->entity_at(ids[index]);
+    if (!packed) {
+        return fn(Entity(manager, id), access<Comps>(manager, id)...);
+    }
+    return [&]<size_t... Is>(IntegerSequence<size_t, Is...>) -> decltype(auto) {
+        const auto tick = manager->tick();
+        ((is_const<Comps> ? void() : void(change_ticks[Is][index] = tick)), ...);
+        return fn(Entity(manager, id), vull::get<Is>(components)[index]...);
+    }(make_integer_sequence<size_t, sizeof...(Comps)>());
+}
+
+template <typename... Comps>
+EntityIterator<Comps...>::EntityIterator(const detail::EntityViewRange<Comps...> &range, uint32_t index)
+    : m_range(range), m_index(index) {
+    while (m_index < m_range.count && !m_range.matches(m_index)) {
+        m_index++;
+    }
+}
+
+template <typename... Comps>
+EntityIterator<Comps...> &EntityIterator<Comps...>::operator++() {
     do {
-        EntityIterator<C>::operator++();
-    } while (EntityIterator<C>::m_current_id < m_end_id &&
-             !EntityIterator<C>::m_manager->template has_component<Comps...>(*EntityIterator<C>::m_current_id));
+        m_index++;
+    } while (m_index < m_range.count && !m_range.matches(m_index));
     return *this;
 }
 
-template <typename C, typename... Comps>
-Tuple<Entity, C &, Comps &...> EntityIterator<C, Comps...>::operator*() const {
-    return vull::make_tuple(
-        Entity(EntityIterator<C>::m_manager, *EntityIterator<C>::m_current_id),
-        vull::ref(*EntityIterator<C>::m_current_component),
-        vull::ref(EntityIterator<C>::m_manager->template get_component<Comps>(*EntityIterator<C>::m_current_id))...);
+template <typename... Comps>
+Tuple<Entity, Comps &...> EntityIterator<Comps...>::operator*() const {
+    return m_range.invoke(m_index, [](Entity entity, Comps &...components) {
+        return vull::make_tuple(vull::move(entity), vull::ref(components)...);
+    });
 }
 
-template <typename C, typename... Comps>
-EntityView<C, Comps...>::EntityView(EntityManager *manager)
-    : m_manager(manager), m_component_set(manager->m_component_sets[C::k_component_id]) {}
+template <typename... Comps>
+EntityView<Comps...>::EntityView(EntityManager *manager) {
+    static_assert(sizeof...(Comps) != 0);
+    const size_t component_ids[]{Comps::k_component_id...};
+    auto &first_set = manager->m_component_sets[component_ids[0]];
+    m_range.manager = manager;
+    m_range.components = {};
+    m_range.change_ticks = {};
+    m_range.changed_since = 0;
+    if constexpr (sizeof...(Comps) == 1) {
+        m_range.count = first_set.size();
+        m_range.packed = true;
+    } else if (auto *group = manager->template owning_group<Comps...>()) {
+        m_range.count = group->size;
+        m_range.packed = true;
+    } else {
+        // Drive iteration off of the smallest set, probing the others.
+        auto *driver = &first_set;
+        for (const auto component_id : component_ids) {
+            if (auto &set = manager->m_component_sets[component_id]; set.size() < driver->size()) {
+                driver = &set;
+            }
+        }
+        m_range.ids = driver->dense_begin();
+        m_range.count = driver->size();
+        m_range.packed = false;
+        return;
+    }
+    m_range.ids = first_set.dense_begin();
+    m_range.components =
+        Tuple<Comps *...>(manager->m_component_sets[Comps::k_component_id].template storage_begin<Comps>()...);
+    m_range.change_ticks = {manager->m_component_sets[Comps::k_component_id].change_ticks()...};
+}
+
+template <typename... Comps>
+EntityIterator<Comps...> EntityView<Comps...>::begin() const {
+    return {m_range, 0};
+}
+
+template <typename... Comps>
+EntityIterator<Comps...> EntityView<Comps...>::end() const {
+    return {m_range, m_range.count};
+}
+
+template <typename... Comps>
+EntityView<Comps...> EntityView<Comps...>::changed_since(uint32_t tick) const {
+    auto view = *this;
+    view.m_range.changed_since = tick;
+    return view;
+}
 
-template <typename C, typename... Comps>
-EntityIterator<C, Comps...> EntityView<C, Comps...>::begin() const {
-    return {m_manager, m_component_set.dense_begin(), m_component_set.storage_begin<C>()};
+template <typename... Comps>
+template <typename T, typename F, typename R>
+T EntityView<Comps...>::parallel_reduce(uint32_t grain, F &&fn, R &&combine) const {
+    return vull::parallel_reduce<T>(
+        0, m_range.count, grain,
+        [&](T &accumulator, uint32_t index) {
+            if (!m_range.matches(index)) {
+                return;
+            }
+            m_range.invoke(index, [&](Entity entity, Comps &...components) {
+                fn(accumulator, entity, components...);
+            });
+        },
+        combine);
 }
 
-template <typename C, typename... Comps>
-EntityIterator<C, Comps...> EntityView<C, Comps...>::end() const {
-    return {m_manager, m_component_set.dense_end(), m_component_set.storage_end<C>()};
+template <typename... Comps>
+template <typename F>
+void EntityView<Comps...>::parallel_each(uint32_t grain, F &&fn) const {
+    struct Empty {};
+    parallel_reduce<Empty>(
+        grain,
+        [&fn](Empty &, Entity entity, Comps &...components) {
+            fn(entity, components...);
+        },
+        [](Empty &, Empty &&) {});
 }
 
 template <typename C>
 void EntityManager::register_component() {
     m_component_sets.ensure_size(C::k_component_id + 1);
     m_component_sets[C::k_component_id].template initialise<C>();
+    m_component_groups.ensure_size(C::k_component_id + 1, nullptr);
+}
+
+template <typename C, typename D, typename... Comps>
+void EntityManager::register_group() {
+    const Array<size_t, sizeof...(Comps) + 2> component_ids{C::k_component_id, D::k_component_id,
+                                                            Comps::k_component_id...};
+    create_group(component_ids.span());
+}
+
+template <typename... Comps>
+EntityManager::ComponentGroup *EntityManager::owning_group() const {
+    const size_t component_ids[]{Comps::k_component_id...};
+    auto *group = m_component_groups[component_ids[0]];
+    if (group == nullptr || group->component_ids.size() != sizeof...(Comps)) {
+        return nullptr;
+    }
+    for (const auto component_id : component_ids) {
+        if (m_component_groups[component_id] != group) {
+            return nullptr;
+        }
+    }
+    return group;
 }
 
 template <typename C, typename... Args>
 void EntityManager::add_component(EntityId id, Args &&...args) {
-    m_component_sets[C::k_component_id].template emplace<C>(entity_index(id), vull::forward<Args>(args)...);
+    VULL_ASSERT(valid(id));
+    auto &set = m_component_sets[C::k_component_id];
+    set.template emplace<C>(entity_index(id), vull::forward<Args>(args)...);
+    set.set_change_tick(entity_index(id), m_tick);
+    if (auto *group = m_component_groups[C::k_component_id]) {
+        group_entity(*group, entity_index(id));
+    }
 }
 
 template <typename C>
-C &EntityManager::get_component(EntityId id) {
+const C &EntityManager::get_component(EntityId id) {
     return m_component_sets[C::k_component_id].template at<C>(entity_index(id));
 }
 
+template <typename C>
+C &EntityManager::get_mut_component(EntityId id) {
+    auto &set = m_component_sets[C::k_component_id];
+    const auto dense_index = set.index_of(entity_index(id));
+    set.change_ticks()[dense_index] = m_tick;
+    return set.template storage_begin<C>()[dense_index];
+}
+
 template <typename C>
 bool EntityManager::has_component(EntityId id) {
     return m_component_sets[C::k_component_id].contains(entity_index(id));
@@ -245,9 +471,33 @@ bool EntityManager::has_component(EntityId id) {
 
 template <typename C>
 void EntityManager::remove_component(EntityId id) {
+    VULL_ASSERT(valid(id));
+    if (auto *group = m_component_groups[C::k_component_id]) {
+        ungroup_entity(*group, entity_index(id));
+    }
     m_component_sets[C::k_component_id].remove(entity_index(id));
 }
 
+template <typename C>
+EntityId EntityManager::component_count() const {
+    return m_component_sets[C::k_component_id].size();
+}
+
+template <typename C>
+size_t EntityManager::component_memory_usage() const {
+    return m_component_sets[C::k_component_id].memory_usage();
+}
+
+template <typename C>
+void EntityManager::mark_changed(EntityId id) {
+    m_component_sets[C::k_component_id].set_change_tick(entity_index(id), m_tick);
+}
+
+template <typename C>
+bool EntityManager::changed_since(EntityId id, uint32_t tick) {
+    return m_component_sets[C::k_component_id].change_tick(entity_index(id)) > tick;
+}
+
 template <typename... Comps>
 EntityView<Comps...> EntityManager::view() {
     return {this};
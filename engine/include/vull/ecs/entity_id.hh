@@ -16,4 +16,7 @@ constexpr EntityId entity_version(EntityId id) {
     return id >> 24u;
 }
 
+// Never the index of a live entity.
+constexpr EntityId k_reserved_entity_index = entity_index(~EntityId(0));
+
 } // namespace vull
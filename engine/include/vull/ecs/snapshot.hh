@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/result.hh>
+#include <vull/support/utility.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vull {
+
+enum class StreamError;
+struct Stream;
+
+// A reference counted, immutable block of snapshot data, shared between all of the snapshots it's unchanged in.
+class SnapshotChunk {
+    struct Storage {
+        Atomic<uint32_t> ref_count{1};
+        Vector<uint8_t, size_t> bytes;
+    };
+    Storage *m_storage{nullptr};
+
+public:
+    SnapshotChunk() = default;
+    explicit SnapshotChunk(size_t size);
+    SnapshotChunk(const SnapshotChunk &) = delete;
+    SnapshotChunk(SnapshotChunk &&other) : m_storage(vull::exchange(other.m_storage, nullptr)) {}
+    ~SnapshotChunk();
+
+    SnapshotChunk &operator=(const SnapshotChunk &) = delete;
+    SnapshotChunk &operator=(SnapshotChunk &&);
+
+    SnapshotChunk share() const;
+    bool shares_with(const SnapshotChunk &other) const { return m_storage == other.m_storage; }
+    bool equals(const void *data, size_t size) const;
+
+    uint8_t *data() const { return m_storage->bytes.data(); }
+    size_t size() const { return m_storage->bytes.size(); }
+};
+
+enum class SnapshotError {
+    Mismatched,
+};
+
+// The state of an EntityManager at a point in time, see EntityManager::snapshot. Every component set is split into
+// chunks of k_chunk_size elements, each holding the entity indices of the elements followed by their objects. Component
+// sets which aren't trivially copyable aren't captured.
+class WorldSnapshot {
+    friend EntityManager;
+    friend Result<void, StreamError> write_snapshot_diff(const WorldSnapshot &, const WorldSnapshot &, Stream &);
+    friend Result<WorldSnapshot, StreamError, SnapshotError> read_snapshot_diff(const WorldSnapshot &, Stream &);
+
+public:
+    static constexpr uint32_t k_chunk_size = 256;
+
+private:
+    struct Set {
+        EntityId size{0};
+        uint32_t object_size{0};
+        Vector<SnapshotChunk> chunks;
+    };
+
+    uint32_t m_tick{0};
+    EntityId m_entity_count{0};
+    Vector<SnapshotChunk> m_entity_chunks;
+    Vector<EntityId, EntityId> m_free_indices;
+    Vector<EntityId> m_group_sizes;
+    Vector<Set> m_sets;
+
+public:
+    WorldSnapshot() = default;
+    WorldSnapshot(const WorldSnapshot &) = delete;
+    WorldSnapshot(WorldSnapshot &&) = default;
+    ~WorldSnapshot() = default;
+
+    WorldSnapshot &operator=(const WorldSnapshot &) = delete;
+    WorldSnapshot &operator=(WorldSnapshot &&) = default;
+
+    // Returns the bytes held by chunks not shared with the other snapshot, or all chunks if other is null.
+    size_t unique_memory_usage(const WorldSnapshot *other = nullptr) const;
+
+    // The tick the snapshot was taken at. Any changes made afterwards have a greater tick.
+    uint32_t tick() const { return m_tick; }
+};
+
+// Writes the chunks which differ between the two snapshots, which must be of the same entity manager. Chunks shared
+// between the snapshots are skipped without being compared.
+Result<void, StreamError> write_snapshot_diff(const WorldSnapshot &from, const WorldSnapshot &to, Stream &stream);
+
+// Reconstructs the to snapshot given to write_snapshot_diff from the from snapshot and the diff.
+Result<WorldSnapshot, StreamError, SnapshotError> read_snapshot_diff(const WorldSnapshot &from, Stream &stream);
+
+} // namespace vull
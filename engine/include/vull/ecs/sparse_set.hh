@@ -1,26 +1,62 @@
 #pragma once
 
+#include <vull/container/array.hh>
 #include <vull/container/vector.hh>
+#include <vull/maths/common.hh>
 #include <vull/support/assert.hh>
 #include <vull/support/function.hh>
+#include <vull/support/result.hh>
 #include <vull/support/stream.hh>
+#include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 
+#include <stddef.h>
+#include <stdint.h>
+
 namespace vull {
 
-// TODO: Paging.
+// The sparse array is split into fixed size pages which are only allocated once an index in their range is added, and
+// freed again once empty, so that a few high indices don't cost a sparse array covering the whole index space. Each
+// element also has a change tick alongside it in the dense array, which is zero until set by the owner.
 template <typename I>
 class SparseSet {
+    static constexpr uint32_t k_page_shift = 10;
+    static constexpr I k_page_size = I(1) << k_page_shift;
+    static constexpr I k_tombstone = ~I(0);
+
+    struct SparsePage {
+        Array<I, k_page_size> dense_indices;
+        I live_count{0};
+
+        SparsePage() {
+            for (auto &dense_index : dense_indices) {
+                dense_index = k_tombstone;
+            }
+        }
+    };
+
     Vector<I, I> m_dense;
-    Vector<I, I> m_sparse;
+    Vector<uint32_t, I> m_change_ticks;
+    Vector<UniquePtr<SparsePage>, I> m_sparse_pages;
     uint8_t *m_data{nullptr};
 
     void (*m_destruct)(void *){nullptr};
     void (*m_swap)(void *, void *){nullptr};
+    void (*m_relocate)(void *, void *, I){nullptr};
     void (*m_deserialise)(void *, Stream &){nullptr};
     void (*m_serialise)(void *, Stream &){nullptr};
     I m_object_size{0};
     I m_capacity{0};
+    // Whether objects are serialised as their raw bytes, in which case the whole array can be read or written at once.
+    bool m_raw_serialisable{false};
+    bool m_trivially_copyable{false};
+
+    I &dense_index(I index) const {
+        return m_sparse_pages[index >> k_page_shift]->dense_indices[index & (k_page_size - 1)];
+    }
+    void set_dense_index(I index, I dense_index);
+    void clear_dense_index(I index);
+    void reallocate_storage(I capacity);
 
 public:
     SparseSet() = default;
@@ -33,39 +69,62 @@ public:
 
     template <typename T>
     void initialise();
-    void deserialise(I count, Stream &stream);
+    Result<void, StreamError> deserialise(I count, Stream &stream);
+    Result<void, StreamError> deserialise_indices(I count, Stream &stream);
     void raw_ensure_index(I index);
-    void serialise(Stream &stream);
+    void raw_clear_indices(I begin, I end);
+    void raw_resize(I size);
+    void raw_assign(I begin, I count, const I *indices, const void *objects, uint32_t tick);
+    Result<void, StreamError> serialise(Stream &stream);
+    Result<void, StreamError> serialise_indices(Stream &stream);
 
     template <typename T>
     T &at(I index);
     bool contains(I index) const;
     template <typename T, typename... Args>
     void emplace(I index, Args &&...args);
+    I index_of(I index) const;
     void remove(I index);
+    void shrink_to_fit();
+    void remap(Span<const I> new_indices);
+    void swap_dense(I lhs, I rhs);
+
+    uint32_t change_tick(I index) const { return m_change_ticks[index_of(index)]; }
+    void set_change_tick(I index, uint32_t tick) { m_change_ticks[index_of(index)] = tick; }
+    uint32_t *change_ticks() { return m_change_ticks.data(); }
+    const uint32_t *change_ticks() const { return m_change_ticks.data(); }
 
     auto dense_begin() { return m_dense.begin(); }
     auto dense_end() { return m_dense.end(); }
+    const I *dense_data() const { return m_dense.data(); }
+    const uint8_t *raw_data() const { return m_data; }
     template <typename T>
     T *storage_begin();
     template <typename T>
     T *storage_end();
 
-    bool empty() const { return !m_dense.empty(); }
+    bool empty() const { return m_dense.empty(); }
     bool initialised() const { return m_destruct != nullptr; }
+    bool trivially_copyable() const { return m_trivially_copyable; }
     I size() const { return m_dense.size(); }
     uint32_t object_size() const { return m_object_size; }
+    size_t memory_usage() const;
 };
 
 template <typename I>
-SparseSet<I>::SparseSet(SparseSet &&other) : m_dense(vull::move(other.m_dense)), m_sparse(vull::move(other.m_sparse)) {
+SparseSet<I>::SparseSet(SparseSet &&other)
+    : m_dense(vull::move(other.m_dense)), m_change_ticks(vull::move(other.m_change_ticks)),
+      m_sparse_pages(vull::move(other.m_sparse_pages)) {
     m_data = vull::exchange(other.m_data, nullptr);
     m_destruct = vull::exchange(other.m_destruct, nullptr);
     m_swap = vull::exchange(other.m_swap, nullptr);
+    m_relocate = vull::exchange(other.m_relocate, nullptr);
     m_deserialise = vull::exchange(other.m_deserialise, nullptr);
     m_serialise = vull::exchange(other.m_serialise, nullptr);
     m_object_size = vull::exchange(other.m_object_size, 0u);
     m_capacity = vull::exchange(other.m_capacity, 0u);
+    m_raw_serialisable = vull::exchange(other.m_raw_serialisable, false);
+    m_trivially_copyable = vull::exchange(other.m_trivially_copyable, false);
 }
 
 template <typename I>
@@ -85,6 +144,16 @@ void SparseSet<I>::initialise() {
     m_swap = +[](void *lhs, void *rhs) {
         vull::swap(*static_cast<T *>(lhs), *static_cast<T *>(rhs));
     };
+    m_relocate = +[](void *dst, void *src, I count) {
+        if constexpr (is_trivially_copyable<T>) {
+            memcpy(dst, src, count * sizeof(T));
+        } else {
+            for (I i = 0; i < count; i++) {
+                new (static_cast<T *>(dst) + i) T(vull::move(static_cast<T *>(src)[i]));
+                static_cast<T *>(src)[i].~T();
+            }
+        }
+    };
     m_deserialise = +[](void *ptr, Stream &stream) {
         if constexpr (!requires(T) { T::deserialise(stream); }) {
             if constexpr (!is_trivially_copyable<T>) {
@@ -108,30 +177,119 @@ void SparseSet<I>::initialise() {
         }
     };
     m_object_size = static_cast<I>(sizeof(T));
+    m_raw_serialisable = !requires(T t, Stream &stream) { T::serialise(t, stream); } &&
+                         !requires(Stream &stream) { T::deserialise(stream); };
+    m_trivially_copyable = is_trivially_copyable<T>;
 }
 
 template <typename I>
-void SparseSet<I>::deserialise(I count, Stream &stream) {
+Result<void, StreamError> SparseSet<I>::deserialise(I count, Stream &stream) {
     m_capacity = count;
     m_data = new uint8_t[m_capacity * m_object_size];
-    // TODO: If trivially copyable, read from stream in one go.
+    if (m_raw_serialisable) {
+        const auto size = static_cast<size_t>(count) * m_object_size;
+        if (VULL_TRY(stream.read({m_data, size})) != size) {
+            return StreamError::Truncated;
+        }
+        return {};
+    }
     for (I i = 0; i < count; i++) {
         m_deserialise(m_data + i * m_object_size, stream);
     }
+    return {};
+}
+
+// Reads the dense array as stored by serialise_indices. Must be called after deserialise.
+template <typename I>
+Result<void, StreamError> SparseSet<I>::deserialise_indices(I count, Stream &stream) {
+    VULL_ASSERT(m_dense.empty());
+    m_dense.ensure_size(count);
+    if (VULL_TRY(stream.read({m_dense.data(), m_dense.size_bytes()})) != m_dense.size_bytes()) {
+        return StreamError::Truncated;
+    }
+    m_change_ticks.ensure_size(count, 0u);
+    for (I i = 0; i < count; i++) {
+        set_dense_index(m_dense[i], i);
+    }
+    return {};
+}
+
+template <typename I>
+void SparseSet<I>::set_dense_index(I index, I dense_index) {
+    const I page_index = index >> k_page_shift;
+    m_sparse_pages.ensure_size(page_index + 1);
+    auto &page = m_sparse_pages[page_index];
+    if (!page) {
+        page = vull::make_unique<SparsePage>();
+    }
+    page->dense_indices[index & (k_page_size - 1)] = dense_index;
+    page->live_count++;
+}
+
+template <typename I>
+void SparseSet<I>::clear_dense_index(I index) {
+    auto &page = m_sparse_pages[index >> k_page_shift];
+    page->dense_indices[index & (k_page_size - 1)] = k_tombstone;
+    if (--page->live_count == 0) {
+        page.clear();
+    }
 }
 
 template <typename I>
 void SparseSet<I>::raw_ensure_index(I index) {
-    m_sparse.ensure_size(index + 1);
-    m_sparse[index] = m_dense.size();
+    set_dense_index(index, m_dense.size());
     m_dense.push(index);
+    m_change_ticks.push(0);
+}
+
+// The raw_ functions below are for wholesale restores of trivially copyable sets, which clear the sparse entries of the
+// elements about to be overwritten, resize the dense array, and then assign the new elements.
+template <typename I>
+void SparseSet<I>::raw_clear_indices(I begin, I end) {
+    for (I i = begin; i < vull::min(end, m_dense.size()); i++) {
+        clear_dense_index(m_dense[i]);
+    }
+}
+
+template <typename I>
+void SparseSet<I>::raw_resize(I size) {
+    VULL_ASSERT(m_trivially_copyable);
+    if (size > m_capacity) {
+        reallocate_storage(size);
+    }
+    while (m_dense.size() > size) {
+        m_dense.pop();
+        m_change_ticks.pop();
+    }
+    m_dense.ensure_size(size);
+    m_change_ticks.ensure_size(size);
 }
 
 template <typename I>
-void SparseSet<I>::serialise(Stream &stream) {
+void SparseSet<I>::raw_assign(I begin, I count, const I *indices, const void *objects, uint32_t tick) {
+    VULL_ASSERT(m_trivially_copyable && begin + count <= m_dense.size());
+    memcpy(m_dense.data() + begin, indices, count * sizeof(I));
+    memcpy(m_data + begin * m_object_size, objects, count * m_object_size);
+    for (I i = begin; i < begin + count; i++) {
+        m_change_ticks[i] = tick;
+        set_dense_index(m_dense[i], i);
+    }
+}
+
+template <typename I>
+Result<void, StreamError> SparseSet<I>::serialise(Stream &stream) {
+    if (m_raw_serialisable) {
+        return stream.write({m_data, static_cast<size_t>(m_dense.size()) * m_object_size});
+    }
     for (I i = 0; i < m_dense.size(); i++) {
         m_serialise(m_data + i * m_object_size, stream);
     }
+    return {};
+}
+
+template <typename I>
+Result<void, StreamError> SparseSet<I>::serialise_indices(Stream &stream) {
+    return stream.write({m_dense.data(), m_dense.size_bytes()});
 }
 
 template <typename I>
@@ -139,19 +297,17 @@ template <typename T>
 T &SparseSet<I>::at(I index) {
     VULL_ASSERT(contains(index));
     VULL_ASSERT_PEDANTIC(m_object_size == sizeof(T));
-    return *reinterpret_cast<T *>(m_data + m_sparse[index] * sizeof(T));
+    return *reinterpret_cast<T *>(m_data + dense_index(index) * sizeof(T));
 }
 
 template <typename I>
 bool SparseSet<I>::contains(I index) const {
-    // TODO: Sentinel value optimisation.
-    if (index >= m_sparse.size()) {
-        return false;
-    }
-    if (m_sparse[index] >= m_dense.size()) {
+    // Unused slots of an allocated page hold the tombstone value, so no need to check the dense array.
+    const I page_index = index >> k_page_shift;
+    if (page_index >= m_sparse_pages.size() || !m_sparse_pages[page_index]) {
         return false;
     }
-    return m_dense[m_sparse[index]] == index;
+    return dense_index(index) != k_tombstone;
 }
 
 template <typename I>
@@ -159,8 +315,7 @@ template <typename T, typename... Args>
 void SparseSet<I>::emplace(I index, Args &&...args) {
     VULL_ASSERT(!contains(index));
     VULL_ASSERT_PEDANTIC(m_object_size == sizeof(T));
-    m_sparse.ensure_size(index + 1);
-    m_sparse[index] = m_dense.size();
+    set_dense_index(index, m_dense.size());
 
     if (auto new_capacity = m_dense.size() + 1; new_capacity > m_capacity) {
         new_capacity = vull::max(m_capacity * 2 + 1, new_capacity);
@@ -182,20 +337,99 @@ void SparseSet<I>::emplace(I index, Args &&...args) {
     // NOLINTNEXTLINE
     new (&reinterpret_cast<T *>(m_data)[m_dense.size()]) T(vull::forward<Args>(args)...);
     m_dense.push(index);
+    m_change_ticks.push(0);
+}
+
+template <typename I>
+I SparseSet<I>::index_of(I index) const {
+    VULL_ASSERT(contains(index));
+    return dense_index(index);
 }
 
 // TODO: Alternate templated remove function that may be slightly faster when T is known.
 template <typename I>
 void SparseSet<I>::remove(I index) {
     VULL_ASSERT(contains(index));
-    if (const I &dense_index = m_sparse[index]; m_dense[dense_index] != m_dense.last()) {
-        m_sparse[m_dense.last()] = dense_index;
-        vull::swap(m_dense[dense_index], m_dense.last());
-        m_swap(m_data + dense_index * m_object_size, m_data + (m_dense.size() - 1) * m_object_size);
+    if (const I removed_index = dense_index(index); index != m_dense.last()) {
+        dense_index(m_dense.last()) = removed_index;
+        vull::swap(m_dense[removed_index], m_dense.last());
+        vull::swap(m_change_ticks[removed_index], m_change_ticks.last());
+        m_swap(m_data + removed_index * m_object_size, m_data + (m_dense.size() - 1) * m_object_size);
     }
     m_dense.pop();
+    m_change_ticks.pop();
     m_destruct(m_data + m_dense.size() * m_object_size);
-    // TODO: Shrink storage if desirable.
+    clear_dense_index(index);
+
+    // Halve the storage once it's only a quarter full, so that a burst of entities doesn't hold on to memory forever.
+    if (m_capacity >= 64 && m_dense.size() < m_capacity / 4) {
+        reallocate_storage(m_capacity / 2);
+    }
+}
+
+template <typename I>
+void SparseSet<I>::reallocate_storage(I capacity) {
+    VULL_ASSERT(capacity >= m_dense.size());
+    auto *new_data = capacity != 0 ? new uint8_t[capacity * m_object_size] : nullptr;
+    if (!m_dense.empty()) {
+        m_relocate(new_data, m_data, m_dense.size());
+    }
+    delete[] m_data;
+    m_data = new_data;
+    m_capacity = capacity;
+}
+
+// Frees all unused capacity, including any trailing empty sparse pages.
+template <typename I>
+void SparseSet<I>::shrink_to_fit() {
+    reallocate_storage(m_dense.size());
+    m_dense.reallocate(m_dense.size());
+    m_change_ticks.reallocate(m_change_ticks.size());
+    I page_count = m_sparse_pages.size();
+    while (page_count > 0 && !m_sparse_pages[page_count - 1]) {
+        page_count--;
+    }
+    Vector<UniquePtr<SparsePage>, I> pages;
+    pages.ensure_capacity(page_count);
+    for (I i = 0; i < page_count; i++) {
+        pages.push(vull::move(m_sparse_pages[i]));
+    }
+    m_sparse_pages = vull::move(pages);
+}
+
+// Renumbers every element from index to new_indices[index], keeping the dense order.
+template <typename I>
+void SparseSet<I>::remap(Span<const I> new_indices) {
+    m_sparse_pages.clear();
+    for (I i = 0; i < m_dense.size(); i++) {
+        m_dense[i] = new_indices[m_dense[i]];
+        set_dense_index(m_dense[i], i);
+    }
+}
+
+// Returns the number of bytes allocated for the dense, sparse and object storage, including unused capacity.
+template <typename I>
+size_t SparseSet<I>::memory_usage() const {
+    size_t bytes = static_cast<size_t>(m_capacity) * m_object_size;
+    bytes += static_cast<size_t>(m_dense.capacity()) * sizeof(I);
+    bytes += static_cast<size_t>(m_change_ticks.capacity()) * sizeof(uint32_t);
+    bytes += static_cast<size_t>(m_sparse_pages.capacity()) * sizeof(UniquePtr<SparsePage>);
+    for (const auto &page : m_sparse_pages) {
+        bytes += page ? sizeof(SparsePage) : 0;
+    }
+    return bytes;
+}
+
+// Swaps the two elements at the given dense indices, along with their objects.
+template <typename I>
+void SparseSet<I>::swap_dense(I lhs, I rhs) {
+    if (lhs == rhs) {
+        return;
+    }
+    vull::swap(dense_index(m_dense[lhs]), dense_index(m_dense[rhs]));
+    vull::swap(m_dense[lhs], m_dense[rhs]);
+    vull::swap(m_change_ticks[lhs], m_change_ticks[rhs]);
+    m_swap(m_data + lhs * m_object_size, m_data + rhs * m_object_size);
 }
 
 template <typename I>
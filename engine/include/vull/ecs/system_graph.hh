@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/function.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vull {
+
+class Latch;
+
+class System {
+    friend class SystemGraph;
+
+private:
+    String m_name;
+    // A copy of the name which outlives the system, as trace events may be exported after the graph is gone.
+    const char *m_trace_label;
+    Function<void()> m_fn;
+    Vector<size_t> m_reads;
+    Vector<size_t> m_writes;
+    Vector<System *> m_after;
+    Vector<System *> m_dependents;
+    uint32_t m_dependency_count{0};
+    Atomic<uint32_t> m_pending_count;
+    float m_time{0.0f};
+
+    bool conflicts_with(const System &other) const;
+
+public:
+    System(String &&name, Function<void()> &&fn);
+    System(const System &) = delete;
+    System(System &&) = delete;
+    ~System() = default;
+
+    System &operator=(const System &) = delete;
+    System &operator=(System &&) = delete;
+
+    template <typename... Comps>
+    System &reads();
+    template <typename... Comps>
+    System &writes();
+    System &after(System &system);
+
+    StringView name() const { return m_name; }
+
+    // The wall time of the system's last run, in seconds.
+    float time() const { return m_time; }
+};
+
+// A set of systems which are run together on the tasklet scheduler. Each system declares the components it reads and
+// writes, and any system which conflicts with an earlier added one, i.e. writes a component the other accesses or
+// vice versa, runs after it. Systems with no path between them in the resulting graph may run concurrently.
+class SystemGraph {
+    Vector<UniquePtr<System>> m_systems;
+    bool m_built{false};
+
+    void build();
+    void run_system(System *system, Latch &latch);
+
+public:
+    SystemGraph() = default;
+    SystemGraph(const SystemGraph &) = delete;
+    SystemGraph(SystemGraph &&) = delete;
+    ~SystemGraph() = default;
+
+    SystemGraph &operator=(const SystemGraph &) = delete;
+    SystemGraph &operator=(SystemGraph &&) = delete;
+
+    System &add_system(String name, Function<void()> &&fn);
+
+    // Adds a system which calls fn(Entity, Comps &...) for every entity in the view, split between tasklets in chunks
+    // of at least grain entities. All of the components are declared as written.
+    template <typename... Comps, typename F>
+    System &add_view_system(String name, EntityManager &manager, uint32_t grain, F &&fn);
+
+    // Runs all of the systems and waits for them to complete. Must be called from a tasklet.
+    void run();
+
+    const Vector<UniquePtr<System>> &systems() const { return m_systems; }
+};
+
+template <typename... Comps>
+System &System::reads() {
+    (m_reads.push(Comps::k_component_id), ...);
+    return *this;
+}
+
+template <typename... Comps>
+System &System::writes() {
+    (m_writes.push(Comps::k_component_id), ...);
+    return *this;
+}
+
+inline System &System::after(System &system) {
+    m_after.push(&system);
+    return *this;
+}
+
+template <typename... Comps, typename F>
+System &SystemGraph::add_view_system(String name, EntityManager &manager, uint32_t grain, F &&fn) {
+    auto &system = add_system(vull::move(name), [&manager, grain, fn = vull::forward<F>(fn)] {
+        manager.view<Comps...>().parallel_each(grain, fn);
+    });
+    return system.template writes<Comps...>();
+}
+
+} // namespace vull
@@ -4,6 +4,8 @@
 #include <vull/support/result.hh>
 #include <vull/support/string_view.hh>
 
+#include <stdint.h>
+
 namespace vull::vpak {
 
 class Writer;
@@ -18,11 +20,16 @@ struct Stream;
 enum class WorldError {
     InvalidComponent,
     MissingEntry,
+    UnsupportedVersion,
 };
 
 class World : public EntityManager {
 public:
+    static constexpr uint32_t k_version_marker = 0xffffffffu;
+    static constexpr uint32_t k_version = 3;
+
     Result<void, StreamError, WorldError> deserialise(Stream &stream);
+    Result<void, StreamError> serialise(Stream &stream);
     Result<float, StreamError> serialise(vpak::Writer &pack_writer, StringView name);
 };
 
@@ -9,6 +9,7 @@
 #include <vull/support/string.hh>
 #include <vull/support/string_view.hh>
 #include <vull/tasklet/mutex.hh>
+#include <vull/tasklet/shared_mutex.hh>
 #include <vull/vulkan/buffer.hh>
 #include <vull/vulkan/image.hh>
 #include <vull/vulkan/vulkan.hh>
@@ -34,8 +35,7 @@ enum class TextureKind {
 class TextureStreamer {
     vk::Context &m_context;
     HashMap<String, uint32_t> m_texture_indices;
-    // TODO(rw-mutex)
-    Mutex m_mutex;
+    SharedMutex m_mutex;
 
     Vector<vk::Image> m_images;
     Mutex m_images_mutex;
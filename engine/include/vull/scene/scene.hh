@@ -3,12 +3,16 @@
 #include <vull/ecs/entity_id.hh>
 #include <vull/ecs/world.hh>
 #include <vull/maths/mat.hh>
+#include <vull/scene/transform_propagator.hh>
 #include <vull/support/string_view.hh>
 
 namespace vull {
 
+class EcsCommandBuffer;
+
 class Scene {
     World m_world;
+    TransformPropagator m_transform_propagator;
 
 public:
     Scene() = default;
@@ -19,8 +23,12 @@ public:
     Scene &operator=(const Scene &) = delete;
     Scene &operator=(Scene &&) = delete;
 
+    // Returns the world matrix of the entity as of the last update_transforms call.
     Mat4f get_transform_matrix(EntityId entity);
     void load(StringView scene_name);
+    // Updates the world matrices of changed transforms. New WorldTransform components are recorded into the given command
+    // buffer, which must be applied before the next call.
+    void update_transforms(EcsCommandBuffer &commands);
 
     World &world() { return m_world; }
 };
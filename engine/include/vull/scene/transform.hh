@@ -37,6 +37,20 @@ public:
     const Vec3f &scale() const { return m_scale; }
 };
 
+// The matrix of a transform combined with those of all its parents. Kept up to date by TransformPropagator.
+class WorldTransform {
+    VULL_DECLARE_COMPONENT(BuiltinComponents::WorldTransform);
+
+private:
+    Mat4f m_matrix;
+
+public:
+    explicit WorldTransform(const Mat4f &matrix) : m_matrix(matrix) {}
+
+    void set_matrix(const Mat4f &matrix) { m_matrix = matrix; }
+    const Mat4f &matrix() const { return m_matrix; }
+};
+
 // Transform point in local space to world space.
 inline Vec3f operator*(const Transform &transform, const Vec3f &point) {
     return transform.position() + vull::rotate(transform.rotation(), point);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/mat.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+class EcsCommandBuffer;
+class EntityManager;
+
+// Computes the WorldTransform of every entity with a Transform. The hierarchy is kept sorted so that parents come before
+// their children, which lets the world matrices be computed in a single linear pass. Only transforms which have changed
+// since the last update, along with their descendants, are recomputed.
+//
+// Updating doesn't make any structural changes or advance the entity manager's tick, so it can run as a system alongside
+// others which don't touch transforms. Entities which don't yet have a WorldTransform get one added through the given
+// command buffer, which must be applied before the next update. The tick is expected to be advanced at a sync point
+// between updates, e.g. once per frame.
+class TransformPropagator {
+    struct Node {
+        EntityId entity;
+        EntityId parent;
+        uint32_t parent_slot;
+    };
+
+    Vector<Node> m_nodes;
+    Vector<Mat4f> m_world_matrices;
+    Vector<uint8_t> m_dirty;
+    // Entity index to node slot.
+    Vector<uint32_t, EntityId> m_slots;
+    uint32_t m_last_tick{0};
+
+    bool hierarchy_changed(EntityManager &manager, uint32_t since);
+    void sort(EntityManager &manager);
+
+public:
+    void update(EntityManager &manager, EcsCommandBuffer &commands);
+};
+
+} // namespace vull
@@ -34,4 +34,36 @@ void ScopedLock<MutexType>::unlock() {
     m_mutex = nullptr;
 }
 
+template <typename MutexType>
+class SharedScopedLock {
+    MutexType *m_mutex;
+
+public:
+    explicit SharedScopedLock(MutexType &mutex) : m_mutex(&mutex) { mutex.lock_shared(); }
+    SharedScopedLock(const SharedScopedLock &) = delete;
+    SharedScopedLock(SharedScopedLock &&) = delete;
+    ~SharedScopedLock();
+
+    SharedScopedLock &operator=(const SharedScopedLock &) = delete;
+    SharedScopedLock &operator=(SharedScopedLock &&) = delete;
+
+    void unlock();
+};
+
+template <typename MutexType>
+SharedScopedLock(MutexType &) -> SharedScopedLock<MutexType>;
+
+template <typename MutexType>
+SharedScopedLock<MutexType>::~SharedScopedLock() {
+    if (m_mutex != nullptr) {
+        m_mutex->unlock_shared();
+    }
+}
+
+template <typename MutexType>
+void SharedScopedLock<MutexType>::unlock() {
+    m_mutex->unlock_shared();
+    m_mutex = nullptr;
+}
+
 } // namespace vull
@@ -14,6 +14,7 @@ struct TupleElem {
     static T elem_type(TupleTag<I>);
     [[no_unique_address]] T value;
     constexpr decltype(auto) operator[](TupleTag<I>) & { return (value); }
+    constexpr decltype(auto) operator[](TupleTag<I>) const & { return (value); }
 };
 
 template <typename, typename...>
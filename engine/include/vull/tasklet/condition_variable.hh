@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vull/platform/system_mutex.hh>
+#include <vull/tasklet/wait_queue.hh>
+
+namespace vull {
+
+class Mutex;
+
+// Condition variable for use with a tasklet Mutex. Waiting parks the tasklet rather than the thread.
+class ConditionVariable {
+    SystemMutex m_lock;
+    WaitQueue m_queue;
+
+public:
+    ConditionVariable() = default;
+    ConditionVariable(const ConditionVariable &) = delete;
+    ConditionVariable(ConditionVariable &&) = delete;
+    ~ConditionVariable() = default;
+
+    ConditionVariable &operator=(const ConditionVariable &) = delete;
+    ConditionVariable &operator=(ConditionVariable &&) = delete;
+
+    // Atomically unlocks the given mutex and waits to be notified, relocking the mutex before returning.
+    void wait(Mutex &mutex);
+    template <typename F>
+    void wait(Mutex &mutex, F predicate);
+
+    void notify_one();
+    void notify_all();
+};
+
+template <typename F>
+void ConditionVariable::wait(Mutex &mutex, F predicate) {
+    while (!predicate()) {
+        wait(mutex);
+    }
+}
+
+} // namespace vull
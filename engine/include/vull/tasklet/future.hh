@@ -0,0 +1,480 @@
+#pragma once
+
+#include <vull/container/vector.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/optional.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/tasklet.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+template <typename T, typename... Es>
+class Future;
+template <typename T, typename... Es>
+class Promise;
+
+namespace detail {
+
+class FutureStateBase;
+
+// Something that wants to be notified (on the settling thread) when a future state settles. Only one waiter may be
+// attached to a state, but any number of tasklets may additionally await it.
+class FutureWaiter {
+public:
+    virtual void notify(FutureStateBase &state) = 0;
+};
+
+class FutureStateBase {
+    enum class Status : uint8_t {
+        Pending,
+        Fulfilled,
+        Abandoned,
+    };
+
+    Latch m_latch{1};
+    Atomic<FutureWaiter *> m_waiter{nullptr};
+    Atomic<uint32_t> m_ref_count{1};
+    Atomic<Status> m_status{Status::Pending};
+    Atomic<bool> m_cancelled{false};
+
+protected:
+    void settle(bool fulfilled);
+
+public:
+    FutureStateBase() = default;
+    FutureStateBase(const FutureStateBase &) = delete;
+    FutureStateBase(FutureStateBase &&) = delete;
+    virtual ~FutureStateBase() = default;
+
+    FutureStateBase &operator=(const FutureStateBase &) = delete;
+    FutureStateBase &operator=(FutureStateBase &&) = delete;
+
+    void add_ref() { m_ref_count.fetch_add(1, vull::memory_order_relaxed); }
+    void release();
+
+    void abandon() { settle(false); }
+    virtual void cancel() { m_cancelled.store(true, vull::memory_order_release); }
+    void set_waiter(FutureWaiter *waiter);
+    void wait() { m_latch.wait(); }
+
+    bool is_cancelled() const { return m_cancelled.load(vull::memory_order_acquire); }
+    bool is_fulfilled() const { return m_status.load(vull::memory_order_acquire) == Status::Fulfilled; }
+    bool is_settled() const { return m_status.load(vull::memory_order_acquire) != Status::Pending; }
+};
+
+template <typename T, typename... Es>
+class FutureState : public FutureStateBase {
+    Optional<Result<T, Es...>> m_result;
+
+public:
+    template <typename... Args>
+    void fulfil(Args &&...args);
+
+    const Result<T, Es...> &result() const;
+    Result<T, Es...> take_result();
+};
+
+template <typename T, typename... Es>
+template <typename... Args>
+void FutureState<T, Es...>::fulfil(Args &&...args) {
+    m_result.emplace(vull::forward<Args>(args)...);
+    settle(true);
+}
+
+template <typename T, typename... Es>
+const Result<T, Es...> &FutureState<T, Es...>::result() const {
+    VULL_ASSERT(is_fulfilled());
+    return *m_result;
+}
+
+template <typename T, typename... Es>
+Result<T, Es...> FutureState<T, Es...>::take_result() {
+    VULL_ASSERT(is_fulfilled(), "Awaited an abandoned future");
+    auto &result = *m_result;
+    if constexpr (sizeof...(Es) != 0) {
+        if (result.is_error()) {
+            return result.error();
+        }
+    }
+    if constexpr (is_same<T, void>) {
+        return {};
+    } else {
+        return vull::move(result.value());
+    }
+}
+
+template <typename T, typename... Es>
+class WhenAllState final : public FutureState<void, Es...>, public FutureWaiter {
+    Vector<FutureState<T, Es...> *> m_inputs;
+    Atomic<uint32_t> m_remaining;
+    Atomic<bool> m_done;
+
+public:
+    explicit WhenAllState(Span<Future<T, Es...>> futures);
+    WhenAllState(const WhenAllState &) = delete;
+    WhenAllState(WhenAllState &&) = delete;
+    ~WhenAllState() override;
+
+    WhenAllState &operator=(const WhenAllState &) = delete;
+    WhenAllState &operator=(WhenAllState &&) = delete;
+
+    void attach();
+    void cancel() override;
+    void notify(FutureStateBase &input) override;
+};
+
+template <typename T, typename... Es>
+class WhenAnyState final : public FutureState<uint32_t>, public FutureWaiter {
+    Vector<FutureState<T, Es...> *> m_inputs;
+    Atomic<uint32_t> m_remaining;
+    Atomic<bool> m_done;
+
+public:
+    explicit WhenAnyState(Span<Future<T, Es...>> futures);
+    WhenAnyState(const WhenAnyState &) = delete;
+    WhenAnyState(WhenAnyState &&) = delete;
+    ~WhenAnyState() override;
+
+    WhenAnyState &operator=(const WhenAnyState &) = delete;
+    WhenAnyState &operator=(WhenAnyState &&) = delete;
+
+    void attach();
+    void cancel() override;
+    void notify(FutureStateBase &input) override;
+};
+
+} // namespace detail
+
+template <typename T, typename... Es>
+class Future {
+    static_assert(!is_ref<T>, "Futures of references are not supported");
+    template <typename, typename...>
+    friend class Promise;
+    template <typename, typename...>
+    friend class detail::WhenAllState;
+    template <typename, typename...>
+    friend class detail::WhenAnyState;
+
+private:
+    detail::FutureState<T, Es...> *m_state{nullptr};
+
+public:
+    Future() = default;
+    explicit Future(detail::FutureState<T, Es...> *state) : m_state(state) {}
+    Future(const Future &) = delete;
+    Future(Future &&other) : m_state(vull::exchange(other.m_state, nullptr)) {}
+    ~Future();
+
+    Future &operator=(const Future &) = delete;
+    Future &operator=(Future &&);
+
+    // Parks the current tasklet until the future is settled and returns its result. The result may only be taken once.
+    Result<T, Es...> await();
+
+    // Parks the current tasklet until the future is settled, either by being fulfilled or by its promise being
+    // abandoned.
+    void wait() const;
+
+    // Requests that the producer doesn't start (or stops early). It is up to the producer whether this is honoured.
+    void cancel() const;
+
+    explicit operator bool() const { return m_state != nullptr; }
+    bool is_cancelled() const { return m_state->is_cancelled(); }
+    bool is_ready() const { return m_state->is_settled(); }
+};
+
+template <typename T, typename... Es>
+class Promise {
+    detail::FutureState<T, Es...> *m_state;
+    bool m_future_retrieved{false};
+
+public:
+    Promise() : m_state(new detail::FutureState<T, Es...>) {}
+    Promise(const Promise &) = delete;
+    Promise(Promise &&other)
+        : m_state(vull::exchange(other.m_state, nullptr)), m_future_retrieved(other.m_future_retrieved) {}
+    ~Promise();
+
+    Promise &operator=(const Promise &) = delete;
+    Promise &operator=(Promise &&) = delete;
+
+    Future<T, Es...> future();
+
+    // Settles the future without a value. Any tasklet awaiting the result will assert.
+    void abandon();
+    template <typename... Args>
+    void fulfil(Args &&...args);
+    template <typename... Fs>
+    void fulfil(Result<T, Fs...> &&result);
+
+    bool is_cancelled() const { return m_state->is_cancelled(); }
+};
+
+namespace detail {
+
+template <typename R>
+struct PromiseFor {
+    using type = Promise<R>;
+};
+template <typename T, typename... Es>
+struct PromiseFor<Result<T, Es...>> {
+    using type = Promise<T, Es...>;
+};
+
+template <typename T, typename... Es>
+WhenAllState<T, Es...>::WhenAllState(Span<Future<T, Es...>> futures)
+    : m_remaining(static_cast<uint32_t>(futures.size())) {
+    m_inputs.ensure_capacity(static_cast<uint32_t>(futures.size()));
+    for (auto &future : futures) {
+        VULL_ASSERT(future);
+        future.m_state->add_ref();
+        m_inputs.push(future.m_state);
+    }
+}
+
+template <typename T, typename... Es>
+WhenAllState<T, Es...>::~WhenAllState() {
+    for (auto *input : m_inputs) {
+        input->release();
+    }
+}
+
+template <typename T, typename... Es>
+void WhenAllState<T, Es...>::attach() {
+    if (m_inputs.empty()) {
+        m_done.store(true);
+        this->fulfil();
+        return;
+    }
+    for (auto *input : m_inputs) {
+        // Each attached waiter keeps this state alive until notified.
+        this->add_ref();
+        input->set_waiter(this);
+    }
+}
+
+template <typename T, typename... Es>
+void WhenAllState<T, Es...>::cancel() {
+    FutureStateBase::cancel();
+    for (auto *input : m_inputs) {
+        input->cancel();
+    }
+}
+
+template <typename T, typename... Es>
+void WhenAllState<T, Es...>::notify(FutureStateBase &base_input) {
+    auto &input = static_cast<FutureState<T, Es...> &>(base_input);
+    if (!input.is_fulfilled()) {
+        // An input was abandoned, either because it was cancelled or because its promise was destroyed without being
+        // fulfilled. Either way the result can never be complete, so cancel the other inputs and abandon the output.
+        if (!m_done.exchange(true, vull::memory_order_acq_rel)) {
+            cancel();
+            this->abandon();
+        }
+        this->release();
+        return;
+    }
+
+    if constexpr (sizeof...(Es) != 0) {
+        if (input.result().is_error()) {
+            // Fail fast on the first error and cancel everything else.
+            if (!m_done.exchange(true, vull::memory_order_acq_rel)) {
+                cancel();
+                this->fulfil(input.result().error());
+            }
+            this->release();
+            return;
+        }
+    }
+
+    if (m_remaining.fetch_sub(1, vull::memory_order_acq_rel) == 1 && !m_done.exchange(true)) {
+        this->fulfil();
+    }
+    this->release();
+}
+
+template <typename T, typename... Es>
+WhenAnyState<T, Es...>::WhenAnyState(Span<Future<T, Es...>> futures)
+    : m_remaining(static_cast<uint32_t>(futures.size())) {
+    m_inputs.ensure_capacity(static_cast<uint32_t>(futures.size()));
+    for (auto &future : futures) {
+        VULL_ASSERT(future);
+        future.m_state->add_ref();
+        m_inputs.push(future.m_state);
+    }
+}
+
+template <typename T, typename... Es>
+WhenAnyState<T, Es...>::~WhenAnyState() {
+    for (auto *input : m_inputs) {
+        input->release();
+    }
+}
+
+template <typename T, typename... Es>
+void WhenAnyState<T, Es...>::attach() {
+    VULL_ASSERT(!m_inputs.empty());
+    for (auto *input : m_inputs) {
+        this->add_ref();
+        input->set_waiter(this);
+    }
+}
+
+template <typename T, typename... Es>
+void WhenAnyState<T, Es...>::cancel() {
+    FutureStateBase::cancel();
+    for (auto *input : m_inputs) {
+        input->cancel();
+    }
+}
+
+template <typename T, typename... Es>
+void WhenAnyState<T, Es...>::notify(FutureStateBase &input) {
+    if (input.is_fulfilled()) {
+        if (!m_done.exchange(true, vull::memory_order_acq_rel)) {
+            uint32_t index = 0;
+            while (m_inputs[index] != &input) {
+                index++;
+            }
+            // The first input to settle wins, the rest are no longer needed.
+            cancel();
+            this->fulfil(index);
+        }
+    }
+    if (m_remaining.fetch_sub(1, vull::memory_order_acq_rel) == 1 && !m_done.exchange(true)) {
+        // Every input was abandoned.
+        this->abandon();
+    }
+    this->release();
+}
+
+} // namespace detail
+
+template <typename T, typename... Es>
+Future<T, Es...>::~Future() {
+    if (m_state != nullptr) {
+        m_state->release();
+    }
+}
+
+template <typename T, typename... Es>
+Future<T, Es...> &Future<T, Es...>::operator=(Future &&other) {
+    Future moved(vull::move(other));
+    vull::swap(m_state, moved.m_state);
+    return *this;
+}
+
+template <typename T, typename... Es>
+Result<T, Es...> Future<T, Es...>::await() {
+    VULL_ASSERT(m_state != nullptr);
+    m_state->wait();
+    return m_state->take_result();
+}
+
+template <typename T, typename... Es>
+void Future<T, Es...>::wait() const {
+    VULL_ASSERT(m_state != nullptr);
+    m_state->wait();
+}
+
+template <typename T, typename... Es>
+void Future<T, Es...>::cancel() const {
+    VULL_ASSERT(m_state != nullptr);
+    m_state->cancel();
+}
+
+template <typename T, typename... Es>
+Promise<T, Es...>::~Promise() {
+    if (m_state != nullptr) {
+        abandon();
+    }
+}
+
+template <typename T, typename... Es>
+Future<T, Es...> Promise<T, Es...>::future() {
+    VULL_ASSERT(m_state != nullptr && !m_future_retrieved);
+    m_future_retrieved = true;
+    m_state->add_ref();
+    return Future<T, Es...>(m_state);
+}
+
+template <typename T, typename... Es>
+void Promise<T, Es...>::abandon() {
+    VULL_ASSERT(m_state != nullptr);
+    m_state->abandon();
+    vull::exchange(m_state, nullptr)->release();
+}
+
+template <typename T, typename... Es>
+template <typename... Args>
+void Promise<T, Es...>::fulfil(Args &&...args) {
+    VULL_ASSERT(m_state != nullptr);
+    m_state->fulfil(vull::forward<Args>(args)...);
+    vull::exchange(m_state, nullptr)->release();
+}
+
+template <typename T, typename... Es>
+template <typename... Fs>
+void Promise<T, Es...>::fulfil(Result<T, Fs...> &&result) {
+    if constexpr (sizeof...(Fs) != 0) {
+        if (result.is_error()) {
+            fulfil(result.error());
+            return;
+        }
+    }
+    if constexpr (is_same<T, void>) {
+        fulfil();
+    } else {
+        fulfil(result.disown_value());
+    }
+}
+
+// Returns a future which is fulfilled once all of the given futures are successfully fulfilled, or with the first
+// error. On error, the remaining futures are cancelled. The values must be retrieved from the original futures.
+template <typename T, typename... Es>
+Future<void, Es...> when_all(Span<Future<T, Es...>> futures) {
+    auto *state = new detail::WhenAllState<T, Es...>(futures);
+    state->attach();
+    return Future<void, Es...>(state);
+}
+
+// Returns a future which is fulfilled with the index of the first of the given futures to be fulfilled, whether that is
+// with a value or an error. The remaining futures are cancelled.
+template <typename T, typename... Es>
+Future<uint32_t> when_any(Span<Future<T, Es...>> futures) {
+    auto *state = new detail::WhenAnyState<T, Es...>(futures);
+    state->attach();
+    return Future<uint32_t>(state);
+}
+
+// Schedules the given callable as a new tasklet and returns a future for its result. If the callable returns a Result,
+// the future carries the same value and error types. The tasklet is skipped if the future is cancelled before it runs.
+template <typename F>
+auto schedule_future(F &&callable, TaskletPriority priority = TaskletPriority::Normal) {
+    using promise_t = typename detail::PromiseFor<decltype(callable())>::type;
+    promise_t promise;
+    auto future = promise.future();
+    vull::schedule(
+        [promise = vull::move(promise), callable = vull::forward<F>(callable)]() mutable {
+            if (promise.is_cancelled()) {
+                promise.abandon();
+                return;
+            }
+            if constexpr (is_same<decltype(callable()), void>) {
+                callable();
+                promise.fulfil();
+            } else {
+                promise.fulfil(callable());
+            }
+        },
+        priority);
+    return future;
+}
+
+} // namespace vull
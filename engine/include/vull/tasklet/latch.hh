@@ -9,11 +9,15 @@ namespace vull {
 class Tasklet;
 
 class Latch {
+    // Once the value reaches zero, the wait list is swapped for this marker, after which the latch is no longer touched
+    // by count_down. Waiters check for the marker rather than the value so that the latch isn't destroyed too early.
+    static Tasklet *done_marker() { return reinterpret_cast<Tasklet *>(uintptr_t(1)); }
+
     Atomic<Tasklet *> m_wait_list;
     Atomic<uint32_t> m_value;
 
 public:
-    explicit Latch(uint32_t value) : m_value(value) {}
+    explicit Latch(uint32_t value) : m_wait_list(value == 0 ? done_marker() : nullptr), m_value(value) {}
 
     void count_down(uint32_t by = 1);
     bool try_wait() const;
@@ -1,23 +1,38 @@
 #pragma once
 
+#include <vull/platform/system_mutex.hh>
 #include <vull/support/atomic.hh>
+#include <vull/tasklet/wait_queue.hh>
 
 #include <stdint.h>
 
 namespace vull {
 
-class Tasklet;
-
 class Mutex {
-    Atomic<Tasklet *> m_wait_list;
-    Atomic<uint16_t> m_wait_count;
-    Atomic<bool> m_locked;
+    static constexpr uint32_t k_locked_bit = 1u << 0u;
+    static constexpr uint32_t k_waiters_bit = 1u << 1u;
+
+    Atomic<uint32_t> m_state;
+    SystemMutex m_lock;
+    WaitQueue m_queue;
+
+    void lock_slow(uint32_t state);
+    void unlock_slow();
 
 public:
+    Mutex() = default;
+    Mutex(const Mutex &) = delete;
+    Mutex(Mutex &&) = delete;
+    ~Mutex() = default;
+
+    Mutex &operator=(const Mutex &) = delete;
+    Mutex &operator=(Mutex &&) = delete;
+
     void lock();
+    bool try_lock();
     void unlock();
 
-    bool locked() const { return m_locked.load(); }
+    bool locked() const { return (m_state.load() & k_locked_bit) != 0; }
 };
 
 } // namespace vull
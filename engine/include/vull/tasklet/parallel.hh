@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vull/container/array.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/tasklet.hh>
+
+#include <stdint.h>
+
+namespace vull {
+namespace detail {
+
+// A range split off to another tasklet, which the splitting tasklet joins on once its own part is done.
+template <typename T>
+struct ParallelJoin {
+    T result{};
+    Latch latch{1};
+};
+
+// Each split halves the range, so no more than 32 can be outstanding for a 32-bit range.
+constexpr uint32_t k_max_parallel_splits = 32;
+
+template <typename T, typename F, typename C>
+void parallel_reduce_range(uint32_t begin, uint32_t end, uint32_t grain, F &fn, C &combine, T &result) {
+    const auto priority = Tasklet::current()->priority();
+    Array<ParallelJoin<T>, k_max_parallel_splits> joins;
+    uint32_t join_count = 0;
+
+    // Lazy binary splitting: rather than eagerly splitting down to the grain size, only split off the back half of the
+    // remaining range when this worker has nothing queued for idle workers to steal. Otherwise carry on with the next
+    // grain-sized chunk.
+    while (end - begin > grain) {
+        if (join_count < joins.size() && vull::local_queue_empty(priority)) {
+            const auto middle = begin + (end - begin) / 2;
+            auto &join = joins[join_count++];
+            vull::schedule(
+                [&fn, &combine, &join, middle, end, grain] {
+                    parallel_reduce_range(middle, end, grain, fn, combine, join.result);
+                    join.latch.count_down();
+                },
+                priority);
+            end = middle;
+            continue;
+        }
+        for (const auto chunk_end = begin + grain; begin < chunk_end; begin++) {
+            fn(result, begin);
+        }
+    }
+    for (; begin < end; begin++) {
+        fn(result, begin);
+    }
+
+    // Split off ranges are in reverse order, combine them back in index order.
+    while (join_count > 0) {
+        auto &join = joins[--join_count];
+        join.latch.wait();
+        combine(result, vull::move(join.result));
+    }
+}
+
+struct ParallelForEmpty {};
+
+} // namespace detail
+
+// Reduces the range [begin, end) by calling fn(T &accumulator, uint32_t index) for each index, starting from a value
+// initialised T. The range is adaptively split between tasklets in chunks of at least grain indices, with the partial
+// results merged by combine(T &accumulator, T &&other), where other always covers later indices than accumulator. No
+// memory is allocated other than the tasklets themselves. Falls back to a serial loop outside of a tasklet.
+template <typename T, typename F, typename C>
+T parallel_reduce(uint32_t begin, uint32_t end, uint32_t grain, F &&fn, C &&combine) {
+    VULL_ASSERT(grain != 0 && begin <= end);
+    T result{};
+    if (Tasklet::current() == nullptr) {
+        for (uint32_t index = begin; index < end; index++) {
+            fn(result, index);
+        }
+        return result;
+    }
+    detail::parallel_reduce_range(begin, end, grain, fn, combine, result);
+    return result;
+}
+
+// Calls fn(uint32_t index) for each index in [begin, end), split between tasklets as with parallel_reduce. Returns once
+// all calls have completed.
+template <typename F>
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, F &&fn) {
+    vull::parallel_reduce<detail::ParallelForEmpty>(
+        begin, end, grain,
+        [&fn](detail::ParallelForEmpty &, uint32_t index) {
+            fn(index);
+        },
+        [](detail::ParallelForEmpty &, detail::ParallelForEmpty &&) {});
+}
+
+} // namespace vull
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <vull/container/array.hh>
 #include <vull/container/vector.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/atomic.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 #include <vull/tasklet/tasklet.hh>
@@ -10,17 +13,66 @@
 
 namespace vull {
 
+class InjectionQueue;
 class TaskletQueue;
 
+struct SchedulerStats {
+    uint64_t scheduled_count;
+    // Syscalls made by idle workers, either to yield or to sleep.
+    uint64_t park_syscall_count;
+    // Syscalls made to wake sleeping workers.
+    uint64_t wake_syscall_count;
+    // Lower priority tasklets which made way for critical work at a preemption point.
+    uint64_t preemption_count;
+    // Tasklets taken from other workers' queues.
+    uint64_t steal_count;
+    // Attempts to steal which found every other worker's queue empty.
+    uint64_t failed_steal_count;
+    // Switches from one tasklet to another on a worker.
+    uint64_t context_switch_count;
+    // Total time workers have spent asleep waiting for work.
+    uint64_t parked_ns;
+    // Failures to create a tasklet due to running out of stack memory. Process wide rather than per scheduler.
+    uint64_t pool_exhausted_count;
+};
+
 class Scheduler {
+    enum class ParkState : uint32_t {
+        Running,
+        Parked,
+        Sleeping,
+        Notified,
+    };
+
     struct Worker {
         Scheduler &scheduler;
-        UniquePtr<TaskletQueue> queue;
+        Array<UniquePtr<TaskletQueue>, k_tasklet_priority_count> queues;
         pthread_t thread;
+        uint32_t index;
+
+        // Futex word used to put the worker to sleep when there is no work.
+        Atomic<ParkState> park_state;
+
+        // Only written by the worker itself.
+        SchedulerStats stats;
     };
     Vector<UniquePtr<Worker>> m_workers;
+    Array<UniquePtr<InjectionQueue>, k_tasklet_priority_count> m_injection_queues;
+    Atomic<uint32_t> m_parked_count;
+    Atomic<uint64_t> m_external_scheduled_count;
+    Atomic<uint64_t> m_external_wake_count;
+    Atomic<uint64_t> m_frame_deadline;
+    Atomic<uint64_t> m_last_trim_time;
+    Timer m_timer;
+    uint32_t m_steal_batch_limit;
 
     static void *worker_entry(void *);
+    Tasklet *steal(uint32_t priority, TaskletQueue &own_queue, uint32_t &rng_state);
+    Tasklet *find_work(Worker &worker);
+    Tasklet *park(Worker &worker);
+    bool wake(Worker &worker);
+    void wake_one();
+    void maybe_trim();
 
 public:
     static Scheduler &current();
@@ -33,19 +85,50 @@ public:
     Scheduler &operator=(const Scheduler &) = delete;
     Scheduler &operator=(Scheduler &&) = delete;
 
-    TaskletQueue &pick_victim(uint32_t &rng_state);
+    Tasklet *wait_for_work();
+    void notify_scheduled();
+    void notify_preempted();
+    bool should_preempt(TaskletPriority priority) const;
 
     template <typename F>
     bool start(F &&callable);
     bool start(Tasklet *tasklet);
     void stop();
+
+    template <typename F>
+    bool inject(F &&callable, TaskletPriority priority = TaskletPriority::Normal);
+    bool inject(Tasklet *tasklet);
+
+    // Sets a deadline for the current frame, after which normal priority tasklets also make way for critical work at
+    // preemption points. Background tasklets always make way for critical work.
+    void set_frame_deadline(float budget);
+    void clear_frame_deadline();
+
+    // Sets the maximum number of tasklets taken from another worker's queue in one steal. A limit of one restores the
+    // classic steal-one behaviour.
+    void set_steal_batch_limit(uint32_t limit);
+
+    // Returns the sum of the worker counters. Only approximate whilst the scheduler is running.
+    SchedulerStats stats() const;
+    uint32_t worker_count() const { return m_workers.size(); }
 };
 
 template <typename F>
 bool Scheduler::start(F &&callable) {
-    auto *tasklet = Tasklet::create_large();
+    auto *tasklet = Tasklet::create();
     tasklet->set_callable(vull::forward<F>(callable));
     return start(tasklet);
 }
 
+template <typename F>
+bool Scheduler::inject(F &&callable, TaskletPriority priority) {
+    auto *tasklet = Tasklet::create();
+    if (tasklet == nullptr) {
+        return false;
+    }
+    tasklet->set_callable(vull::forward<F>(callable));
+    tasklet->set_priority(priority);
+    return inject(tasklet);
+}
+
 } // namespace vull
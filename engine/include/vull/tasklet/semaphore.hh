@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vull/platform/system_mutex.hh>
+#include <vull/support/atomic.hh>
+#include <vull/tasklet/wait_queue.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+// Counting semaphore which parks the waiting tasklet rather than the thread.
+class Semaphore {
+    Atomic<uint32_t> m_count;
+    Atomic<uint32_t> m_waiter_count;
+    SystemMutex m_lock;
+    WaitQueue m_queue;
+
+public:
+    explicit Semaphore(uint32_t count) : m_count(count) {}
+    Semaphore(const Semaphore &) = delete;
+    Semaphore(Semaphore &&) = delete;
+    ~Semaphore() = default;
+
+    Semaphore &operator=(const Semaphore &) = delete;
+    Semaphore &operator=(Semaphore &&) = delete;
+
+    void acquire();
+    bool try_acquire();
+    void release(uint32_t count = 1);
+
+    uint32_t count() const { return m_count.load(); }
+};
+
+} // namespace vull
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vull/platform/system_mutex.hh>
+#include <vull/support/atomic.hh>
+#include <vull/tasklet/wait_queue.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+// Reader/writer lock which parks the waiting tasklet rather than the thread. Waiters are served in order, so once a
+// writer is waiting, new readers queue up behind it rather than starving it.
+class SharedMutex {
+    static constexpr uint32_t k_writer_bit = 1u << 31u;
+    static constexpr uint32_t k_waiters_bit = 1u << 30u;
+    static constexpr uint32_t k_reader_mask = k_waiters_bit - 1;
+
+    // Packed as [writer:1][waiters:1][readers:30]. The waiters bit forces everyone onto the slow path.
+    Atomic<uint32_t> m_state;
+    SystemMutex m_lock;
+    WaitQueue m_queue;
+
+    void wait(uint32_t state, bool exclusive);
+    void grant(WaitQueue &to_wake);
+    void release_slow(uint32_t clear);
+
+public:
+    SharedMutex() = default;
+    SharedMutex(const SharedMutex &) = delete;
+    SharedMutex(SharedMutex &&) = delete;
+    ~SharedMutex() = default;
+
+    SharedMutex &operator=(const SharedMutex &) = delete;
+    SharedMutex &operator=(SharedMutex &&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+};
+
+} // namespace vull
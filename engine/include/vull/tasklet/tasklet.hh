@@ -8,6 +8,17 @@
 
 namespace vull {
 
+// Workers always prefer higher priority work. Lower priority tasklets make way for pending critical work at preemption
+// points, see vull::preemption_point.
+enum class TaskletPriority : uint8_t {
+    // Work which the current frame is waiting on.
+    Critical,
+    Normal,
+    // Work such as streaming and IO which can happily be delayed to a later frame.
+    Background,
+};
+constexpr uint32_t k_tasklet_priority_count = 3;
+
 enum class TaskletState {
     Uninitialised,
     Running,
@@ -16,29 +27,52 @@ enum class TaskletState {
 };
 
 class Tasklet {
-    void (*m_invoker)(const uint8_t *);
+    void (*m_invoker)(uint8_t *);
     void *m_stack_top;
 #if VULL_ASAN_ENABLED
     size_t m_stack_size;
     void *m_fake_stack{nullptr};
 #endif
-    void *m_pool{nullptr};
+    // Lowest address of the stack which is accessible, below which the stack is grown on demand.
+    uintptr_t m_committed_bottom;
+    TaskletPriority m_priority{TaskletPriority::Normal};
     Atomic<Tasklet *> m_linked_tasklet{nullptr};
     Atomic<TaskletState> m_state{TaskletState::Uninitialised};
 
+    // The callable is destroyed straight after being invoked, whilst still on the tasklet's own stack.
+    template <typename F>
+    static void invoke_helper(uint8_t *inline_storage) {
+        auto &callable = *reinterpret_cast<F *>(inline_storage);
+        callable();
+        callable.~F();
+    }
+
     template <typename F>
-    static void invoke_helper(const uint8_t *inline_storage) {
-        // NOLINTNEXTLINE: const_cast
-        const_cast<F &>((reinterpret_cast<const F &>(*inline_storage)))();
+    static void invoke_outline_helper(uint8_t *inline_storage) {
+        auto *callable = *reinterpret_cast<F **>(inline_storage);
+        (*callable)();
+        delete callable;
     }
 
 public:
+    // Sets the maximum stack size, and the number of idle stacks which are kept resident in memory. Must be called before
+    // any tasklets are created. Stacks start small and are grown on demand up to the maximum size.
+    static void configure(size_t stack_size, uint32_t resident_limit);
+    // Returns the memory of idle stacks over the resident limit back to the kernel.
+    static void trim();
+    // Returns the number of times creating a tasklet has failed due to running out of stack memory.
+    static uint64_t exhausted_count();
     static Tasklet *create();
-    static Tasklet *create_large();
     static Tasklet *current();
     bool is_guard_page(uintptr_t page) const;
 
-    Tasklet(size_t size, void *pool);
+    // Makes more of the stack accessible after a fault at the given address. Returns false if the address isn't in the
+    // growable part of the stack, e.g. on a stack overflow. Called from the segfault handler.
+    bool grow_stack(uintptr_t address);
+    // Gives back any stack memory beyond the first committed_size bytes.
+    void shrink_stack(size_t committed_size);
+
+    Tasklet(size_t size, size_t committed_size);
     Tasklet(const Tasklet &) = delete;
     Tasklet(Tasklet &&) = delete;
     ~Tasklet() = delete;
@@ -50,78 +84,81 @@ public:
     template <typename F>
     void set_callable(F &&callable);
     void set_linked_tasklet(Tasklet *tasklet) { m_linked_tasklet.store(tasklet); }
+    void set_priority(TaskletPriority priority) { m_priority = priority; }
     void set_state(TaskletState state) { m_state.store(state); }
 
     void *stack_top() const { return m_stack_top; }
-    void *pool() const { return m_pool; }
+    TaskletPriority priority() const { return m_priority; }
     Tasklet *linked_tasklet() const { return m_linked_tasklet.load(); }
     TaskletState state() const { return m_state.load(); }
 };
 
-inline Tasklet::Tasklet(size_t size, void *pool) : m_pool(pool) {
+inline Tasklet::Tasklet(size_t size, size_t committed_size) {
     m_stack_top = reinterpret_cast<uint8_t *>(this) + size;
+    m_committed_bottom = reinterpret_cast<uintptr_t>(m_stack_top) - committed_size;
 }
 
+// The callable is stored inline in the rest of the tasklet's header page, which is at least 4 KiB. Anything larger, or
+// which needs a larger alignment than the tasklet itself, is moved to the heap.
+constexpr size_t k_tasklet_inline_capacity = 4096 - sizeof(Tasklet);
+
 inline void Tasklet::invoke() {
     m_invoker(reinterpret_cast<uint8_t *>(this + 1));
 }
 
 template <typename F>
 void Tasklet::set_callable(F &&callable) {
-    new (this + 1) F(vull::forward<F>(callable));
-    m_invoker = &invoke_helper<F>;
+    using CallableType = decay<F>;
+    [[maybe_unused]] size_t inline_size;
+    if constexpr (sizeof(CallableType) <= k_tasklet_inline_capacity && alignof(CallableType) <= alignof(Tasklet)) {
+        new (this + 1) CallableType(vull::forward<F>(callable));
+        m_invoker = &invoke_helper<CallableType>;
+        inline_size = sizeof(CallableType);
+    } else {
+        new (this + 1) CallableType *(new CallableType(vull::forward<F>(callable)));
+        m_invoker = &invoke_outline_helper<CallableType>;
+        inline_size = sizeof(CallableType *);
+    }
 #if VULL_ASAN_ENABLED
     const auto size =
         reinterpret_cast<ptrdiff_t>(reinterpret_cast<uint8_t *>(m_stack_top) - reinterpret_cast<uint8_t *>(this));
-    m_stack_size = size - sizeof(Tasklet) - sizeof(F);
+    m_stack_size = size - sizeof(Tasklet) - inline_size;
 #endif
 }
 
 void pump_work();
+void pump_if_backlogged(TaskletPriority priority);
+// Returns whether the calling worker has nothing of the given priority queued for other workers to steal.
+bool local_queue_empty(TaskletPriority priority);
+// Returns the index of the calling worker thread, which is stable for the duration of any code that doesn't yield.
+uint32_t worker_index();
+void preemption_point();
 bool try_schedule(Tasklet *tasklet);
 void schedule(Tasklet *tasklet);
 void yield();
 
 template <typename F>
-bool try_schedule(F &&callable) {
+bool try_schedule(F &&callable, TaskletPriority priority = TaskletPriority::Normal) {
     auto *tasklet = Tasklet::create();
     if (tasklet == nullptr) {
         return false;
     }
     tasklet->set_callable(vull::forward<F>(callable));
+    tasklet->set_priority(priority);
     return try_schedule(tasklet);
 }
 
 template <typename F>
-bool try_schedule_large(F &&callable) {
-    auto *tasklet = Tasklet::create_large();
-    if (tasklet == nullptr) {
-        return false;
-    }
-    tasklet->set_callable(vull::forward<F>(callable));
-    return try_schedule(tasklet);
-}
-
-template <typename F>
-void schedule(F &&callable) {
+void schedule(F &&callable, TaskletPriority priority = TaskletPriority::Normal) {
     auto *tasklet = Tasklet::create();
     while (tasklet == nullptr) {
         pump_work();
         tasklet = Tasklet::create();
     }
     tasklet->set_callable(vull::forward<F>(callable));
+    tasklet->set_priority(priority);
     schedule(tasklet);
-}
-
-template <typename F>
-void schedule_large(F &&callable) {
-    auto *tasklet = Tasklet::create_large();
-    while (tasklet == nullptr) {
-        pump_work();
-        tasklet = Tasklet::create_large();
-    }
-    tasklet->set_callable(vull::forward<F>(callable));
-    schedule(tasklet);
+    pump_if_backlogged(priority);
 }
 
 } // namespace vull
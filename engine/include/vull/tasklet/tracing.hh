@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vull/support/result.hh>
+#include <vull/support/string_view.hh>
+
+#include <stdint.h>
+
+// Scheduler tracing is compiled out unless the VULL_TRACING CMake option is enabled, in which case each thread records
+// events into its own fixed size ring buffer, overwriting the oldest events once full.
+#ifndef VULL_TRACING
+#define VULL_TRACING 0
+#endif
+
+namespace vull {
+
+enum class StreamError;
+struct Stream;
+
+} // namespace vull
+
+namespace vull::tracing {
+
+enum class EventKind : uint8_t {
+    // A tasklet running on a worker, from being switched to until it yields, is requeued or finishes.
+    TaskletRun,
+    // A worker asleep waiting for work.
+    Park,
+    // A worker taking a batch of tasklets from another worker.
+    Steal,
+    // A worker failing to find any work to run or steal before parking.
+    StealFailed,
+    // A tasklet failing to be created due to running out of stacks.
+    PoolExhausted,
+    // A user labelled zone, see vull::tracing::Zone.
+    Zone,
+};
+
+// Returns the time in nanoseconds since tracing started.
+uint64_t now();
+
+#if VULL_TRACING
+// Records an event to the calling thread's ring buffer. Instant events have begin == end. The label must outlive the
+// trace, e.g. a string literal or a string returned by intern().
+void record(EventKind kind, uint64_t begin, uint64_t end, const char *label = nullptr, uint64_t arg = 0);
+
+// Returns a copy of the given string which lives until the process exits, for use as a label which would otherwise not
+// outlive the trace. Equal strings share the same copy.
+const char *intern(StringView string);
+#else
+inline void record(EventKind, uint64_t, uint64_t, const char * = nullptr, uint64_t = 0) {}
+inline const char *intern(StringView) {
+    return "";
+}
+#endif
+
+// Writes the events currently held by all threads' ring buffers in the Chrome trace event JSON format, which can be
+// loaded into Perfetto or chrome://tracing. Safe to call whilst other threads are still recording, in which case any
+// events overwritten during the write are dropped. Writes an empty trace if tracing is compiled out.
+Result<void, StreamError> write_chrome_json(Stream &stream);
+
+// Scoped zone which records the time between its construction and destruction.
+class Zone {
+#if VULL_TRACING
+    const char *m_label;
+    uint64_t m_begin;
+#endif
+
+public:
+#if VULL_TRACING
+    explicit Zone(const char *label) : m_label(label), m_begin(now()) {}
+    ~Zone() { record(EventKind::Zone, m_begin, now(), m_label); }
+#else
+    explicit Zone(const char *) {}
+    ~Zone() = default;
+#endif
+    Zone(const Zone &) = delete;
+    Zone(Zone &&) = delete;
+
+    Zone &operator=(const Zone &) = delete;
+    Zone &operator=(Zone &&) = delete;
+};
+
+} // namespace vull::tracing
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vull/tasklet/tasklet.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+// Intrusive FIFO queue of tasklets waiting on a synchronisation primitive. Waiters live on the stack of the waiting
+// tasklet. Not thread safe by itself, the owning primitive is expected to hold its own lock whilst modifying the queue.
+class WaitQueue {
+public:
+    struct Waiter {
+        Tasklet *tasklet;
+        Waiter *next{nullptr};
+        // Primitive specific, e.g. whether a SharedMutex waiter wants exclusive access.
+        uint32_t data{0};
+    };
+
+private:
+    Waiter *m_head{nullptr};
+    Waiter *m_tail{nullptr};
+
+public:
+    void push(Waiter &waiter);
+    Waiter *pop();
+    Waiter *peek() const { return m_head; }
+    bool empty() const { return m_head == nullptr; }
+
+    // Schedules the tasklet of a popped waiter, which must not be touched afterwards.
+    static void wake(Waiter &waiter);
+};
+
+inline void WaitQueue::push(Waiter &waiter) {
+    waiter.next = nullptr;
+    if (m_tail != nullptr) {
+        m_tail->next = &waiter;
+    } else {
+        m_head = &waiter;
+    }
+    m_tail = &waiter;
+}
+
+inline WaitQueue::Waiter *WaitQueue::pop() {
+    auto *waiter = m_head;
+    if (waiter != nullptr && (m_head = waiter->next) == nullptr) {
+        m_tail = nullptr;
+    }
+    return waiter;
+}
+
+inline void WaitQueue::wake(Waiter &waiter) {
+    // The waiter may not have yielded yet.
+    auto *tasklet = waiter.tasklet;
+    while (tasklet->state() == TaskletState::Running) {
+    }
+    vull::schedule(tasklet);
+}
+
+} // namespace vull
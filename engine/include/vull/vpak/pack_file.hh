@@ -14,11 +14,23 @@
  * };
  *
  * struct EntryHeader {
- *     EntryType(u8) type;
+ *     EntryType(u8) type; // with k_seekable_entry_flag set for seekable entries
  *     v64 name_length;
  *     u8 name[name_length];
  *     v32 size; // uncompressed size in bytes
  *     v64 first_block;
+ *     // Only present for seekable entries.
+ *     v32 frame_size;
+ *     v64 block_index;
+ * };
+ *
+ * // The data of an entry is normally a single zstd frame, split into blocks of ZSTD_CStreamOutSize bytes which are
+ * // each followed by the u64 offset of the next block. A seekable entry is instead compressed as a separate frame for
+ * // every frame_size bytes of uncompressed data, with each frame stored contiguously and without a link. The frames
+ * // are located through the block index. Identical frames, including entries made of a single block, may be shared
+ * // between entries.
+ * struct BlockIndex {
+ *     u64 frame_offsets[ceil(size / frame_size)];
  * };
  *
  * struct EntryTable {
@@ -46,13 +58,20 @@
  * struct World(type: 2) {
  *     struct ComponentSet {
  *         v32 entity_count;
+ *         // Raw little endian bytes for components without custom serialisation.
  *         u8 serialised_data[];
- *         v32 entity_ids[entity_count];
+ *         u32le entity_ids[entity_count];
  *     };
+ *     v32 version_marker; // 0xffffffff, never a valid entity count
+ *     v32 version; // 3
  *     v32 entity_count;
+ *     u32le entities[entity_count]; // full IDs, with free slots having the reserved index 0xffffff
  *     v32 set_count;
  *     ComponentSet sets[set_count];
  * };
+ *
+ * // Version 2 worlds have no entities array, with every entity up to entity_count being live. Version 1 worlds
+ * // additionally have no version marker or version, and store entity_ids as v32.
  */
 
 namespace vull::vpak {
@@ -87,12 +106,18 @@ enum class ImageWrapMode : uint8_t {
     Repeat,
 };
 
+constexpr uint8_t k_seekable_entry_flag = 1u << 7u;
+
 // Struct to represent an entry in memory, note not the same representation on disk.
 struct Entry {
     String name;
     uint64_t first_block;
+    uint64_t block_index;
     uint32_t size;
+    uint32_t frame_size;
     EntryType type;
+
+    bool seekable() const { return block_index != 0; }
 };
 
 } // namespace vull::vpak
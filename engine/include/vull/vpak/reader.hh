@@ -24,16 +24,31 @@ namespace vull::vpak {
 
 struct Entry;
 
+// Decompresses an entry a window of ZSTD_DStreamOutSize bytes at a time, serving reads from the window. Seeking in a
+// seekable entry only decompresses the frame containing the new position, otherwise the entry has to be decompressed
+// from the start up to it.
 class ReadStream final : public Stream {
     const Span<uint8_t> m_data;
-    size_t m_block_start;
+    const uint64_t m_first_block;
+    const uint64_t m_block_index;
+    const uint32_t m_size;
+    const uint32_t m_frame_size;
+    size_t m_block_start{0};
     size_t m_compressed_size{0};
     size_t m_offset{0};
     ZSTD_DCtx *m_dctx{nullptr};
     uint8_t *m_buffer{nullptr};
+    // The offset of the window into the uncompressed entry.
+    size_t m_buffer_position{0};
+    size_t m_buffer_head{0};
+    size_t m_buffer_size{0};
+    bool m_finished{false};
+
+    void restart();
+    void fill_buffer();
 
 public:
-    ReadStream(Span<uint8_t> data, size_t first_block);
+    ReadStream(Span<uint8_t> data, const Entry &entry);
     ReadStream(const ReadStream &) = delete;
     ReadStream(ReadStream &&) = delete;
     ~ReadStream() override;
@@ -41,8 +56,9 @@ public:
     ReadStream &operator=(const ReadStream &) = delete;
     ReadStream &operator=(ReadStream &&) = delete;
 
-    // TODO: override read_byte for a faster path.
+    Result<size_t, StreamError> seek(StreamOffset offset, SeekMode mode) override;
     Result<size_t, StreamError> read(Span<void> data) override;
+    Result<uint8_t, StreamError> read_byte() override;
 };
 
 class Reader {
@@ -62,6 +78,13 @@ public:
     bool exists(StringView name) const;
     UniquePtr<ReadStream> open(StringView name) const;
     Optional<Entry> stat(StringView name) const;
+
+    // Reads up to data.size() bytes of the entry starting at offset, returning the number of bytes read.
+    Result<size_t, StreamError> read_range(const Entry &entry, size_t offset, Span<void> data) const;
+
+    // Decompresses the whole entry into data, which must be at least entry.size bytes. The frames of a seekable entry
+    // are decompressed concurrently when called from a tasklet, otherwise the entry is read serially.
+    Result<void, StreamError> read_entry_parallel(const Entry &entry, Span<void> data) const;
     const Vector<Entry> &entries() const { return m_entries; }
 };
 
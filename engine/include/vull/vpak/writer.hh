@@ -1,11 +1,15 @@
 #pragma once
 
+#include <vull/container/array.hh>
+#include <vull/container/hash_map.hh>
 #include <vull/container/vector.hh>
+#include <vull/support/optional.hh>
 #include <vull/support/result.hh>
 #include <vull/support/span.hh>
 #include <vull/support/stream.hh>
 #include <vull/support/string.hh>
 #include <vull/support/unique_ptr.hh>
+#include <vull/tasklet/future.hh>
 #include <vull/tasklet/mutex.hh>
 #include <vull/vpak/pack_file.hh>
 
@@ -25,6 +29,8 @@ enum class CompressionLevel {
 };
 
 class WriteStream final : public Stream {
+    static constexpr uint32_t k_max_pending_frames = 16;
+
     Writer &m_writer;
     UniquePtr<Stream> m_stream;
     Entry &m_entry;
@@ -34,10 +40,23 @@ class WriteStream final : public Stream {
     uint32_t m_compress_head{0};
     uint32_t m_compressed_size{0};
 
+    // Only used for seekable entries, whose frames are compressed on other tasklets when written from a tasklet.
+    const bool m_seekable;
+    Vector<uint8_t, uint32_t> m_frame_input;
+    Array<Future<Vector<uint8_t, uint32_t>>, k_max_pending_frames> m_pending_frames;
+    uint32_t m_pending_head{0};
+    uint32_t m_pending_count{0};
+    Vector<uint64_t> m_frame_offsets;
+
+    Result<uint64_t, StreamError> write_deduplicated(Span<const void> data);
     Result<void, StreamError> flush_block();
+    Result<void, StreamError> submit_frame();
+    Result<void, StreamError> commit_frame(Span<const void> frame);
+    Result<void, StreamError> commit_pending_frame();
+    Result<void, StreamError> write_seekable(Span<const void> data);
 
 public:
-    WriteStream(Writer &writer, UniquePtr<Stream> &&stream, Entry &entry);
+    WriteStream(Writer &writer, UniquePtr<Stream> &&stream, Entry &entry, bool seekable);
     WriteStream(const WriteStream &) = delete;
     WriteStream(WriteStream &&) = delete;
     ~WriteStream() override;
@@ -54,12 +73,23 @@ class Writer {
     friend WriteStream;
 
 private:
+    struct StoredData {
+        uint64_t offset;
+        size_t size;
+    };
+
     UniquePtr<Stream> m_stream;
     const CompressionLevel m_clevel;
+    uint32_t m_zstd_worker_count{0};
     Vector<UniquePtr<Entry>> m_entries;
+    // Complete zstd frames written so far, keyed by the hash of their compressed bytes, so that identical frames of
+    // seekable entries and identical single block entries are only stored once.
+    HashMap<uint64_t, StoredData> m_stored_frames;
     Mutex m_mutex;
 
     Result<uint64_t, StreamError> allocate(size_t size);
+    Optional<StoredData> find_stored_frame(uint64_t hash);
+    void add_stored_frame(uint64_t hash, StoredData data);
     Result<void, StreamError> read_existing();
     void write_entry_table();
 
@@ -73,7 +103,15 @@ public:
     Writer &operator=(Writer &&) = delete;
 
     uint64_t finish();
-    WriteStream start_entry(String name, EntryType type);
+
+    // Sets the number of threads zstd spawns to compress each entry which isn't seekable. Returns false if zstd was
+    // built without multithreading support.
+    bool set_zstd_worker_count(uint32_t count);
+
+    // Starts writing a new entry. A seekable entry is compressed in independent frames so that it can be read from any
+    // offset, at the cost of a slightly worse compression ratio. The frames are also compressed in parallel when the
+    // entry is written from a tasklet.
+    WriteStream start_entry(String name, EntryType type, bool seekable = false);
 };
 
 } // namespace vull::vpak
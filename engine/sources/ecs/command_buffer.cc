@@ -0,0 +1,156 @@
+#include <vull/ecs/command_buffer.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/common.hh>
+#include <vull/support/algorithm.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/tasklet/tasklet.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vull {
+namespace {
+
+constexpr EntityId k_invalid_id = ~EntityId(0);
+
+} // namespace
+
+void *EcsCommandBuffer::Queue::allocate(size_t size, size_t alignment) {
+    block_head = vull::align_up(block_head, alignment);
+    if (blocks.empty() || block_head + size > k_block_size) {
+        // Blocks are kept after the buffer is cleared, so only allocate a new one if there isn't a spare.
+        if (!blocks.empty()) {
+            block_index++;
+        }
+        if (block_index == blocks.size()) {
+            blocks.push(vull::make_unique<Block>());
+        }
+        block_head = 0;
+    }
+    auto *ptr = blocks[block_index]->data.data() + block_head;
+    block_head += size;
+    return ptr;
+}
+
+EcsCommandBuffer::EcsCommandBuffer() {
+    const auto worker_count = Tasklet::current() != nullptr ? Scheduler::current().worker_count() : 0;
+    for (uint32_t i = 0; i < worker_count + 1; i++) {
+        m_queues.push(vull::make_unique<Queue>());
+    }
+}
+
+EcsCommandBuffer::~EcsCommandBuffer() {
+    clear();
+}
+
+uint32_t EcsCommandBuffer::current_queue_index() const {
+    if (Tasklet::current() == nullptr) {
+        return 0;
+    }
+    const auto index = vull::worker_index() + 1;
+    VULL_ENSURE(index < m_queues.size(), "Command buffer created outside of the recording scheduler");
+    return index;
+}
+
+void EcsCommandBuffer::push(uint32_t sort_key, CommandKind kind, EntityId id, void *component,
+                            void (*apply)(EntityManager &, EntityId, void *), void (*destruct)(void *)) {
+    auto &queue = *m_queues[current_queue_index()];
+    queue.commands.push({sort_key, kind, false, 0, id, component, apply, destruct});
+}
+
+void EcsCommandBuffer::push(uint32_t sort_key, CommandKind kind, PendingEntity entity, void *component,
+                            void (*apply)(EntityManager &, EntityId, void *), void (*destruct)(void *)) {
+    auto &queue = *m_queues[current_queue_index()];
+    queue.commands.push({sort_key, kind, true, entity.m_queue_index, entity.m_index, component, apply, destruct});
+}
+
+PendingEntity EcsCommandBuffer::create_entity(uint32_t sort_key) {
+    const auto queue_index = current_queue_index();
+    auto &queue = *m_queues[queue_index];
+    PendingEntity entity(queue_index, queue.pending_count++);
+    push(sort_key, CommandKind::Create, entity);
+    return entity;
+}
+
+void EcsCommandBuffer::destroy_entity(uint32_t sort_key, EntityId id) {
+    push(sort_key, CommandKind::Destroy, id);
+}
+
+void EcsCommandBuffer::apply(EntityManager &manager) {
+    struct CommandRef {
+        uint32_t sort_key;
+        uint32_t queue_index;
+        uint32_t command_index;
+    };
+    Vector<CommandRef> order;
+    order.ensure_capacity(command_count());
+    for (uint32_t queue_index = 0; queue_index < m_queues.size(); queue_index++) {
+        auto &queue = *m_queues[queue_index];
+        queue.created_ids.ensure_size(queue.pending_count, k_invalid_id);
+        for (uint32_t command_index = 0; command_index < queue.commands.size(); command_index++) {
+            order.push({queue.commands[command_index].sort_key, queue_index, command_index});
+        }
+    }
+    vull::sort(order, [](const CommandRef &lhs, const CommandRef &rhs) {
+        if (lhs.sort_key != rhs.sort_key) {
+            return lhs.sort_key > rhs.sort_key;
+        }
+        if (lhs.queue_index != rhs.queue_index) {
+            return lhs.queue_index > rhs.queue_index;
+        }
+        return lhs.command_index > rhs.command_index;
+    });
+
+    for (const auto &ref : order) {
+        auto &queue = *m_queues[ref.queue_index];
+        auto &command = queue.commands[ref.command_index];
+        if (command.kind == CommandKind::Create) {
+            queue.created_ids[command.entity] = manager.create_entity();
+            continue;
+        }
+
+        EntityId id = command.entity;
+        if (command.pending) {
+            id = m_queues[command.pending_queue]->created_ids[command.entity];
+            VULL_ENSURE(id != k_invalid_id, "Pending entity used before its creation");
+        }
+        if (command.kind == CommandKind::Destroy) {
+            manager.destroy_entity(id);
+            continue;
+        }
+        command.apply(manager, id, command.component);
+        // Added components are moved from and destructed by apply.
+        command.destruct = nullptr;
+    }
+    clear();
+}
+
+void EcsCommandBuffer::clear() {
+    for (auto &queue : m_queues) {
+        for (auto &command : queue->commands) {
+            if (command.destruct != nullptr) {
+                command.destruct(command.component);
+            }
+        }
+        queue->commands.clear();
+        queue->created_ids.clear();
+        queue->pending_count = 0;
+        queue->block_index = 0;
+        queue->block_head = 0;
+    }
+}
+
+uint32_t EcsCommandBuffer::command_count() const {
+    uint32_t count = 0;
+    for (const auto &queue : m_queues) {
+        count += queue->commands.size();
+    }
+    return count;
+}
+
+} // namespace vull
@@ -4,40 +4,179 @@
 #include <vull/ecs/entity_id.hh>
 #include <vull/ecs/sparse_set.hh>
 #include <vull/support/assert.hh>
+#include <vull/support/span.hh>
+#include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 
+#include <stddef.h>
+
 namespace vull {
 
-constexpr auto k_reserved_index = entity_index(~EntityId(0));
+namespace {
+
+// Free slots of the entity array hold the reserved index along with the version the next entity to use the slot will
+// get. A slot whose version would overflow is retired instead, so that a stale ID can never match a new entity.
+constexpr auto k_max_version = entity_version(~EntityId(0));
+
+// The free list is a binary min-heap so that the lowest free index is always reused first. This keeps live indices
+// packed towards zero, which lets high sparse set pages empty out and be freed.
+void heap_push(Vector<EntityId, EntityId> &heap, EntityId index) {
+    EntityId position = heap.size();
+    heap.push(index);
+    while (position > 0) {
+        const auto parent = (position - 1) / 2;
+        if (heap[parent] <= heap[position]) {
+            break;
+        }
+        vull::swap(heap[parent], heap[position]);
+        position = parent;
+    }
+}
 
-EntityManager::EntityManager() : m_free_head(k_reserved_index) {}
+EntityId heap_pop(Vector<EntityId, EntityId> &heap) {
+    const auto min = heap.first();
+    heap.first() = heap.last();
+    heap.pop();
+    for (EntityId position = 0;;) {
+        const auto left = position * 2 + 1;
+        const auto right = left + 1;
+        auto smallest = position;
+        if (left < heap.size() && heap[left] < heap[smallest]) {
+            smallest = left;
+        }
+        if (right < heap.size() && heap[right] < heap[smallest]) {
+            smallest = right;
+        }
+        if (smallest == position) {
+            break;
+        }
+        vull::swap(heap[position], heap[smallest]);
+        position = smallest;
+    }
+    return min;
+}
+
+} // namespace
 
 Entity EntityManager::create_entity() {
-    if (const auto index = m_free_head; index != k_reserved_index) {
-        VULL_ASSERT(entity_index(index) == index);
-        m_free_head = entity_index(m_entities[index]);
+    if (!m_free_indices.empty()) {
+        const auto index = heap_pop(m_free_indices);
         m_entities[index] = entity_id(index, entity_version(m_entities[index]));
         return {this, m_entities[index]};
     }
     // No IDs available to recycle, generate a new one.
     const auto next_index = m_entities.emplace(m_entities.size());
-    VULL_ASSERT(entity_index(next_index) == next_index);
+    VULL_ENSURE(next_index < k_reserved_entity_index, "Out of entity IDs");
     return {this, next_index};
 }
 
 void EntityManager::destroy_entity(EntityId id) {
+    VULL_ASSERT(valid(id));
     const auto index = entity_index(id);
+    for (size_t component_id = 0; component_id < m_component_sets.size(); component_id++) {
+        auto &set = m_component_sets[component_id];
+        if (!set.contains(index)) {
+            continue;
+        }
+        if (auto *group = m_component_groups[component_id]) {
+            ungroup_entity(*group, index);
+        }
+        set.remove(index);
+    }
+    if (entity_version(id) == k_max_version) {
+        m_entities[index] = entity_id(k_reserved_entity_index, k_max_version);
+        return;
+    }
+    m_entities[index] = entity_id(k_reserved_entity_index, entity_version(id) + 1);
+    heap_push(m_free_indices, index);
+}
+
+void EntityManager::rebuild_free_indices() {
+    m_free_indices.clear();
+    for (EntityId index = 0; index < m_entities.size(); index++) {
+        const auto id = m_entities[index];
+        if (entity_index(id) == k_reserved_entity_index && entity_version(id) != k_max_version) {
+            // Ascending order is already a valid heap.
+            m_free_indices.push(index);
+        }
+    }
+}
+
+Vector<EntityId> EntityManager::compact() {
+    Vector<EntityId> new_indices;
+    new_indices.ensure_size(m_entities.size(), k_reserved_entity_index);
+    EntityId live_count = 0;
+    for (EntityId index = 0; index < m_entities.size(); index++) {
+        if (entity_index(m_entities[index]) != k_reserved_entity_index) {
+            new_indices[index] = live_count++;
+        }
+    }
     for (auto &set : m_component_sets) {
-        if (set.contains(index)) {
-            set.remove(index);
+        if (set.initialised()) {
+            set.remap(new_indices.span());
+            set.shrink_to_fit();
+        }
+    }
+
+    Vector<EntityId, EntityId> entities;
+    entities.ensure_capacity(live_count);
+    for (EntityId index = 0; index < live_count; index++) {
+        entities.push(index);
+    }
+    m_entities = vull::move(entities);
+    m_free_indices = {};
+    return new_indices;
+}
+
+void EntityManager::create_group(Span<const size_t> component_ids) {
+    auto &group = *m_groups.emplace(vull::make_unique<ComponentGroup>());
+    for (const auto component_id : component_ids) {
+        VULL_ENSURE(m_component_sets[component_id].initialised(), "Grouped component not registered");
+        VULL_ENSURE(m_component_groups[component_id] == nullptr, "Component already owned by a group");
+        m_component_groups[component_id] = &group;
+        group.component_ids.push(component_id);
+    }
+    rebuild_groups();
+}
+
+void EntityManager::group_entity(ComponentGroup &group, EntityId index) {
+    for (const auto component_id : group.component_ids) {
+        if (!m_component_sets[component_id].contains(index)) {
+            return;
+        }
+    }
+    for (const auto component_id : group.component_ids) {
+        auto &set = m_component_sets[component_id];
+        set.swap_dense(set.index_of(index), group.size);
+    }
+    group.size++;
+}
+
+void EntityManager::ungroup_entity(ComponentGroup &group, EntityId index) {
+    auto &first_set = m_component_sets[group.component_ids.first()];
+    if (!first_set.contains(index) || first_set.index_of(index) >= group.size) {
+        return;
+    }
+    group.size--;
+    for (const auto component_id : group.component_ids) {
+        auto &set = m_component_sets[component_id];
+        set.swap_dense(set.index_of(index), group.size);
+    }
+}
+
+void EntityManager::rebuild_groups() {
+    for (auto &group : m_groups) {
+        group->size = 0;
+        // Entities before the current position have already been checked, so swapping them forward is fine.
+        auto &set = m_component_sets[group->component_ids.first()];
+        for (EntityId i = 0; i < set.size(); i++) {
+            group_entity(*group, set.dense_begin()[i]);
         }
     }
-    m_entities[index] = entity_id(m_free_head, entity_version(id) + 1);
-    m_free_head = index;
 }
 
 bool EntityManager::valid(EntityId id) const {
-    return id < m_entities.size() && m_entities[entity_index(id)] == id;
+    return entity_index(id) < m_entities.size() && m_entities[entity_index(id)] == id;
 }
 
 } // namespace vull
@@ -0,0 +1,343 @@
+#include <vull/ecs/snapshot.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/ecs/sparse_set.hh>
+#include <vull/maths/common.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/stream.hh>
+#include <vull/support/utility.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace vull {
+
+SnapshotChunk::SnapshotChunk(size_t size) : m_storage(new Storage) {
+    m_storage->bytes.ensure_size(size);
+}
+
+SnapshotChunk::~SnapshotChunk() {
+    if (m_storage != nullptr && m_storage->ref_count.fetch_sub(1, vull::memory_order_acq_rel) == 1) {
+        delete m_storage;
+    }
+}
+
+SnapshotChunk &SnapshotChunk::operator=(SnapshotChunk &&other) {
+    SnapshotChunk moved(vull::move(other));
+    vull::swap(m_storage, moved.m_storage);
+    return *this;
+}
+
+SnapshotChunk SnapshotChunk::share() const {
+    m_storage->ref_count.fetch_add(1, vull::memory_order_relaxed);
+    SnapshotChunk chunk;
+    chunk.m_storage = m_storage;
+    return chunk;
+}
+
+bool SnapshotChunk::equals(const void *data, size_t size) const {
+    return this->size() == size && memcmp(this->data(), data, size) == 0;
+}
+
+namespace {
+
+constexpr auto k_chunk_size = WorldSnapshot::k_chunk_size;
+
+EntityId chunk_count(EntityId size) {
+    return (size + k_chunk_size - 1) / k_chunk_size;
+}
+
+EntityId chunk_length(EntityId size, EntityId chunk_index) {
+    return vull::min(k_chunk_size, size - chunk_index * k_chunk_size);
+}
+
+// Returns whether the given chunk of the set holds the same entities in the same positions as the snapshot chunk, with
+// none of their components changed since the given tick.
+bool chunk_unchanged(const SparseSet<EntityId> &set, const SnapshotChunk &chunk, EntityId chunk_index, EntityId length,
+                     uint32_t tick) {
+    const auto begin = chunk_index * k_chunk_size;
+    if (begin + length > set.size()) {
+        return false;
+    }
+    if (memcmp(chunk.data(), set.dense_data() + begin, length * sizeof(EntityId)) != 0) {
+        return false;
+    }
+    const auto *ticks = set.change_ticks() + begin;
+    for (EntityId i = 0; i < length; i++) {
+        if (ticks[i] > tick) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Vector<EntityId> changed_chunks(const Vector<SnapshotChunk> &from, const Vector<SnapshotChunk> &to) {
+    Vector<EntityId> changed;
+    for (EntityId chunk_index = 0; chunk_index < to.size(); chunk_index++) {
+        const auto &chunk = to[chunk_index];
+        if (chunk_index >= from.size()) {
+            changed.push(chunk_index);
+            continue;
+        }
+        const auto &from_chunk = from[chunk_index];
+        if (!chunk.shares_with(from_chunk) && !from_chunk.equals(chunk.data(), chunk.size())) {
+            changed.push(chunk_index);
+        }
+    }
+    return changed;
+}
+
+Result<void, StreamError> write_chunks(const Vector<SnapshotChunk> &from, const Vector<SnapshotChunk> &to,
+                                       Stream &stream) {
+    const auto changed = changed_chunks(from, to);
+    VULL_TRY(stream.write_varint(changed.size()));
+    for (const auto chunk_index : changed) {
+        VULL_TRY(stream.write_varint(chunk_index));
+        VULL_TRY(stream.write({to[chunk_index].data(), to[chunk_index].size()}));
+    }
+    return {};
+}
+
+// Reads the chunks written by write_chunks, sharing any unwritten chunks from the from snapshot.
+Result<Vector<SnapshotChunk>, StreamError, SnapshotError>
+read_chunks(const Vector<SnapshotChunk> &from, EntityId size, size_t element_size, Stream &stream) {
+    Vector<SnapshotChunk> chunks;
+    chunks.ensure_capacity(chunk_count(size));
+    const auto changed_count = VULL_TRY(stream.read_varint<EntityId>());
+    for (EntityId i = 0; i < changed_count; i++) {
+        const auto chunk_index = VULL_TRY(stream.read_varint<EntityId>());
+        if (chunk_index < chunks.size() || chunk_index >= chunk_count(size)) {
+            return SnapshotError::Mismatched;
+        }
+        while (chunks.size() < chunk_index) {
+            const auto expected_size = chunk_length(size, chunks.size()) * element_size;
+            if (chunks.size() >= from.size() || from[chunks.size()].size() != expected_size) {
+                return SnapshotError::Mismatched;
+            }
+            chunks.push(from[chunks.size()].share());
+        }
+        SnapshotChunk chunk(chunk_length(size, chunk_index) * element_size);
+        if (VULL_TRY(stream.read({chunk.data(), chunk.size()})) != chunk.size()) {
+            return StreamError::Truncated;
+        }
+        chunks.push(vull::move(chunk));
+    }
+    while (chunks.size() < chunk_count(size)) {
+        const auto expected_size = chunk_length(size, chunks.size()) * element_size;
+        if (chunks.size() >= from.size() || from[chunks.size()].size() != expected_size) {
+            return SnapshotError::Mismatched;
+        }
+        chunks.push(from[chunks.size()].share());
+    }
+    return vull::move(chunks);
+}
+
+} // namespace
+
+size_t WorldSnapshot::unique_memory_usage(const WorldSnapshot *other) const {
+    const auto sum_chunks = [](const Vector<SnapshotChunk> &chunks, const Vector<SnapshotChunk> *other_chunks) {
+        size_t bytes = 0;
+        for (EntityId i = 0; i < chunks.size(); i++) {
+            if (other_chunks == nullptr || i >= other_chunks->size() || !chunks[i].shares_with((*other_chunks)[i])) {
+                bytes += chunks[i].size();
+            }
+        }
+        return bytes;
+    };
+    size_t bytes = sum_chunks(m_entity_chunks, other != nullptr ? &other->m_entity_chunks : nullptr);
+    for (size_t i = 0; i < m_sets.size(); i++) {
+        const bool has_other = other != nullptr && i < other->m_sets.size();
+        bytes += sum_chunks(m_sets[i].chunks, has_other ? &other->m_sets[i].chunks : nullptr);
+    }
+    return bytes;
+}
+
+WorldSnapshot EntityManager::snapshot(const WorldSnapshot *previous) {
+    WorldSnapshot snapshot;
+    snapshot.m_entity_count = m_entities.size();
+    for (EntityId chunk_index = 0; chunk_index < chunk_count(m_entities.size()); chunk_index++) {
+        const auto *ids = m_entities.data() + chunk_index * k_chunk_size;
+        const auto size = chunk_length(m_entities.size(), chunk_index) * sizeof(EntityId);
+        if (previous != nullptr && chunk_index < previous->m_entity_chunks.size() &&
+            previous->m_entity_chunks[chunk_index].equals(ids, size)) {
+            snapshot.m_entity_chunks.push(previous->m_entity_chunks[chunk_index].share());
+            continue;
+        }
+        auto &chunk = snapshot.m_entity_chunks.emplace(size);
+        memcpy(chunk.data(), ids, size);
+    }
+    snapshot.m_free_indices.extend(m_free_indices);
+    for (const auto &group : m_groups) {
+        snapshot.m_group_sizes.push(group->size);
+    }
+
+    for (size_t component_id = 0; component_id < m_component_sets.size(); component_id++) {
+        const auto &set = m_component_sets[component_id];
+        auto &snapshot_set = snapshot.m_sets.emplace();
+        if (!set.initialised() || !set.trivially_copyable()) {
+            continue;
+        }
+        snapshot_set.size = set.size();
+        snapshot_set.object_size = set.object_size();
+
+        const WorldSnapshot::Set *previous_set = nullptr;
+        if (previous != nullptr && component_id < previous->m_sets.size()) {
+            previous_set = &previous->m_sets[component_id];
+        }
+        for (EntityId chunk_index = 0; chunk_index < chunk_count(set.size()); chunk_index++) {
+            const auto begin = chunk_index * k_chunk_size;
+            const auto length = chunk_length(set.size(), chunk_index);
+            if (previous_set != nullptr && chunk_index < previous_set->chunks.size() &&
+                chunk_length(previous_set->size, chunk_index) == length &&
+                chunk_unchanged(set, previous_set->chunks[chunk_index], chunk_index, length, previous->m_tick)) {
+                snapshot_set.chunks.push(previous_set->chunks[chunk_index].share());
+                continue;
+            }
+            auto &chunk = snapshot_set.chunks.emplace(length * (sizeof(EntityId) + set.object_size()));
+            memcpy(chunk.data(), set.dense_data() + begin, length * sizeof(EntityId));
+            memcpy(chunk.data() + length * sizeof(EntityId), set.raw_data() + begin * set.object_size(),
+                   length * set.object_size());
+        }
+    }
+    snapshot.m_tick = advance_tick();
+    return snapshot;
+}
+
+void EntityManager::restore(const WorldSnapshot &snapshot) {
+    const auto current_entities = vull::move(m_entities);
+    m_entities.ensure_size(snapshot.m_entity_count);
+    for (EntityId chunk_index = 0; chunk_index < snapshot.m_entity_chunks.size(); chunk_index++) {
+        const auto &chunk = snapshot.m_entity_chunks[chunk_index];
+        memcpy(m_entities.data() + chunk_index * k_chunk_size, chunk.data(), chunk.size());
+    }
+    m_free_indices.clear();
+    m_free_indices.extend(snapshot.m_free_indices);
+
+    bool groups_valid = true;
+    for (size_t component_id = 0; component_id < m_component_sets.size(); component_id++) {
+        auto &set = m_component_sets[component_id];
+        if (!set.initialised()) {
+            continue;
+        }
+        if (!set.trivially_copyable()) {
+            // Not captured, but may have components of entities which don't exist in the snapshot, including ones which
+            // reuse the index of a destroyed entity that does.
+            for (EntityId i = set.size(); i > 0; i--) {
+                const auto index = set.dense_begin()[i - 1];
+                if (index >= m_entities.size() || entity_index(m_entities[index]) != index ||
+                    m_entities[index] != current_entities[index]) {
+                    set.remove(index);
+                }
+            }
+            groups_valid &= m_component_groups[component_id] == nullptr;
+            continue;
+        }
+
+        if (component_id >= snapshot.m_sets.size() || snapshot.m_sets[component_id].object_size == 0) {
+            // Registered after the snapshot was taken, so empty in it.
+            set.raw_clear_indices(0, set.size());
+            set.raw_resize(0);
+            groups_valid &= m_component_groups[component_id] == nullptr;
+            continue;
+        }
+
+        const auto &snapshot_set = snapshot.m_sets[component_id];
+        VULL_ENSURE(snapshot_set.object_size == set.object_size(), "Snapshot of a different world");
+        Vector<EntityId> changed;
+        for (EntityId chunk_index = 0; chunk_index < snapshot_set.chunks.size(); chunk_index++) {
+            const auto length = chunk_length(snapshot_set.size, chunk_index);
+            if (!chunk_unchanged(set, snapshot_set.chunks[chunk_index], chunk_index, length, snapshot.m_tick)) {
+                changed.push(chunk_index);
+            }
+        }
+        for (const auto chunk_index : changed) {
+            const auto begin = chunk_index * k_chunk_size;
+            set.raw_clear_indices(begin, begin + chunk_length(snapshot_set.size, chunk_index));
+        }
+        set.raw_clear_indices(snapshot_set.size, set.size());
+        set.raw_resize(snapshot_set.size);
+        for (const auto chunk_index : changed) {
+            const auto &chunk = snapshot_set.chunks[chunk_index];
+            const auto length = chunk_length(snapshot_set.size, chunk_index);
+            const auto *indices = reinterpret_cast<const EntityId *>(chunk.data());
+            set.raw_assign(chunk_index * k_chunk_size, length, indices, chunk.data() + length * sizeof(EntityId),
+                           m_tick);
+        }
+    }
+
+    // Groups registered after the snapshot was taken also need rebuilding.
+    if (!groups_valid || snapshot.m_group_sizes.size() != m_groups.size()) {
+        rebuild_groups();
+        return;
+    }
+    for (uint32_t i = 0; i < m_groups.size(); i++) {
+        m_groups[i]->size = snapshot.m_group_sizes[i];
+    }
+}
+
+Result<void, StreamError> write_snapshot_diff(const WorldSnapshot &from, const WorldSnapshot &to, Stream &stream) {
+    VULL_TRY(stream.write_varint(to.tick()));
+    VULL_TRY(stream.write_varint(to.m_entity_count));
+    VULL_TRY(write_chunks(from.m_entity_chunks, to.m_entity_chunks, stream));
+    VULL_TRY(stream.write_varint(to.m_free_indices.size()));
+    VULL_TRY(stream.write({to.m_free_indices.data(), to.m_free_indices.size_bytes()}));
+    VULL_TRY(stream.write_varint(to.m_group_sizes.size()));
+    for (const auto size : to.m_group_sizes) {
+        VULL_TRY(stream.write_varint(size));
+    }
+    VULL_TRY(stream.write_varint(to.m_sets.size()));
+    for (size_t i = 0; i < to.m_sets.size(); i++) {
+        const auto &set = to.m_sets[i];
+        VULL_TRY(stream.write_varint(set.object_size));
+        if (set.object_size == 0) {
+            continue;
+        }
+        VULL_TRY(stream.write_varint(set.size));
+        const Vector<SnapshotChunk> no_chunks;
+        VULL_TRY(write_chunks(i < from.m_sets.size() ? from.m_sets[i].chunks : no_chunks, set.chunks, stream));
+    }
+    return {};
+}
+
+Result<WorldSnapshot, StreamError, SnapshotError> read_snapshot_diff(const WorldSnapshot &from, Stream &stream) {
+    WorldSnapshot snapshot;
+    snapshot.m_tick = VULL_TRY(stream.read_varint<uint32_t>());
+    snapshot.m_entity_count = VULL_TRY(stream.read_varint<EntityId>());
+    snapshot.m_entity_chunks =
+        VULL_TRY(read_chunks(from.m_entity_chunks, snapshot.m_entity_count, sizeof(EntityId), stream));
+
+    const auto free_count = VULL_TRY(stream.read_varint<EntityId>());
+    snapshot.m_free_indices.ensure_size(free_count);
+    if (VULL_TRY(stream.read({snapshot.m_free_indices.data(), snapshot.m_free_indices.size_bytes()})) !=
+        snapshot.m_free_indices.size_bytes()) {
+        return StreamError::Truncated;
+    }
+    const auto group_count = VULL_TRY(stream.read_varint<uint32_t>());
+    for (uint32_t i = 0; i < group_count; i++) {
+        snapshot.m_group_sizes.push(VULL_TRY(stream.read_varint<EntityId>()));
+    }
+
+    const auto set_count = VULL_TRY(stream.read_varint<uint32_t>());
+    for (uint32_t i = 0; i < set_count; i++) {
+        auto &set = snapshot.m_sets.emplace();
+        set.object_size = VULL_TRY(stream.read_varint<uint32_t>());
+        if (set.object_size == 0) {
+            continue;
+        }
+        if (i >= from.m_sets.size() || from.m_sets[i].object_size != set.object_size) {
+            return SnapshotError::Mismatched;
+        }
+        set.size = VULL_TRY(stream.read_varint<EntityId>());
+        set.chunks =
+            VULL_TRY(read_chunks(from.m_sets[i].chunks, set.size, sizeof(EntityId) + set.object_size, stream));
+    }
+    return vull::move(snapshot);
+}
+
+} // namespace vull
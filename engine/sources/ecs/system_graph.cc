@@ -0,0 +1,123 @@
+#include <vull/ecs/system_graph.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/algorithm.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/function.hh>
+#include <vull/support/string.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/tasklet.hh>
+#include <vull/tasklet/tracing.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vull {
+
+static bool intersects(const Vector<size_t> &lhs, const Vector<size_t> &rhs) {
+    for (const auto lhs_id : lhs) {
+        for (const auto rhs_id : rhs) {
+            if (lhs_id == rhs_id) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+System::System(String &&name, Function<void()> &&fn)
+    : m_name(vull::move(name)), m_trace_label(tracing::intern(m_name)), m_fn(vull::move(fn)) {}
+
+bool System::conflicts_with(const System &other) const {
+    return intersects(m_writes, other.m_reads) || intersects(m_writes, other.m_writes) ||
+           intersects(m_reads, other.m_writes);
+}
+
+System &SystemGraph::add_system(String name, Function<void()> &&fn) {
+    m_built = false;
+    return *m_systems.emplace(vull::make_unique<System>(vull::move(name), vull::move(fn)));
+}
+
+void SystemGraph::build() {
+    for (auto &system : m_systems) {
+        system->m_dependents.clear();
+        system->m_dependency_count = 0;
+    }
+
+    // Conflicting systems run in the order they were added. Edges only go forward, so the graph can't have a cycle.
+    for (uint32_t i = 0; i < m_systems.size(); i++) {
+        auto &system = *m_systems[i];
+        uint32_t after_count = 0;
+        for (uint32_t j = 0; j < i; j++) {
+            auto &earlier = *m_systems[j];
+            const bool after = vull::contains(system.m_after, &earlier);
+            after_count += after ? 1 : 0;
+            if (after || system.conflicts_with(earlier)) {
+                earlier.m_dependents.push(&system);
+                system.m_dependency_count++;
+            }
+        }
+        VULL_ENSURE(after_count == system.m_after.size(), "System ordered after a later system");
+    }
+    m_built = true;
+}
+
+void SystemGraph::run_system(System *system, Latch &latch) {
+    const auto priority = Tasklet::current()->priority();
+    while (system != nullptr) {
+        {
+            tracing::Zone zone(system->m_trace_label);
+            Timer timer;
+            system->m_fn();
+            system->m_time = timer.elapsed();
+        }
+
+        // Any dependents which were only waiting on this system can now run. Keep one to run on this tasklet.
+        System *next = nullptr;
+        for (auto *dependent : system->m_dependents) {
+            if (dependent->m_pending_count.fetch_sub(1, vull::memory_order_acq_rel) != 1) {
+                continue;
+            }
+            if (next == nullptr) {
+                next = dependent;
+                continue;
+            }
+            vull::schedule(
+                [this, dependent, &latch] {
+                    run_system(dependent, latch);
+                },
+                priority);
+        }
+        latch.count_down();
+        system = next;
+    }
+}
+
+void SystemGraph::run() {
+    VULL_ASSERT(Tasklet::current() != nullptr);
+    if (!m_built) {
+        build();
+    }
+
+    Latch latch(m_systems.size());
+    for (auto &system : m_systems) {
+        system->m_pending_count.store(system->m_dependency_count);
+    }
+
+    const auto priority = Tasklet::current()->priority();
+    for (auto &system : m_systems) {
+        if (system->m_dependency_count == 0) {
+            vull::schedule(
+                [this, system = system.ptr(), &latch] {
+                    run_system(system, latch);
+                },
+                priority);
+        }
+    }
+    latch.wait();
+}
+
+} // namespace vull
@@ -16,12 +16,32 @@
 namespace vull {
 
 Result<void, StreamError, WorldError> World::deserialise(Stream &stream) {
-    const auto entity_count = VULL_TRY(stream.read_varint<EntityId>());
-    m_entities.ensure_capacity(entity_count);
-    for (EntityId i = 0; i < entity_count; i++) {
-        m_entities.push(i);
+    // Version 1 worlds start with the entity count, which can never be the version marker.
+    uint32_t version = 1;
+    auto entity_count = VULL_TRY(stream.read_varint<EntityId>());
+    if (entity_count == k_version_marker) {
+        version = VULL_TRY(stream.read_varint<uint32_t>());
+        if (version < 2 || version > k_version) {
+            vull::error("[vpak] Unsupported world version {}", version);
+            return WorldError::UnsupportedVersion;
+        }
+        entity_count = VULL_TRY(stream.read_varint<EntityId>());
     }
 
+    if (version >= 3) {
+        // Includes the versions of live entities and the free slots.
+        m_entities.ensure_size(entity_count);
+        if (VULL_TRY(stream.read({m_entities.data(), m_entities.size_bytes()})) != m_entities.size_bytes()) {
+            return StreamError::Truncated;
+        }
+    } else {
+        m_entities.ensure_capacity(entity_count);
+        for (EntityId i = 0; i < entity_count; i++) {
+            m_entities.push(i);
+        }
+    }
+    rebuild_free_indices();
+
     const auto set_count = VULL_TRY(stream.read_varint<uint32_t>());
     for (uint32_t i = 0; i < set_count; i++) {
         const auto set_entity_count = VULL_TRY(stream.read_varint<EntityId>());
@@ -33,28 +53,42 @@ Result<void, StreamError, WorldError> World::deserialise(Stream &stream) {
             return WorldError::InvalidComponent;
         }
         auto &set = m_component_sets[i];
-        set.deserialise(set_entity_count, stream);
-        for (EntityId j = 0; j < set_entity_count; j++) {
-            set.raw_ensure_index(VULL_TRY(stream.read_varint<EntityId>()));
+        VULL_TRY(set.deserialise(set_entity_count, stream));
+        if (version == 1) {
+            for (EntityId j = 0; j < set_entity_count; j++) {
+                set.raw_ensure_index(VULL_TRY(stream.read_varint<EntityId>()));
+            }
+        } else {
+            VULL_TRY(set.deserialise_indices(set_entity_count, stream));
+        }
+        for (EntityId index = 0; index < set_entity_count; index++) {
+            set.change_ticks()[index] = m_tick;
         }
     }
+    rebuild_groups();
     return {};
 }
 
-Result<float, StreamError> World::serialise(vpak::Writer &pack_writer, StringView name) {
-    auto entry = pack_writer.start_entry(name, vpak::EntryType::World);
-    VULL_TRY(entry.write_varint(m_entities.size()));
-    VULL_TRY(entry.write_varint(m_component_sets.size()));
+Result<void, StreamError> World::serialise(Stream &stream) {
+    VULL_TRY(stream.write_varint(k_version_marker));
+    VULL_TRY(stream.write_varint(k_version));
+    VULL_TRY(stream.write_varint(m_entities.size()));
+    VULL_TRY(stream.write({m_entities.data(), m_entities.size_bytes()}));
+    VULL_TRY(stream.write_varint(m_component_sets.size()));
     for (auto &set : m_component_sets) {
-        VULL_TRY(entry.write_varint(set.size()));
+        VULL_TRY(stream.write_varint(set.size()));
         if (!set.initialised()) {
             continue;
         }
-        set.serialise(entry);
-        for (EntityId id : vull::make_range(set.dense_begin(), set.dense_end())) {
-            VULL_TRY(entry.write_varint(id));
-        }
+        VULL_TRY(set.serialise(stream));
+        VULL_TRY(set.serialise_indices(stream));
     }
+    return {};
+}
+
+Result<float, StreamError> World::serialise(vpak::Writer &pack_writer, StringView name) {
+    auto entry = pack_writer.start_entry(name, vpak::EntryType::World);
+    VULL_TRY(serialise(entry));
     return entry.finish();
 }
 
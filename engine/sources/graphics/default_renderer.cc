@@ -51,6 +51,7 @@ namespace {
 
 // Minimum required maximum work group count * minimum cull work group size that would be used.
 constexpr uint32_t k_object_limit = 65535 * 32;
+constexpr uint32_t k_object_grain = 256;
 
 struct DepthReduceData {
     Vec2u mip_size;
@@ -257,7 +258,7 @@ void DefaultRenderer::load_scene(Scene &scene) {
     vkb::DeviceSize vertex_buffer_size = 0;
     vkb::DeviceSize index_buffer_size = 0;
     HashSet<String> seen_vertex_buffers;
-    for (auto [entity, mesh] : scene.world().view<Mesh>()) {
+    for (auto [entity, mesh] : scene.world().view<const Mesh>()) {
         if (seen_vertex_buffers.add(mesh.vertex_data_name())) {
             continue;
         }
@@ -282,7 +283,7 @@ void DefaultRenderer::load_scene(Scene &scene) {
     seen_vertex_buffers.clear();
     vkb::DeviceSize vertex_buffer_offset = 0;
     vkb::DeviceSize index_buffer_offset = 0;
-    for (auto [entity, mesh] : scene.world().view<Mesh>()) {
+    for (auto [entity, mesh] : scene.world().view<const Mesh>()) {
         if (seen_vertex_buffers.add(mesh.vertex_data_name())) {
             continue;
         }
@@ -358,32 +359,36 @@ void DefaultRenderer::record_draws(vk::CommandBuffer &cmd_buf, const vk::Buffer
 }
 
 vk::ResourceId DefaultRenderer::build_pass(vk::RenderGraph &graph, GBuffer &gbuffer) {
-    Vector<Object> objects;
-    for (auto [entity, mesh] : m_scene->world().view<Mesh>()) {
-        const auto mesh_info = m_mesh_infos.get(mesh.vertex_data_name());
-        if (!mesh_info) {
-            continue;
-        }
-
-        StringView albedo_name;
-        StringView normal_name;
-        if (auto material = entity.try_get<Material>()) {
-            albedo_name = material->albedo_name();
-            normal_name = material->normal_name();
-        }
-
-        auto bounding_sphere = entity.try_get<BoundingSphere>();
-        objects.push({
-            .transform = m_scene->get_transform_matrix(entity),
-            .center = bounding_sphere ? bounding_sphere->center() : Vec3f(0.0f),
-            .radius = bounding_sphere ? bounding_sphere->radius() : FLT_MAX,
-            .albedo_index = m_texture_streamer.ensure_texture(albedo_name, TextureKind::Albedo),
-            .normal_index = m_texture_streamer.ensure_texture(normal_name, TextureKind::Normal),
-            .index_count = mesh_info->index_count,
-            .first_index = mesh_info->index_offset,
-            .vertex_offset = static_cast<uint32_t>(mesh_info->vertex_offset),
+    auto objects = m_scene->world().view<const Mesh>().parallel_reduce<Vector<Object>>(
+        k_object_grain,
+        [this](Vector<Object> &objects, Entity entity, const Mesh &mesh) {
+            const auto mesh_info = m_mesh_infos.get(mesh.vertex_data_name());
+            if (!mesh_info) {
+                return;
+            }
+
+            StringView albedo_name;
+            StringView normal_name;
+            if (auto material = entity.try_get<Material>()) {
+                albedo_name = material->albedo_name();
+                normal_name = material->normal_name();
+            }
+
+            auto bounding_sphere = entity.try_get<BoundingSphere>();
+            objects.push({
+                .transform = m_scene->get_transform_matrix(entity),
+                .center = bounding_sphere ? bounding_sphere->center() : Vec3f(0.0f),
+                .radius = bounding_sphere ? bounding_sphere->radius() : FLT_MAX,
+                .albedo_index = m_texture_streamer.ensure_texture(albedo_name, TextureKind::Albedo),
+                .normal_index = m_texture_streamer.ensure_texture(normal_name, TextureKind::Normal),
+                .index_count = mesh_info->index_count,
+                .first_index = mesh_info->index_offset,
+                .vertex_offset = static_cast<uint32_t>(mesh_info->vertex_offset),
+            });
+        },
+        [](Vector<Object> &objects, Vector<Object> &&other) {
+            objects.extend(other);
         });
-    }
 
     // Cap object count just in case.
     m_object_count = vull::min(objects.size(), k_object_limit);
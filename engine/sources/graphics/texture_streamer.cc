@@ -18,6 +18,7 @@
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 #include <vull/tasklet/mutex.hh>
+#include <vull/tasklet/shared_mutex.hh>
 #include <vull/tasklet/tasklet.hh>
 #include <vull/vpak/file_system.hh>
 #include <vull/vpak/pack_file.hh>
@@ -228,6 +229,8 @@ Result<uint32_t, StreamError> TextureStreamer::load_texture(Stream &stream) {
     };
     auto image = m_context.create_image(image_ci, vk::MemoryUsage::DeviceOnly);
 
+    // Make way for any frame critical work before taking the transfer queue.
+    vull::preemption_point();
     auto queue = m_context.lock_queue(vk::QueueKind::Transfer);
     auto &cmd_buf = queue->request_cmd_buf();
 
@@ -326,15 +329,26 @@ void TextureStreamer::load_texture(String &&name, uint32_t fallback_index) {
 uint32_t TextureStreamer::ensure_texture(StringView name, TextureKind kind) {
     const uint32_t fallback_index = kind == TextureKind::Normal ? 1 : 0;
 
+    // Almost every call is for an already loaded texture, so look it up under a shared lock first.
+    {
+        SharedScopedLock lock(m_mutex);
+        if (auto index = m_texture_indices.get(name)) {
+            return *index != UINT32_MAX ? *index : fallback_index;
+        }
+    }
+
+    // Recheck as another tasklet may have scheduled a load in the meantime.
     ScopedLock lock(m_mutex);
     if (auto index = m_texture_indices.get(name)) {
         return *index != UINT32_MAX ? *index : fallback_index;
     }
 
-    bool scheduled = vull::try_schedule([this, name = String(name), fallback_index]() mutable {
-        load_texture(vull::move(name), fallback_index);
-        m_in_progress.fetch_sub(1);
-    });
+    bool scheduled = vull::try_schedule(
+        [this, name = String(name), fallback_index]() mutable {
+            load_texture(vull::move(name), fallback_index);
+            m_in_progress.fetch_sub(1);
+        },
+        TaskletPriority::Background);
     if (scheduled) {
         m_in_progress.fetch_add(1);
         m_texture_indices.set(name, UINT32_MAX);
@@ -17,10 +17,14 @@
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 
+#include <stdint.h>
+
 namespace vull {
 
 constexpr float k_fixed_timestep = 1.0f / 200.0f;
 constexpr unsigned k_max_substeps = 10;
+constexpr uint32_t k_integrate_grain = 256;
+constexpr uint32_t k_collision_grain = 4;
 
 Collider::Collider(UniquePtr<Shape> &&shape) : m_shape(vull::move(shape)) {}
 Collider::~Collider() = default;
@@ -28,44 +32,54 @@ Collider::~Collider() = default;
 // NOLINTNEXTLINE
 void PhysicsEngine::sub_step(World &world, float time_step) {
     // Integrate.
-    for (auto [entity, body, transform] : world.view<RigidBody, Transform>()) {
-        Vec3f acceleration = body.m_force * body.m_inv_mass;
-        body.m_linear_velocity += acceleration * time_step;
-        transform.set_position(transform.position() + body.m_linear_velocity * time_step);
-
-        if (body.m_ignore_rotation) {
-            continue;
-        }
+    world.view<RigidBody, Transform>().parallel_each(
+        k_integrate_grain, [&](Entity, RigidBody &body, Transform &transform) {
+            Vec3f acceleration = body.m_force * body.m_inv_mass;
+            body.m_linear_velocity += acceleration * time_step;
+            transform.set_position(transform.position() + body.m_linear_velocity * time_step);
+
+            if (body.m_ignore_rotation) {
+                return;
+            }
 
-        auto mat_rotation = vull::to_mat3(transform.rotation());
-        body.m_inertia_tensor_world = mat_rotation * body.m_inertia_tensor * vull::transpose(mat_rotation);
-        body.m_angular_velocity += body.m_inertia_tensor_world * body.m_torque * time_step;
+            auto mat_rotation = vull::to_mat3(transform.rotation());
+            body.m_inertia_tensor_world = mat_rotation * body.m_inertia_tensor * vull::transpose(mat_rotation);
+            body.m_angular_velocity += body.m_inertia_tensor_world * body.m_torque * time_step;
 
-        Quatf delta_rotation = Quatf(body.m_angular_velocity, 0.0f) * transform.rotation() * 0.5f * time_step;
-        transform.set_rotation(transform.rotation() + delta_rotation);
-    }
+            Quatf delta_rotation = Quatf(body.m_angular_velocity, 0.0f) * transform.rotation() * 0.5f * time_step;
+            transform.set_rotation(transform.rotation() + delta_rotation);
+        });
 
     struct ContactInfo {
         Contact contact;
-        Transform &t1;
-        Transform &t2;
-        RigidBody &b1;
-        Optional<RigidBody &> b2;
+        const Transform &t1;
+        const Transform &t2;
+        Entity e1;
+        Entity e2;
     };
 
-    Vector<ContactInfo> contacts;
-    for (auto [e1, b1, c1, t1] : world.view<RigidBody, Collider, Transform>()) {
-        for (auto [e2, c2, t2] : world.view<Collider, Transform>()) {
-            if (e1 == e2) {
-                continue;
-            }
-            if (auto contact = mpr_test(c1.shape(), t1, c2.shape(), t2)) {
-                contacts.push({*contact, t1, t2, b1, e2.try_get<RigidBody>()});
+    // Collision detection only reads the world, so it can be split up. Contacts are still resolved in a fixed order.
+    auto contacts = world.view<const RigidBody, const Collider, const Transform>().parallel_reduce<Vector<ContactInfo>>(
+        k_collision_grain,
+        [&](Vector<ContactInfo> &found, Entity e1, const RigidBody &, const Collider &c1, const Transform &t1) {
+            for (auto [e2, c2, t2] : world.view<const Collider, const Transform>()) {
+                if (e1 == e2) {
+                    continue;
+                }
+                if (auto contact = mpr_test(c1.shape(), t1, c2.shape(), t2)) {
+                    found.push({*contact, t1, t2, e1, e2});
+                }
             }
-        }
-    }
+        },
+        [](Vector<ContactInfo> &found, Vector<ContactInfo> &&other) {
+            found.extend(other);
+        });
+
+    for (auto [contact, t1, t2, e1, e2] : contacts) {
+        // Looked up here rather than in the parallel detection pass, which shouldn't be marking components as changed.
+        auto &b1 = e1.get_mut<RigidBody>();
+        auto b2 = e2.try_get_mut<RigidBody>();
 
-    for (auto [contact, t1, t2, b1, b2] : contacts) {
         // Get contact position in both bodies' local spacees.
         Vec3f r1 = contact.position - t1.position();
         Vec3f r2 = contact.position - t2.position();
@@ -2,6 +2,7 @@
 
 #include <vull/core/bounding_box.hh>
 #include <vull/core/bounding_sphere.hh>
+#include <vull/ecs/command_buffer.hh>
 #include <vull/ecs/entity_id.hh>
 #include <vull/ecs/world.hh>
 #include <vull/graphics/material.hh>
@@ -18,13 +19,7 @@
 namespace vull {
 
 Mat4f Scene::get_transform_matrix(EntityId entity) {
-    const auto &transform = m_world.get_component<Transform>(entity);
-    if (transform.parent() == ~vull::EntityId(0)) {
-        // Root node.
-        return transform.matrix();
-    }
-    const auto parent_matrix = get_transform_matrix(transform.parent());
-    return parent_matrix * transform.matrix();
+    return m_world.get_component<WorldTransform>(entity).matrix();
 }
 
 void Scene::load(StringView scene_name) {
@@ -34,9 +29,17 @@ void Scene::load(StringView scene_name) {
     m_world.register_component<Material>();
     m_world.register_component<BoundingBox>();
     m_world.register_component<BoundingSphere>();
+    m_world.register_component<WorldTransform>();
 
     // Load world.
     VULL_EXPECT(m_world.deserialise(*vpak::open(scene_name))); // TODO
+    EcsCommandBuffer commands;
+    update_transforms(commands);
+    commands.apply(m_world);
+}
+
+void Scene::update_transforms(EcsCommandBuffer &commands) {
+    m_transform_propagator.update(m_world, commands);
 }
 
 } // namespace vull
@@ -0,0 +1,141 @@
+#include <vull/scene/transform_propagator.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/command_buffer.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/mat.hh>
+#include <vull/scene/transform.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/utility.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+constexpr uint32_t k_no_slot = ~0u;
+constexpr uint32_t k_unknown_depth = ~0u;
+
+static bool has_parent(EntityManager &manager, EntityId parent) {
+    return parent != ~EntityId(0) && manager.valid(parent) && manager.has_component<Transform>(parent);
+}
+
+bool TransformPropagator::hierarchy_changed(EntityManager &manager, uint32_t since) {
+    if (manager.component_count<Transform>() != m_nodes.size()) {
+        return true;
+    }
+    // A changed transform may be a new one, one on a recycled entity index, or have had its parent changed.
+    for (auto [entity, transform] : manager.view<const Transform>().changed_since(since)) {
+        const EntityId index = entity_index(entity);
+        if (index >= m_slots.size() || m_slots[index] == k_no_slot) {
+            return true;
+        }
+        const auto &node = m_nodes[m_slots[index]];
+        if (node.entity != entity || node.parent != transform.parent()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransformPropagator::sort(EntityManager &manager) {
+    // Find the depth of every transform, walking up the hierarchy until either a root or a transform with an already
+    // known depth is reached. Each transform is only visited once.
+    Vector<EntityId> entities;
+    Vector<uint32_t, EntityId> depths;
+    Vector<EntityId> chain;
+    uint32_t max_depth = 0;
+    for (auto [entity, transform] : manager.view<const Transform>()) {
+        entities.push(entity);
+        EntityId index = entity_index(entity);
+        uint32_t depth = 0;
+        chain.clear();
+        while (true) {
+            depths.ensure_size(index + 1, k_unknown_depth);
+            if (depths[index] != k_unknown_depth) {
+                depth = depths[index] + 1;
+                break;
+            }
+            chain.push(index);
+            VULL_ENSURE(chain.size() <= manager.component_count<Transform>(), "Cycle in transform hierarchy");
+            const auto parent = manager.get_component<Transform>(index).parent();
+            if (!has_parent(manager, parent)) {
+                break;
+            }
+            index = entity_index(parent);
+        }
+        while (!chain.empty()) {
+            depths[chain.take_last()] = depth++;
+        }
+        max_depth = vull::max(max_depth, depth);
+    }
+
+    // Counting sort by depth so that parents come before their children.
+    Vector<uint32_t> offsets(max_depth + 1);
+    for (const auto entity : entities) {
+        offsets[depths[entity_index(entity)]]++;
+    }
+    for (uint32_t depth = 0, offset = 0; depth < offsets.size(); depth++) {
+        offset += vull::exchange(offsets[depth], offset);
+    }
+
+    m_nodes.clear();
+    m_nodes.ensure_size(entities.size());
+    for (auto &slot : m_slots) {
+        slot = k_no_slot;
+    }
+    for (const auto entity : entities) {
+        const EntityId index = entity_index(entity);
+        const auto slot = offsets[depths[index]]++;
+        m_nodes[slot] = {
+            .entity = entity,
+            .parent = manager.get_component<Transform>(entity).parent(),
+            .parent_slot = k_no_slot,
+        };
+        m_slots.ensure_size(index + 1, k_no_slot);
+        m_slots[index] = slot;
+    }
+    for (auto &node : m_nodes) {
+        if (has_parent(manager, node.parent)) {
+            node.parent_slot = m_slots[entity_index(node.parent)];
+        }
+    }
+}
+
+void TransformPropagator::update(EntityManager &manager, EcsCommandBuffer &commands) {
+    // Transforms may still be changed later in the current tick, after this update, so the next update looks at
+    // everything changed since the start of it. This means that changes made before this update get looked at twice.
+    const auto since = m_last_tick;
+    m_last_tick = manager.tick() - 1;
+
+    const bool resorted = hierarchy_changed(manager, since);
+    if (resorted) {
+        sort(manager);
+    }
+
+    // Parents always come first, so their world matrix and dirtiness is known by the time a child is reached.
+    m_world_matrices.ensure_size(m_nodes.size());
+    m_dirty.ensure_size(m_nodes.size());
+    for (uint32_t slot = 0; slot < m_nodes.size(); slot++) {
+        const auto &node = m_nodes[slot];
+        const bool has_parent = node.parent_slot != k_no_slot;
+        const bool dirty = resorted || (has_parent && m_dirty[node.parent_slot] != 0) ||
+                           manager.changed_since<Transform>(node.entity, since);
+        m_dirty[slot] = dirty ? 1 : 0;
+        if (!dirty) {
+            continue;
+        }
+
+        const auto local_matrix = manager.get_component<Transform>(node.entity).matrix();
+        auto &world_matrix = m_world_matrices[slot];
+        world_matrix = has_parent ? m_world_matrices[node.parent_slot] * local_matrix : local_matrix;
+        if (manager.has_component<WorldTransform>(node.entity)) {
+            manager.get_mut_component<WorldTransform>(node.entity).set_matrix(world_matrix);
+        } else {
+            commands.add_component<WorldTransform>(entity_index(node.entity), node.entity, world_matrix);
+        }
+    }
+}
+
+} // namespace vull
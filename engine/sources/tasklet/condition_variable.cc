@@ -0,0 +1,48 @@
+#include <vull/tasklet/condition_variable.hh>
+
+#include <vull/support/scoped_lock.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/mutex.hh>
+#include <vull/tasklet/tasklet.hh>
+#include <vull/tasklet/wait_queue.hh>
+
+namespace vull {
+
+void ConditionVariable::wait(Mutex &mutex) {
+    // Queue up before unlocking the mutex so that a notify in between isn't lost. A notifier which gets to us before we
+    // yield will wait for us to do so.
+    WaitQueue::Waiter waiter{
+        .tasklet = Tasklet::current(),
+    };
+    {
+        ScopedLock lock(m_lock);
+        m_queue.push(waiter);
+    }
+    mutex.unlock();
+    vull::yield();
+    mutex.lock();
+}
+
+void ConditionVariable::notify_one() {
+    WaitQueue::Waiter *waiter;
+    {
+        ScopedLock lock(m_lock);
+        waiter = m_queue.pop();
+    }
+    if (waiter != nullptr) {
+        WaitQueue::wake(*waiter);
+    }
+}
+
+void ConditionVariable::notify_all() {
+    WaitQueue to_wake;
+    {
+        ScopedLock lock(m_lock);
+        vull::swap(to_wake, m_queue);
+    }
+    while (auto *waiter = to_wake.pop()) {
+        WaitQueue::wake(*waiter);
+    }
+}
+
+} // namespace vull
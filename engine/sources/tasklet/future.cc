@@ -0,0 +1,44 @@
+#include <vull/tasklet/future.hh>
+
+#include <vull/support/assert.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/utility.hh>
+
+namespace vull::detail {
+namespace {
+
+// Placed in the waiter slot once a state has settled so that a late set_waiter knows to notify immediately.
+class SettledMarker final : public FutureWaiter {
+public:
+    void notify(FutureStateBase &) override { vull::unreachable(); }
+};
+
+VULL_GLOBAL(SettledMarker s_settled_marker);
+
+} // namespace
+
+void FutureStateBase::settle(bool fulfilled) {
+    VULL_ASSERT(!is_settled());
+    m_status.store(fulfilled ? Status::Fulfilled : Status::Abandoned, vull::memory_order_release);
+    m_latch.count_down();
+    if (auto *waiter = m_waiter.exchange(&s_settled_marker, vull::memory_order_acq_rel)) {
+        waiter->notify(*this);
+    }
+}
+
+void FutureStateBase::release() {
+    if (m_ref_count.fetch_sub(1, vull::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+void FutureStateBase::set_waiter(FutureWaiter *waiter) {
+    FutureWaiter *expected = nullptr;
+    if (!m_waiter.compare_exchange(expected, waiter, vull::memory_order_acq_rel, vull::memory_order_acquire)) {
+        // Already settled, notify straight away.
+        VULL_ASSERT(expected == &s_settled_marker, "Future already has a waiter");
+        waiter->notify(*this);
+    }
+}
+
+} // namespace vull::detail
@@ -2,33 +2,31 @@
 
 #include <vull/support/assert.hh>
 #include <vull/support/atomic.hh>
+#include <vull/support/utility.hh>
 #include <vull/tasklet/tasklet.hh>
 
 namespace vull {
 
 void Latch::count_down(uint32_t by) {
-    const auto value = m_value.fetch_sub(by);
+    const auto value = m_value.fetch_sub(by, vull::memory_order_acq_rel);
     if (value != by) {
         VULL_ASSERT(value > by);
         return;
     }
 
-    // Wake all waiters.
-    while (auto *to_wake = m_wait_list.load()) {
-        Tasklet *desired;
-        do {
-            desired = to_wake != nullptr ? to_wake->linked_tasklet() : nullptr;
-        } while (!m_wait_list.compare_exchange_weak(to_wake, desired));
-
+    // Wake all waiters. The whole list is taken at once since a woken waiter may destroy the latch before we're done.
+    auto *to_wake = m_wait_list.exchange(done_marker(), vull::memory_order_acq_rel);
+    while (to_wake != nullptr) {
+        auto *next = to_wake->linked_tasklet();
         while (to_wake->state() == TaskletState::Running) {
         }
         to_wake->set_linked_tasklet(nullptr);
-        vull::schedule(to_wake);
+        vull::schedule(vull::exchange(to_wake, next));
     }
 }
 
 bool Latch::try_wait() const {
-    return m_value.load() == 0;
+    return m_wait_list.load(vull::memory_order_acquire) == done_marker();
 }
 
 void Latch::wait() {
@@ -37,12 +35,17 @@ void Latch::wait() {
         return;
     }
 
-    // Otherwise add ourselves to the linked list of waiters.
+    // Otherwise add ourselves to the linked list of waiters, unless the count reached zero in the meantime.
     auto *current = Tasklet::current();
-    auto *waiter = m_wait_list.load();
+    auto *waiter = m_wait_list.load(vull::memory_order_acquire);
     do {
+        if (waiter == done_marker()) {
+            current->set_linked_tasklet(nullptr);
+            return;
+        }
         current->set_linked_tasklet(waiter);
-    } while (!m_wait_list.compare_exchange_weak(waiter, current));
+    } while (!m_wait_list.compare_exchange_weak(waiter, current, vull::memory_order_release,
+                                             vull::memory_order_acquire));
 
     // And yield to the scheduler.
     vull::yield();
@@ -1,53 +1,75 @@
 #include <vull/tasklet/mutex.hh>
 
 #include <vull/support/atomic.hh>
+#include <vull/support/scoped_lock.hh>
 #include <vull/tasklet/tasklet.hh>
+#include <vull/tasklet/wait_queue.hh>
+
+#include <stdint.h>
 
 namespace vull {
 
 void Mutex::lock() {
-    if (!m_locked.cmpxchg(false, true)) [[likely]] {
+    uint32_t state = 0;
+    if (m_state.compare_exchange(state, k_locked_bit, vull::memory_order_acquire)) [[likely]] {
         // Successfully locked without contention.
         return;
     }
+    lock_slow(state);
+}
 
-    do {
-        // Otherwies, increment the number of waiters.
-        m_wait_count.fetch_add(1);
+bool Mutex::try_lock() {
+    return m_state.cmpxchg(0, k_locked_bit, vull::memory_order_acquire) == 0;
+}
 
-        // Add ourselves to the linked list of waiters.
-        auto *current = Tasklet::current();
-        auto *waiter = m_wait_list.load();
-        do {
-            current->set_linked_tasklet(waiter);
-        } while (!m_wait_list.compare_exchange_weak(waiter, current));
+void Mutex::lock_slow(uint32_t state) {
+    WaitQueue::Waiter waiter{
+        .tasklet = Tasklet::current(),
+    };
+    {
+        ScopedLock lock(m_lock);
+        while (true) {
+            // The mutex may have been unlocked in the meantime, in which case we can take it directly. Checking this
+            // under the lock means an unlocker can't miss us once we've set the waiters bit.
+            if (state == 0) {
+                if (m_state.compare_exchange(state, k_locked_bit, vull::memory_order_acquire)) {
+                    return;
+                }
+                continue;
+            }
+            if (m_state.compare_exchange(state, state | k_waiters_bit, vull::memory_order_relaxed)) {
+                break;
+            }
+        }
+        m_queue.push(waiter);
+    }
 
-        // And yield to the scheduler.
-        vull::yield();
-    } while (m_locked.cmpxchg_weak(false, true));
+    // Ownership is handed over to us before we're woken.
+    vull::yield();
 }
 
 void Mutex::unlock() {
-    // Clear locked flag.
-    m_locked.store(false);
-
-    // Try to wake one waiter.
-    while (m_wait_count.load() != 0) {
-        Tasklet *to_wake = m_wait_list.load();
-        Tasklet *desired;
-        do {
-            desired = to_wake != nullptr ? to_wake->linked_tasklet() : nullptr;
-        } while (!m_wait_list.compare_exchange_weak(to_wake, desired));
-
-        if (to_wake != nullptr) {
-            m_wait_count.fetch_sub(1);
-            while (to_wake->state() == TaskletState::Running) {
-            }
-            to_wake->set_linked_tasklet(nullptr);
-            vull::schedule(to_wake);
-            break;
+    uint32_t state = k_locked_bit;
+    if (!m_state.compare_exchange(state, 0, vull::memory_order_release)) {
+        unlock_slow();
+    }
+}
+
+void Mutex::unlock_slow() {
+    // Hand the still locked mutex directly to the next waiter.
+    WaitQueue::Waiter *to_wake;
+    {
+        ScopedLock lock(m_lock);
+        to_wake = m_queue.pop();
+        if (to_wake == nullptr) {
+            m_state.store(0, vull::memory_order_release);
+        } else if (m_queue.empty()) {
+            m_state.store(k_locked_bit, vull::memory_order_release);
         }
     }
+    if (to_wake != nullptr) {
+        WaitQueue::wake(*to_wake);
+    }
 }
 
 } // namespace vull
@@ -1,43 +1,71 @@
 #include <vull/tasklet/scheduler.hh>
 
 #include <vull/container/array.hh>
+#include <vull/container/mpmc_queue.hh>
 #include <vull/container/vector.hh>
 #include <vull/container/work_stealing_queue.hh>
 #include <vull/core/log.hh>
 #include <vull/maths/common.hh>
+#include <vull/platform/timer.hh>
 #include <vull/support/assert.hh>
 #include <vull/support/atomic.hh>
+#include <vull/support/span.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 #include <vull/tasklet/tasklet.hh>
+#include <vull/tasklet/tracing.hh>
 
+#include <linux/futex.h>
 #include <pthread.h>
 #include <sched.h>
-#include <semaphore.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/random.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
-// TODO(tasklet-perf): Investigate different scheduling, e.g. steal many instead of just one when empty (could help with
-//                     gltf convert), or a global MPMC queue.
-
 namespace vull {
 
 extern "C" void vull_make_context(void *stack_top, void (*entry_point)(Tasklet *));
 extern "C" [[noreturn]] void vull_load_context(Tasklet *tasklet, Tasklet *to_free);
 extern "C" void vull_swap_context(Tasklet *from, Tasklet *to);
 
+class InjectionQueue : public MpmcQueue<Tasklet *> {};
 class TaskletQueue : public WorkStealingQueue<Tasklet *> {};
+
+// Upper bound on the number of tasklets taken in a single steal. Kept small since the steal buffer lives on the stack of
+// whichever tasklet is picking the next work.
+static constexpr uint32_t k_max_steal_batch = 32;
+
+// Local queue depth past which scheduling a new tasklet runs queued work before returning. This bounds the number of live
+// tasklets, and so the amount of stack memory touched, when one tasklet schedules a lot of work.
+static constexpr uint32_t k_backlog_limit = 256;
+
+// Minimum time between idle workers releasing excess stack memory, so that stacks aren't repeatedly released and
+// faulted back in under a steady load.
+static constexpr uint64_t k_trim_interval = 1000000000;
+
+// Number of times an idle worker looks for work before parking.
+static constexpr uint32_t k_spin_count = 32;
+
 VULL_GLOBAL(static thread_local Tasklet *s_current_tasklet = nullptr);
 VULL_GLOBAL(static thread_local Tasklet *s_scheduler_tasklet = nullptr);
 VULL_GLOBAL(static thread_local Tasklet *s_to_schedule = nullptr);
-VULL_GLOBAL(static thread_local TaskletQueue *s_queue = nullptr);
+VULL_GLOBAL(static thread_local bool s_requeue_current = false);
+VULL_GLOBAL(static thread_local Array<TaskletQueue *, k_tasklet_priority_count> s_queues{});
 VULL_GLOBAL(static thread_local Scheduler *s_scheduler = nullptr);
 VULL_GLOBAL(static thread_local uint32_t s_rng_state = 0);
+VULL_GLOBAL(static thread_local uint32_t s_worker_index = 0);
+VULL_GLOBAL(static thread_local SchedulerStats *s_stats = nullptr);
+#if VULL_TRACING
+VULL_GLOBAL(static thread_local uint64_t s_run_begin = 0);
+#endif
 VULL_GLOBAL(static Atomic<bool> s_running);
-VULL_GLOBAL(static sem_t s_work_available);
+
+static TaskletQueue &local_queue(TaskletPriority priority) {
+    return *s_queues[static_cast<uint32_t>(priority)];
+}
 
 Tasklet *Tasklet::current() {
     return s_current_tasklet;
@@ -47,21 +75,225 @@ Scheduler &Scheduler::current() {
     return *s_scheduler;
 }
 
-TaskletQueue &Scheduler::pick_victim(uint32_t &rng_state) {
+static void increment(uint64_t &counter, uint64_t amount = 1) {
+    vull::atomic_store(counter, counter + amount);
+}
+
+Tasklet *Scheduler::steal(uint32_t priority, TaskletQueue &own_queue, uint32_t &rng_state) {
     rng_state ^= rng_state << 13u;
     rng_state ^= rng_state >> 17u;
     rng_state ^= rng_state << 5u;
-    return *m_workers[rng_state % m_workers.size()]->queue;
+
+    // Try every other worker, starting from a random one. Half of the victim's queue is taken, with the first tasklet
+    // returned to run immediately and the rest moved to our own queue.
+    Array<Tasklet *, k_max_steal_batch> buffer;
+    const auto batch = Span<Tasklet *>(buffer.data(), m_steal_batch_limit);
+    const auto worker_count = m_workers.size();
+    for (uint32_t i = 0; i < worker_count; i++) {
+        auto &victim_queue = *m_workers[(rng_state + i) % worker_count]->queues[priority];
+        if (&victim_queue == &own_queue) {
+            continue;
+        }
+        const uint32_t count = victim_queue.steal_batch(batch);
+        for (uint32_t j = 1; j < count; j++) {
+            // Our queue must be empty if we are stealing, and the batch is much smaller than its capacity.
+            [[maybe_unused]] bool success = own_queue.enqueue(buffer[j]);
+            VULL_ASSERT(success);
+        }
+        if (count > 1) {
+            // More work is now available in our queue, so let another sleeping worker help out.
+            wake_one();
+        }
+        if (count != 0) {
+            increment(s_stats->steal_count, count);
+#if VULL_TRACING
+            const auto now = tracing::now();
+            tracing::record(tracing::EventKind::Steal, now, now, nullptr, count);
+#endif
+            return buffer[0];
+        }
+    }
+    if (worker_count > 1) {
+        increment(s_stats->failed_steal_count);
+    }
+    return nullptr;
 }
 
-Scheduler::Scheduler(uint32_t thread_count) {
+static void cpu_relax() {
+#if defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+Tasklet *Scheduler::find_work(Worker &worker) {
+    // Highest priority first. Within a priority, prefer local work, then work injected from outside of the workers, then
+    // finally steal from others.
+    for (uint32_t priority = 0; priority < k_tasklet_priority_count; priority++) {
+        if (auto *next = worker.queues[priority]->dequeue()) {
+            return next;
+        }
+        if (auto *next = m_injection_queues[priority]->dequeue()) {
+            return next;
+        }
+        if (auto *next = steal(priority, *worker.queues[priority], s_rng_state)) {
+            return next;
+        }
+    }
+    return nullptr;
+}
+
+Tasklet *Scheduler::park(Worker &worker) {
+    // Advertise that we're about to park, then look for work again. Paired with the fence in wake_one, either
+    // we see the newly scheduled work, or the scheduling thread sees us as parked and wakes us.
+    worker.park_state.store(ParkState::Parked);
+    m_parked_count.fetch_add(1, vull::memory_order_seq_cst);
+    vull::atomic_thread_fence(vull::memory_order_seq_cst);
+
+    Tasklet *next = nullptr;
+    auto state = ParkState::Parked;
+    if (s_running.load() && (next = find_work(worker)) == nullptr &&
+        worker.park_state.compare_exchange(state, ParkState::Sleeping, vull::memory_order_acquire)) {
+        maybe_trim();
+        const auto park_begin = tracing::now();
+        do {
+            syscall(SYS_futex, worker.park_state.raw_ptr(), FUTEX_WAIT_PRIVATE, ParkState::Sleeping, nullptr, nullptr,
+                    0);
+            increment(worker.stats.park_syscall_count);
+        } while (worker.park_state.load(vull::memory_order_acquire) == ParkState::Sleeping);
+        const auto park_end = tracing::now();
+        increment(worker.stats.parked_ns, park_end - park_begin);
+        tracing::record(tracing::EventKind::Park, park_begin, park_end);
+    }
+
+    // Either woken, found work, or the scheduler is stopping. If a wake raced with us finding work, it is consumed here,
+    // but that's fine since we're about to run and will look for more work afterwards.
+    worker.park_state.store(ParkState::Running);
+    m_parked_count.fetch_sub(1, vull::memory_order_release);
+    return next;
+}
+
+void Scheduler::maybe_trim() {
+    // Nothing to do, so a good time to release any excess stack memory.
+    const auto now = m_timer.elapsed_ns();
+    auto last = m_last_trim_time.load();
+    if (now - last >= k_trim_interval && m_last_trim_time.compare_exchange(last, now)) {
+        Tasklet::trim();
+    }
+}
+
+bool Scheduler::wake(Worker &worker) {
+    auto state = worker.park_state.load(vull::memory_order_acquire);
+    while (state == ParkState::Parked || state == ParkState::Sleeping) {
+        if (!worker.park_state.compare_exchange(state, ParkState::Notified, vull::memory_order_acq_rel,
+                                                vull::memory_order_acquire)) {
+            continue;
+        }
+
+        // Only a worker that has committed to sleeping needs a syscall to wake.
+        if (state == ParkState::Sleeping) {
+            syscall(SYS_futex, worker.park_state.raw_ptr(), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+            if (s_scheduler == this) {
+                increment(m_workers[s_worker_index]->stats.wake_syscall_count);
+            } else {
+                m_external_wake_count.fetch_add(1);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+Tasklet *Scheduler::wait_for_work() {
+    auto &worker = *m_workers[s_worker_index];
+    for (uint32_t i = 0; i < k_spin_count; i++) {
+        if (auto *next = find_work(worker)) {
+            return next;
+        }
+        cpu_relax();
+    }
+
+    // Give up our timeslice once before parking, which helps when the workers outnumber the available cores.
+    sched_yield();
+    increment(worker.stats.park_syscall_count);
+    if (auto *next = find_work(worker)) {
+        return next;
+    }
+#if VULL_TRACING
+    const auto now = tracing::now();
+    tracing::record(tracing::EventKind::StealFailed, now, now);
+#endif
+    return park(worker);
+}
+
+void Scheduler::wake_one() {
+    // Cheap check for the common case of all workers being busy. Paired with the fence in park.
+    vull::atomic_thread_fence(vull::memory_order_seq_cst);
+    if (m_parked_count.load() == 0) {
+        return;
+    }
+
+    // Wake at most one parked worker, starting from a random one to spread the wakes out.
+    const auto worker_count = m_workers.size();
+    for (uint32_t i = 0; i < worker_count; i++) {
+        if (wake(*m_workers[(s_rng_state + i) % worker_count])) {
+            return;
+        }
+    }
+}
+
+void Scheduler::notify_preempted() {
+    if (s_scheduler == this) {
+        increment(m_workers[s_worker_index]->stats.preemption_count);
+    }
+}
+
+bool Scheduler::should_preempt(TaskletPriority priority) const {
+    if (priority == TaskletPriority::Critical) {
+        return false;
+    }
+    if (priority == TaskletPriority::Normal) {
+        // Normal work only makes way once the frame is running late.
+        const auto deadline = m_frame_deadline.load();
+        if (deadline == 0 || m_timer.elapsed_ns() < deadline) {
+            return false;
+        }
+    }
+
+    // Only a snapshot, but preemption points are expected to be hit regularly.
+    constexpr auto critical = static_cast<uint32_t>(TaskletPriority::Critical);
+    if (!m_injection_queues[critical]->empty()) {
+        return true;
+    }
+    for (const auto &worker : m_workers) {
+        if (!worker->queues[critical]->empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::notify_scheduled() {
+    if (s_scheduler == this) {
+        increment(m_workers[s_worker_index]->stats.scheduled_count);
+    } else {
+        m_external_scheduled_count.fetch_add(1);
+    }
+    wake_one();
+}
+
+Scheduler::Scheduler(uint32_t thread_count)
+    : m_steal_batch_limit(k_max_steal_batch) {
     if (thread_count == 0) {
         thread_count = vull::max(static_cast<uint32_t>(sysconf(_SC_NPROCESSORS_ONLN)) / 2, 2);
     }
-    sem_init(&s_work_available, 0, 1);
     for (uint32_t i = 0; i < thread_count; i++) {
-        auto &worker = m_workers.emplace(new Worker{.scheduler = *this});
-        worker->queue = vull::make_unique<TaskletQueue>();
+        auto &worker = m_workers.emplace(new Worker{.scheduler = *this, .index = i});
+        for (auto &queue : worker->queues) {
+            queue = vull::make_unique<TaskletQueue>();
+        }
+    }
+    for (auto &queue : m_injection_queues) {
+        queue = vull::make_unique<InjectionQueue>();
     }
     vull::info("[tasklet] Created {} threads", thread_count);
 }
@@ -70,14 +302,13 @@ Scheduler::~Scheduler() {
     for (auto &worker : m_workers) {
         pthread_join(worker->thread, nullptr);
     }
-    sem_destroy(&s_work_available);
 }
 
 bool Scheduler::start(Tasklet *tasklet) {
     if (m_workers.empty()) {
         return false;
     }
-    if (!m_workers[0]->queue->enqueue(tasklet)) {
+    if (!inject(tasklet)) {
         return false;
     }
     s_running.store(true);
@@ -99,53 +330,115 @@ bool Scheduler::start(Tasklet *tasklet) {
     return true;
 }
 
+bool Scheduler::inject(Tasklet *tasklet) {
+    if (!m_injection_queues[static_cast<uint32_t>(tasklet->priority())]->enqueue(tasklet)) {
+        return false;
+    }
+    notify_scheduled();
+    return true;
+}
+
+void Scheduler::set_frame_deadline(float budget) {
+    m_frame_deadline.store(m_timer.elapsed_ns() + static_cast<uint64_t>(budget * 1000000000.0f));
+}
+
+void Scheduler::clear_frame_deadline() {
+    m_frame_deadline.store(0);
+}
+
+void Scheduler::set_steal_batch_limit(uint32_t limit) {
+    m_steal_batch_limit = vull::clamp(limit, 1u, k_max_steal_batch);
+}
+
+SchedulerStats Scheduler::stats() const {
+    SchedulerStats stats{
+        .scheduled_count = m_external_scheduled_count.load(),
+        .park_syscall_count = 0,
+        .wake_syscall_count = m_external_wake_count.load(),
+        .preemption_count = 0,
+        .steal_count = 0,
+        .failed_steal_count = 0,
+        .context_switch_count = 0,
+        .parked_ns = 0,
+        .pool_exhausted_count = Tasklet::exhausted_count(),
+    };
+    for (const auto &worker : m_workers) {
+        stats.scheduled_count += vull::atomic_load(worker->stats.scheduled_count);
+        stats.park_syscall_count += vull::atomic_load(worker->stats.park_syscall_count);
+        stats.wake_syscall_count += vull::atomic_load(worker->stats.wake_syscall_count);
+        stats.preemption_count += vull::atomic_load(worker->stats.preemption_count);
+        stats.steal_count += vull::atomic_load(worker->stats.steal_count);
+        stats.failed_steal_count += vull::atomic_load(worker->stats.failed_steal_count);
+        stats.context_switch_count += vull::atomic_load(worker->stats.context_switch_count);
+        stats.parked_ns += vull::atomic_load(worker->stats.parked_ns);
+    }
+    return stats;
+}
+
 void Scheduler::stop() {
-    if (!s_running.exchange(false)) {
+    if (!s_running.exchange(false, vull::memory_order_seq_cst)) {
         return;
     }
-    for (uint32_t i = 0; i < m_workers.size(); i++) {
-        sem_post(&s_work_available);
+    vull::atomic_thread_fence(vull::memory_order_seq_cst);
+    for (auto &worker : m_workers) {
+        wake(*worker);
     }
 }
 
 [[noreturn]] static void invoke_trampoline(Tasklet *);
 
-static Tasklet *pick_next() {
-    auto *next = vull::exchange(s_to_schedule, nullptr);
-    while (next == nullptr) {
-        sem_wait(&s_work_available);
-        if (!s_running.load() && s_queue->empty()) {
-            pthread_exit(nullptr);
-        }
+[[noreturn]] static void exit_fn(Tasklet *) {
+    pthread_exit(nullptr);
+}
 
-        next = s_queue->dequeue();
-        if (next == nullptr) {
-            auto &victim_queue = s_scheduler->pick_victim(s_rng_state);
-            if (&victim_queue != s_queue) {
-                next = victim_queue.steal();
-            }
+static bool local_queues_empty() {
+    for (const auto *queue : s_queues) {
+        if (!queue->empty()) {
+            return false;
         }
-        if (next == nullptr) {
-            sem_post(&s_work_available);
-        } else {
-            VULL_ASSERT(next->state() != TaskletState::Running);
+    }
+    return true;
+}
+
+static Tasklet *pick_next(Tasklet *to_free = nullptr) {
+    auto *next = vull::exchange(s_to_schedule, nullptr);
+    while (next == nullptr) {
+        if (!s_running.load() && local_queues_empty()) {
+            // Exit from the thread's own stack so that a just finished tasklet can still be freed.
+            vull_make_context(s_scheduler_tasklet->stack_top(), exit_fn);
+            vull_load_context(s_scheduler_tasklet, to_free);
         }
+        next = s_scheduler->wait_for_work();
     }
+    VULL_ASSERT(next->state() != TaskletState::Running);
 
     VULL_ASSERT(next->state() != TaskletState::Done);
     if (next->state() == TaskletState::Uninitialised) {
         vull_make_context(next->stack_top(), invoke_trampoline);
     }
     next->set_state(TaskletState::Running);
+    increment(s_stats->context_switch_count);
+#if VULL_TRACING
+    s_run_begin = tracing::now();
+#endif
     return next;
 }
 
+#if VULL_TRACING
+static void record_run(Tasklet *tasklet, const char *end_reason) {
+    tracing::record(tracing::EventKind::TaskletRun, s_run_begin, tracing::now(), end_reason,
+                    reinterpret_cast<uintptr_t>(tasklet));
+}
+#endif
+
 [[noreturn]] static void invoke_trampoline(Tasklet *tasklet) {
-    // TODO: Destruct lambda captures.
     tasklet->invoke();
+#if VULL_TRACING
+    record_run(tasklet, "done");
+#endif
     tasklet->set_state(TaskletState::Done);
 
-    auto *next = pick_next();
+    auto *next = pick_next(tasklet);
     vull_load_context(s_current_tasklet = next, tasklet);
 }
 
@@ -154,27 +447,48 @@ static Tasklet *pick_next() {
     // schedule.
     VULL_ASSERT(s_current_tasklet != s_scheduler_tasklet);
     VULL_ASSERT(s_current_tasklet->state() != TaskletState::Done);
+#if VULL_TRACING
+    record_run(s_current_tasklet, s_requeue_current ? "requeue" : "yield");
+#endif
     s_current_tasklet->set_state(TaskletState::Waiting);
 
+    // Only requeue now that the context has been saved, otherwise another worker could steal and resume the tasklet
+    // whilst it's still running on this thread.
+    if (vull::exchange(s_requeue_current, false)) {
+        // The queue for the tasklet's priority may be full if it wasn't the one just pumped from.
+        auto *tasklet = s_current_tasklet;
+        while (!local_queue(tasklet->priority()).enqueue(tasklet) && !s_scheduler->inject(tasklet)) {
+            cpu_relax();
+        }
+    }
+
     auto *next = pick_next();
     vull_load_context(s_current_tasklet = next, nullptr);
 }
 
-[[noreturn]] static void segfault_handler(int, siginfo_t *info, void *) {
+static void segfault_handler(int, siginfo_t *info, void *) {
     const auto address = reinterpret_cast<uintptr_t>(info->si_addr);
-    const auto *tasklet = static_cast<void *>(Tasklet::current());
-    if (Tasklet::current()->is_guard_page(address)) {
-        fprintf(stderr, "Stack overflow in tasklet %p\n", tasklet);
+    auto *tasklet = Tasklet::current();
+    if (tasklet != nullptr && tasklet->grow_stack(address)) {
+        // Return to retry the faulting access.
+        return;
+    }
+    if (tasklet != nullptr && tasklet->is_guard_page(address)) {
+        fprintf(stderr, "Stack overflow in tasklet %p\n", static_cast<void *>(tasklet));
     } else {
-        fprintf(stderr, "Segfault at address 0x%lx in tasklet %p\n", address, tasklet);
+        fprintf(stderr, "Segfault at address 0x%lx in tasklet %p\n", address, static_cast<void *>(tasklet));
     }
     abort();
 }
 
 void *Scheduler::worker_entry(void *worker_ptr) {
-    auto &[scheduler, queue, _] = *static_cast<Worker *>(worker_ptr);
-    s_queue = queue.ptr();
-    s_scheduler = &scheduler;
+    auto &worker = *static_cast<Worker *>(worker_ptr);
+    for (uint32_t i = 0; i < k_tasklet_priority_count; i++) {
+        s_queues[i] = worker.queues[i].ptr();
+    }
+    s_scheduler = &worker.scheduler;
+    s_worker_index = worker.index;
+    s_stats = &worker.stats;
 
     sigset_t sig_set;
     sigfillset(&sig_set);
@@ -183,8 +497,24 @@ void *Scheduler::worker_entry(void *worker_ptr) {
         vull::error("[tasklet] Failed to mask signals");
     }
 
+    // The segfault handler needs to run on its own stack since the faulting tasklet's stack is either full or needs
+    // growing. Sanitizers may have already set one up for the thread.
+    Array<uint8_t, 65536> signal_stack;
+    stack_t signal_stack_info{};
+    sigaltstack(nullptr, &signal_stack_info);
+    if ((signal_stack_info.ss_flags & SS_DISABLE) != 0) {
+        signal_stack_info = {
+            .ss_sp = signal_stack.data(),
+            .ss_flags = 0,
+            .ss_size = signal_stack.size(),
+        };
+        if (sigaltstack(&signal_stack_info, nullptr) != 0) {
+            vull::error("[tasklet] Failed to set signal stack");
+        }
+    }
+
     struct sigaction sa{
-        .sa_flags = SA_SIGINFO,
+        .sa_flags = SA_SIGINFO | SA_ONSTACK,
     };
     sigemptyset(&sa.sa_mask);
     sa.sa_sigaction = &segfault_handler;
@@ -196,7 +526,7 @@ void *Scheduler::worker_entry(void *worker_ptr) {
 
     // Use thread stack for scheduler tasklet.
     Array<uint8_t, 131072> tasklet_data{};
-    s_scheduler_tasklet = new (tasklet_data.data()) Tasklet(tasklet_data.size(), nullptr);
+    s_scheduler_tasklet = new (tasklet_data.data()) Tasklet(tasklet_data.size(), tasklet_data.size());
     vull_make_context(s_scheduler_tasklet->stack_top(), scheduler_fn);
 
     auto *next = pick_next();
@@ -204,30 +534,73 @@ void *Scheduler::worker_entry(void *worker_ptr) {
 }
 
 void pump_work() {
-    auto *dequeued = s_queue->dequeue();
+    Tasklet *dequeued = nullptr;
+    for (auto *queue : s_queues) {
+        if ((dequeued = queue->dequeue()) != nullptr) {
+            break;
+        }
+    }
     if (dequeued == nullptr) {
         return;
     }
-    [[maybe_unused]] bool success = s_queue->enqueue(s_current_tasklet);
-    VULL_ASSERT(success);
 
+    // Swap to the dequeued tasklet, with the current one being requeued.
     VULL_ASSERT(s_to_schedule == nullptr);
     s_to_schedule = dequeued;
+    s_requeue_current = true;
+    yield();
+}
+
+void pump_if_backlogged(TaskletPriority priority) {
+    if (local_queue(priority).size() > k_backlog_limit) {
+        pump_work();
+    }
+}
+
+bool local_queue_empty(TaskletPriority priority) {
+    return local_queue(priority).empty();
+}
+
+uint32_t worker_index() {
+    VULL_ASSERT(s_scheduler != nullptr);
+    return s_worker_index;
+}
+
+void preemption_point() {
+    if (s_scheduler == nullptr || !s_scheduler->should_preempt(s_current_tasklet->priority())) {
+        return;
+    }
+
+    // Requeue ourselves behind the critical work, which this worker will now pick up first.
+    s_scheduler->notify_preempted();
+    s_requeue_current = true;
     yield();
 }
 
 bool try_schedule(Tasklet *tasklet) {
-    VULL_ASSERT_PEDANTIC(s_queue != nullptr);
-    sem_post(&s_work_available);
-    return s_queue->enqueue(tasklet);
+    VULL_ASSERT_PEDANTIC(s_scheduler != nullptr);
+    if (!local_queue(tasklet->priority()).enqueue(tasklet)) {
+        return false;
+    }
+    s_scheduler->notify_scheduled();
+    return true;
 }
 
 void schedule(Tasklet *tasklet) {
-    VULL_ASSERT_PEDANTIC(s_queue != nullptr);
-    sem_post(&s_work_available);
-    while (!s_queue->enqueue(tasklet)) {
+    VULL_ASSERT_PEDANTIC(s_scheduler != nullptr);
+    if (local_queue(tasklet->priority()).enqueue(tasklet)) {
+        s_scheduler->notify_scheduled();
+        return;
+    }
+
+    // Local queue is full, overflow into the injection queue where any worker can pick it up.
+    if (s_scheduler->inject(tasklet)) {
+        return;
+    }
+    while (!local_queue(tasklet->priority()).enqueue(tasklet)) {
         pump_work();
     }
+    s_scheduler->notify_scheduled();
 }
 
 void yield() {
@@ -0,0 +1,68 @@
+#include <vull/tasklet/semaphore.hh>
+
+#include <vull/support/atomic.hh>
+#include <vull/support/scoped_lock.hh>
+#include <vull/tasklet/tasklet.hh>
+#include <vull/tasklet/wait_queue.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+bool Semaphore::try_acquire() {
+    auto count = m_count.load(vull::memory_order_relaxed);
+    while (count != 0) {
+        if (m_count.compare_exchange_weak(count, count - 1, vull::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Semaphore::acquire() {
+    if (try_acquire()) {
+        return;
+    }
+
+    WaitQueue::Waiter waiter{
+        .tasklet = Tasklet::current(),
+    };
+    {
+        ScopedLock lock(m_lock);
+
+        // Advertise that we're waiting before checking the count again. Paired with the fence in release, either we see
+        // the released count, or the releaser sees us waiting.
+        m_waiter_count.fetch_add(1);
+        vull::atomic_thread_fence(vull::memory_order_seq_cst);
+        if (try_acquire()) {
+            m_waiter_count.fetch_sub(1);
+            return;
+        }
+        m_queue.push(waiter);
+    }
+
+    // The count is taken on our behalf before we're woken.
+    vull::yield();
+}
+
+void Semaphore::release(uint32_t count) {
+    m_count.fetch_add(count, vull::memory_order_release);
+    vull::atomic_thread_fence(vull::memory_order_seq_cst);
+    if (m_waiter_count.load() == 0) {
+        return;
+    }
+
+    WaitQueue to_wake;
+    {
+        ScopedLock lock(m_lock);
+        while (!m_queue.empty() && try_acquire()) {
+            to_wake.push(*m_queue.pop());
+            m_waiter_count.fetch_sub(1);
+        }
+    }
+    while (auto *waiter = to_wake.pop()) {
+        WaitQueue::wake(*waiter);
+    }
+}
+
+} // namespace vull
@@ -0,0 +1,127 @@
+#include <vull/tasklet/shared_mutex.hh>
+
+#include <vull/support/atomic.hh>
+#include <vull/support/scoped_lock.hh>
+#include <vull/tasklet/tasklet.hh>
+#include <vull/tasklet/wait_queue.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+void SharedMutex::wait(uint32_t state, bool exclusive) {
+    WaitQueue::Waiter waiter{
+        .tasklet = Tasklet::current(),
+        .data = exclusive ? 1u : 0u,
+    };
+    {
+        ScopedLock lock(m_lock);
+        while (true) {
+            // The lock may have been released before we got here. Only barge in if nobody else is queued.
+            const bool available = exclusive ? state == 0 : (state & (k_writer_bit | k_waiters_bit)) == 0;
+            if (available) {
+                const auto desired = exclusive ? k_writer_bit : state + 1;
+                if (m_state.compare_exchange(state, desired, vull::memory_order_acquire)) {
+                    return;
+                }
+                continue;
+            }
+            if (m_state.compare_exchange(state, state | k_waiters_bit, vull::memory_order_relaxed)) {
+                break;
+            }
+        }
+        m_queue.push(waiter);
+    }
+
+    // The lock is handed over to us before we're woken.
+    vull::yield();
+}
+
+void SharedMutex::grant(WaitQueue &to_wake) {
+    // Hand the lock to as many waiters at the front of the queue as possible, which is either a single writer or a run
+    // of readers. Readers may be concurrently releasing, so CAS everything.
+    auto state = m_state.load(vull::memory_order_relaxed);
+    while (auto *waiter = m_queue.peek()) {
+        const bool exclusive = waiter->data != 0;
+        if ((state & k_writer_bit) != 0 || (exclusive && (state & k_reader_mask) != 0)) {
+            break;
+        }
+        const auto desired = exclusive ? state | k_writer_bit : state + 1;
+        if (!m_state.compare_exchange(state, desired, vull::memory_order_acquire)) {
+            continue;
+        }
+        state = desired;
+        to_wake.push(*m_queue.pop());
+        if (exclusive) {
+            break;
+        }
+    }
+
+    if (m_queue.empty()) {
+        while (!m_state.compare_exchange(state, state & ~k_waiters_bit, vull::memory_order_relaxed)) {
+        }
+    }
+}
+
+void SharedMutex::release_slow(uint32_t clear) {
+    WaitQueue to_wake;
+    {
+        ScopedLock lock(m_lock);
+        auto state = m_state.load(vull::memory_order_relaxed);
+        while (clear != 0 && !m_state.compare_exchange(state, state & ~clear, vull::memory_order_release)) {
+        }
+        grant(to_wake);
+    }
+    while (auto *waiter = to_wake.pop()) {
+        WaitQueue::wake(*waiter);
+    }
+}
+
+void SharedMutex::lock() {
+    uint32_t state = 0;
+    if (!m_state.compare_exchange(state, k_writer_bit, vull::memory_order_acquire)) {
+        wait(state, true);
+    }
+}
+
+bool SharedMutex::try_lock() {
+    return m_state.cmpxchg(0, k_writer_bit, vull::memory_order_acquire) == 0;
+}
+
+void SharedMutex::unlock() {
+    uint32_t state = k_writer_bit;
+    if (!m_state.compare_exchange(state, 0, vull::memory_order_release)) {
+        // There are waiters to hand over to.
+        release_slow(k_writer_bit);
+    }
+}
+
+void SharedMutex::lock_shared() {
+    auto state = m_state.load(vull::memory_order_relaxed);
+    while ((state & (k_writer_bit | k_waiters_bit)) == 0) {
+        if (m_state.compare_exchange_weak(state, state + 1, vull::memory_order_acquire)) {
+            return;
+        }
+    }
+    wait(state, false);
+}
+
+bool SharedMutex::try_lock_shared() {
+    auto state = m_state.load(vull::memory_order_relaxed);
+    while ((state & (k_writer_bit | k_waiters_bit)) == 0) {
+        if (m_state.compare_exchange_weak(state, state + 1, vull::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SharedMutex::unlock_shared() {
+    const auto state = m_state.fetch_sub(1, vull::memory_order_release);
+    if ((state & k_reader_mask) == 1 && (state & k_waiters_bit) != 0) {
+        // Last reader out with a writer waiting.
+        release_slow(0);
+    }
+}
+
+} // namespace vull
@@ -1,101 +1,246 @@
 #include <vull/tasklet/tasklet.hh>
 
+#include <vull/container/array.hh>
 #include <vull/maths/common.hh>
+#include <vull/platform/system_mutex.hh>
 #include <vull/support/assert.hh>
 #include <vull/support/atomic.hh>
+#include <vull/support/scoped_lock.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/tracing.hh>
 
-#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
-// TODO(tasklet-perf): Benchmark per-thread memory pools vs a global pool (old global pool in git history).
-// TODO: Stack guard pages wasting a lot of memory currently. Tasklet object (~40 bytes) rounded up to 4 KiB, then
-//       another 4 KiB used for the guard page. Maybe tasklet object could go after the stack?
-// TODO: Investigate on-demand growable stacks? (with MAP_GROWSDOWN | MAP_STACK)
+// TODO: Tasklet object (~40 bytes) is rounded up to a whole page. Maybe tasklet object could go after the stack?
 
 namespace vull {
 namespace {
 
-class PoolBase {
-protected:
-    const size_t m_stack_size{0};
-    uint8_t *m_base{nullptr};
-    size_t m_head{0};
-    Atomic<void *> m_next_free{nullptr};
+// Number of free stacks held by a magazine, which is also the number of stacks mapped at once.
+constexpr uint32_t k_magazine_size = 16;
 
-    explicit PoolBase(size_t stack_size) : m_stack_size(stack_size) {}
+// Amount of each stack which is accessible up front. Anything deeper is made accessible on demand by the segfault handler
+// and given back when the tasklet finishes, so that the occasional deep tasklet doesn't leave a large stack resident.
+constexpr size_t k_committed_stack_size = 65536;
+
+struct Magazine {
+    Array<void *, k_magazine_size> stacks;
+    uint32_t count{0};
+    Magazine *next{nullptr};
+
+    bool empty() const { return count == 0; }
+    bool full() const { return count == k_magazine_size; }
+    void push(void *stack) { stacks[count++] = stack; }
+    void *pop() { return stacks[--count]; }
+};
+
+// Global pool of stack magazines. Threads only go to the depot when both of their cached magazines are empty (or
+// full, when freeing), so contention on the lock is low.
+class Depot {
+    SystemMutex m_mutex;
+    Magazine *m_resident_list{nullptr};
+    Magazine *m_cold_list{nullptr};
+    Magazine *m_empty_list{nullptr};
+    uint32_t m_resident_stack_count{0};
+    uint32_t m_slab_count{0};
+    size_t m_stack_size;
+    size_t m_committed_size;
+    uint32_t m_resident_limit;
+
+    Magazine *allocate_slab();
 
 public:
-    void free(Tasklet *tasklet);
-    bool is_guard_page(uintptr_t page) const;
+    Depot(size_t stack_size, uint32_t resident_limit)
+        : m_stack_size(stack_size), m_committed_size(k_committed_stack_size), m_resident_limit(resident_limit) {}
+
+    void configure(size_t stack_size, uint32_t resident_limit);
+    Magazine *take_full();
+    Magazine *take_empty();
+    void put_full(Magazine *magazine);
+    void put_empty(Magazine *magazine);
+    void trim();
+
+    size_t stack_size() const { return m_stack_size; }
+    size_t committed_size() const { return m_committed_size; }
 };
 
-template <unsigned TaskletCount, size_t StackSize>
-class Pool : public PoolBase {
+// Per-thread cache of two magazines, which allows a thread to alternate between allocating and freeing without going
+// to the depot each time.
+class MagazineCache {
+    Depot &m_depot;
+    Magazine *m_loaded{nullptr};
+    Magazine *m_previous{nullptr};
+
 public:
-    Pool();
+    explicit MagazineCache(Depot &depot) : m_depot(depot) {}
+    MagazineCache(const MagazineCache &) = delete;
+    MagazineCache(MagazineCache &&) = delete;
+    ~MagazineCache();
 
-    Tasklet *allocate();
+    MagazineCache &operator=(const MagazineCache &) = delete;
+    MagazineCache &operator=(MagazineCache &&) = delete;
+
+    void *allocate();
+    void free(void *stack);
 };
 
-template <unsigned TaskletCount, size_t StackSize>
-Pool<TaskletCount, StackSize>::Pool() : PoolBase(StackSize) {
+void Depot::configure(size_t stack_size, uint32_t resident_limit) {
+    const auto page_size = static_cast<size_t>(getpagesize());
+    VULL_ENSURE(stack_size % page_size == 0 && stack_size >= page_size * 4);
+
+    ScopedLock lock(m_mutex);
+    VULL_ENSURE(m_slab_count == 0, "Tasklet stack size changed after first use");
+    m_stack_size = stack_size;
+    m_committed_size = vull::min(k_committed_stack_size, stack_size - page_size * 2);
+    m_resident_limit = resident_limit;
+}
+
+Magazine *Depot::allocate_slab() {
+    // Stacks are lazily committed by the kernel as they're touched.
     constexpr auto mmap_prot = PROT_READ | PROT_WRITE;
-    constexpr auto mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE;
-    const size_t total_size = StackSize * TaskletCount;
-    void *mmap_result = mmap(nullptr, total_size, mmap_prot, mmap_flags, -1, 0);
-    VULL_ENSURE(mmap_result != MAP_FAILED);
-    m_base = static_cast<uint8_t *>(mmap_result);
+    constexpr auto mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    void *mmap_result = mmap(nullptr, m_stack_size * k_magazine_size, mmap_prot, mmap_flags, -1, 0);
+    if (mmap_result == MAP_FAILED) {
+        return nullptr;
+    }
 
-    // Mark guard pages.
+    // Everything between the tasklet header page and the committed part of the stack is inaccessible. The first page
+    // is always kept as a guard page, the rest is grown into on demand.
+    auto *magazine = take_empty();
     const auto page_size = static_cast<size_t>(getpagesize());
-    for (uint8_t *page = m_base; page < m_base + total_size; page += StackSize) {
-        mprotect(page + page_size, page_size, PROT_NONE);
+    for (uint32_t i = 0; i < k_magazine_size; i++) {
+        auto *stack = static_cast<uint8_t *>(mmap_result) + m_stack_size * i;
+        mprotect(stack + page_size, m_stack_size - page_size - m_committed_size, PROT_NONE);
+        magazine->push(stack);
     }
+
+    ScopedLock lock(m_mutex);
+    m_slab_count++;
+    return magazine;
 }
 
-template <unsigned TaskletCount, size_t StackSize>
-Tasklet *Pool<TaskletCount, StackSize>::allocate() {
-    auto *next_free = m_next_free.load();
-    if (next_free != nullptr) {
-        // Since we are the only thread allocating, m_next_free can never become null after this check.
-        void *desired;
-        do {
-            memcpy(&desired, next_free, sizeof(void *));
-        } while (!m_next_free.compare_exchange_weak(next_free, desired));
-        return new (next_free) Tasklet(StackSize, this);
+Magazine *Depot::take_full() {
+    {
+        ScopedLock lock(m_mutex);
+        if (auto *magazine = m_resident_list) {
+            m_resident_list = magazine->next;
+            m_resident_stack_count -= magazine->count;
+            return magazine;
+        }
+        if (auto *magazine = m_cold_list) {
+            m_cold_list = magazine->next;
+            return magazine;
+        }
     }
+    return allocate_slab();
+}
 
-    if (m_head >= StackSize * TaskletCount) {
-        // Pool full.
-        return nullptr;
+Magazine *Depot::take_empty() {
+    {
+        ScopedLock lock(m_mutex);
+        if (auto *magazine = m_empty_list) {
+            m_empty_list = magazine->next;
+            return magazine;
+        }
     }
+    return new Magazine;
+}
 
-    // TODO: Remove this and just use next_free.
-    size_t head = vull::exchange(m_head, m_head + StackSize);
-    return new (m_base + head) Tasklet(StackSize, this);
+void Depot::put_full(Magazine *magazine) {
+    ScopedLock lock(m_mutex);
+    magazine->next = vull::exchange(m_resident_list, magazine);
+    m_resident_stack_count += magazine->count;
 }
 
-void PoolBase::free(Tasklet *tasklet) {
-    void *next_free = m_next_free.load();
-    do {
-        memcpy(tasklet, &next_free, sizeof(void *));
-    } while (!m_next_free.compare_exchange_weak(next_free, tasklet));
+void Depot::put_empty(Magazine *magazine) {
+    ScopedLock lock(m_mutex);
+    magazine->next = vull::exchange(m_empty_list, magazine);
 }
 
-bool PoolBase::is_guard_page(uintptr_t page) const {
-    const auto page_size = static_cast<uintptr_t>(getpagesize());
-    page = vull::align_down(page, page_size);
-    const auto base = reinterpret_cast<uintptr_t>(m_base);
-    if (page < base + page_size) {
-        return false;
+void Depot::trim() {
+    Magazine *to_trim = nullptr;
+    {
+        ScopedLock lock(m_mutex);
+        while (m_resident_list != nullptr && m_resident_stack_count > m_resident_limit) {
+            auto *magazine = vull::exchange(m_resident_list, m_resident_list->next);
+            m_resident_stack_count -= magazine->count;
+            magazine->next = vull::exchange(to_trim, magazine);
+        }
+    }
+
+    // Give the memory back to the kernel outside of the lock. The mapping is kept so that the stacks can be reused later
+    // without any syscalls other than the page faults.
+    while (to_trim != nullptr) {
+        auto *magazine = vull::exchange(to_trim, to_trim->next);
+        for (uint32_t i = 0; i < magazine->count; i++) {
+            madvise(magazine->stacks[i], m_stack_size, MADV_DONTNEED);
+        }
+        ScopedLock lock(m_mutex);
+        magazine->next = vull::exchange(m_cold_list, magazine);
+    }
+}
+
+MagazineCache::~MagazineCache() {
+    // Return everything to the depot so that stacks freed on this thread can be reused by others.
+    for (auto *magazine : Array{m_loaded, m_previous}) {
+        if (magazine == nullptr) {
+            continue;
+        }
+        if (magazine->empty()) {
+            m_depot.put_empty(magazine);
+        } else {
+            m_depot.put_full(magazine);
+        }
+    }
+    m_depot.trim();
+}
+
+void *MagazineCache::allocate() {
+    if (m_loaded != nullptr && !m_loaded->empty()) {
+        return m_loaded->pop();
+    }
+    if (m_previous != nullptr && !m_previous->empty()) {
+        vull::swap(m_loaded, m_previous);
+        return m_loaded->pop();
     }
-    return (page - base - page_size) % m_stack_size == 0;
+
+    // Both magazines are empty, swap one for a full one from the depot.
+    auto *magazine = m_depot.take_full();
+    if (magazine == nullptr) {
+        return nullptr;
+    }
+    if (m_previous != nullptr) {
+        m_depot.put_empty(m_previous);
+    }
+    m_previous = vull::exchange(m_loaded, magazine);
+    return m_loaded->pop();
 }
 
-VULL_GLOBAL(thread_local Pool<64, 65536> s_normal_pool);
-VULL_GLOBAL(thread_local Pool<4, 262144> s_large_pool);
+void MagazineCache::free(void *stack) {
+    if (m_loaded != nullptr && !m_loaded->full()) {
+        m_loaded->push(stack);
+        return;
+    }
+    if (m_previous != nullptr && !m_previous->full()) {
+        vull::swap(m_loaded, m_previous);
+        m_loaded->push(stack);
+        return;
+    }
+
+    // Both magazines are full, give one back to the depot.
+    if (m_previous != nullptr) {
+        m_depot.put_full(m_previous);
+    }
+    m_previous = vull::exchange(m_loaded, m_depot.take_empty());
+    m_loaded->push(stack);
+}
+
+VULL_GLOBAL(Depot s_depot(1048576, 128));
+VULL_GLOBAL(Atomic<uint64_t> s_exhausted_count);
+VULL_GLOBAL(thread_local MagazineCache s_cache(s_depot));
 
 } // namespace
 
@@ -104,20 +249,67 @@ extern "C" void vull_free_tasklet(Tasklet *tasklet) {
     if (tasklet != nullptr) {
         VULL_ASSERT(tasklet->state() == TaskletState::Done);
         VULL_ASSERT(tasklet->linked_tasklet() == nullptr);
-        static_cast<PoolBase *>(tasklet->pool())->free(tasklet);
+        tasklet->shrink_stack(s_depot.committed_size());
+        s_cache.free(tasklet);
     }
 }
 
-Tasklet *Tasklet::create() {
-    return s_normal_pool.allocate();
+void Tasklet::configure(size_t stack_size, uint32_t resident_limit) {
+    s_depot.configure(stack_size, resident_limit);
+}
+
+void Tasklet::trim() {
+    s_depot.trim();
+}
+
+uint64_t Tasklet::exhausted_count() {
+    return s_exhausted_count.load();
 }
 
-Tasklet *Tasklet::create_large() {
-    return s_large_pool.allocate();
+Tasklet *Tasklet::create() {
+    void *stack = s_cache.allocate();
+    if (stack == nullptr) {
+        s_exhausted_count.fetch_add(1);
+        const auto now = tracing::now();
+        tracing::record(tracing::EventKind::PoolExhausted, now, now);
+        return nullptr;
+    }
+    return new (stack) Tasklet(s_depot.stack_size(), s_depot.committed_size());
 }
 
 bool Tasklet::is_guard_page(uintptr_t page) const {
-    return static_cast<PoolBase *>(m_pool)->is_guard_page(page);
+    const auto page_size = static_cast<uintptr_t>(getpagesize());
+    return vull::align_down(page, page_size) == reinterpret_cast<uintptr_t>(this) + page_size;
+}
+
+bool Tasklet::grow_stack(uintptr_t address) {
+    const auto page_size = static_cast<uintptr_t>(getpagesize());
+    const auto limit = reinterpret_cast<uintptr_t>(this) + page_size * 2;
+    const auto page = vull::align_down(address, page_size);
+    if (page < limit || page >= m_committed_bottom) {
+        return false;
+    }
+
+    // At least double the committed size to keep the number of faults down for deep stacks.
+    const auto committed_size = reinterpret_cast<uintptr_t>(m_stack_top) - m_committed_bottom;
+    auto bottom = m_committed_bottom - limit > committed_size ? m_committed_bottom - committed_size : limit;
+    bottom = vull::min(bottom, page);
+    if (mprotect(reinterpret_cast<void *>(bottom), m_committed_bottom - bottom, PROT_READ | PROT_WRITE) != 0) {
+        return false;
+    }
+    m_committed_bottom = bottom;
+    return true;
+}
+
+void Tasklet::shrink_stack(size_t committed_size) {
+    const auto bottom = reinterpret_cast<uintptr_t>(m_stack_top) - committed_size;
+    if (m_committed_bottom >= bottom) {
+        return;
+    }
+    auto *grown = reinterpret_cast<void *>(m_committed_bottom);
+    madvise(grown, bottom - m_committed_bottom, MADV_DONTNEED);
+    mprotect(grown, bottom - m_committed_bottom, PROT_NONE);
+    m_committed_bottom = bottom;
 }
 
 } // namespace vull
@@ -0,0 +1,244 @@
+#include <vull/tasklet/tracing.hh>
+
+#include <vull/platform/timer.hh>
+#include <vull/support/result.hh>
+#include <vull/support/stream.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/utility.hh>
+
+#if VULL_TRACING
+#include <vull/container/array.hh>
+#include <vull/container/hash_set.hh>
+#include <vull/container/vector.hh>
+#include <vull/maths/common.hh>
+#include <vull/platform/system_mutex.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/scoped_lock.hh>
+#endif
+
+#include <stdint.h>
+#include <unistd.h>
+
+namespace vull::tracing {
+namespace {
+
+VULL_GLOBAL(Timer s_timer);
+
+#if VULL_TRACING
+// Number of events kept per thread, after which the oldest are overwritten.
+constexpr uint64_t k_ring_capacity = 1u << 15;
+
+struct Event {
+    uint64_t begin;
+    uint64_t end;
+    const char *label;
+    uint64_t arg;
+    uint32_t thread_id;
+    EventKind kind;
+};
+
+// Single producer ring of events. Rings are never freed so that events can still be exported after the recording thread
+// has exited, instead being handed to the next new thread once their thread exits.
+struct Ring {
+    Array<Event, k_ring_capacity> events;
+    Atomic<uint64_t> head{0};
+    Ring *next{nullptr};
+    Ring *next_free{nullptr};
+};
+
+VULL_GLOBAL(SystemMutex s_label_mutex);
+VULL_GLOBAL(HashSet<String> s_labels);
+
+VULL_GLOBAL(SystemMutex s_ring_mutex);
+VULL_GLOBAL(Ring *s_ring_list = nullptr);
+VULL_GLOBAL(Ring *s_free_ring_list = nullptr);
+
+class RingHandle {
+    Ring *m_ring{nullptr};
+    uint32_t m_thread_id{0};
+
+    void acquire();
+
+public:
+    RingHandle() = default;
+    RingHandle(const RingHandle &) = delete;
+    RingHandle(RingHandle &&) = delete;
+    ~RingHandle();
+
+    RingHandle &operator=(const RingHandle &) = delete;
+    RingHandle &operator=(RingHandle &&) = delete;
+
+    void push(Event event);
+};
+
+VULL_GLOBAL(thread_local RingHandle s_ring_handle);
+
+void RingHandle::acquire() {
+    m_thread_id = static_cast<uint32_t>(gettid());
+    ScopedLock lock(s_ring_mutex);
+    if (s_free_ring_list != nullptr) {
+        m_ring = vull::exchange(s_free_ring_list, s_free_ring_list->next_free);
+        return;
+    }
+    m_ring = new Ring;
+    m_ring->next = vull::exchange(s_ring_list, m_ring);
+}
+
+RingHandle::~RingHandle() {
+    if (m_ring != nullptr) {
+        ScopedLock lock(s_ring_mutex);
+        m_ring->next_free = vull::exchange(s_free_ring_list, m_ring);
+    }
+}
+
+void RingHandle::push(Event event) {
+    if (m_ring == nullptr) {
+        acquire();
+    }
+    event.thread_id = m_thread_id;
+    const auto head = m_ring->head.load();
+    m_ring->events[head % k_ring_capacity] = event;
+    m_ring->head.store(head + 1, vull::memory_order_release);
+}
+
+Vector<Event> collect_events() {
+    Vector<Event> events;
+    ScopedLock lock(s_ring_mutex);
+    for (auto *ring = s_ring_list; ring != nullptr; ring = ring->next) {
+        // Copy everything that might still be valid, then drop anything the owning thread overwrote whilst we were
+        // copying.
+        const auto end = ring->head.load(vull::memory_order_acquire);
+        const auto begin = end > k_ring_capacity ? end - k_ring_capacity : 0;
+        Vector<Event> copied;
+        copied.ensure_capacity(static_cast<uint32_t>(end - begin));
+        for (auto index = begin; index < end; index++) {
+            copied.push(ring->events[index % k_ring_capacity]);
+        }
+        vull::atomic_thread_fence(vull::memory_order_acquire);
+        const auto new_head = ring->head.load();
+        const auto overwritten = new_head > k_ring_capacity ? new_head - k_ring_capacity : 0;
+        for (auto index = vull::max(begin, overwritten); index < end; index++) {
+            events.push(copied[static_cast<uint32_t>(index - begin)]);
+        }
+    }
+    return events;
+}
+
+StringView event_name(const Event &event) {
+    switch (event.kind) {
+    case EventKind::TaskletRun:
+        return "tasklet";
+    case EventKind::Park:
+        return "park";
+    case EventKind::Steal:
+        return "steal";
+    case EventKind::StealFailed:
+        return "steal failed";
+    case EventKind::PoolExhausted:
+        return "pool exhausted";
+    case EventKind::Zone:
+        return event.label;
+    }
+    return "unknown";
+}
+
+void append_escaped(StringBuilder &sb, StringView string) {
+    for (char ch : string) {
+        if (ch == '"' || ch == '\\') {
+            sb.append('\\');
+        }
+        sb.append(ch);
+    }
+}
+
+void append_microseconds(StringBuilder &sb, uint64_t ns) {
+    sb.append("{}.{d3}", ns / 1000, ns % 1000);
+}
+
+// Note that StringBuilder::append has no brace escaping, so literal braces go through extend.
+void append_event(StringBuilder &sb, const Event &event) {
+    const bool instant = event.begin == event.end && event.kind != EventKind::Zone;
+    sb.extend(StringView("{\"name\":\""));
+    append_escaped(sb, event_name(event));
+    sb.append("\",\"cat\":\"{}\",\"ph\":\"{}\",\"pid\":1,\"tid\":{},\"ts\":",
+              event.kind == EventKind::Zone ? "zone" : "scheduler", instant ? "i" : "X", event.thread_id);
+    append_microseconds(sb, event.begin);
+    if (instant) {
+        sb.extend(StringView(",\"s\":\"t\""));
+    } else {
+        sb.extend(StringView(",\"dur\":"));
+        append_microseconds(sb, event.end - event.begin);
+    }
+
+    switch (event.kind) {
+    case EventKind::TaskletRun:
+        sb.extend(StringView(",\"args\":{\"tasklet\":\""));
+        sb.append("{h}\",\"end\":\"", event.arg);
+        append_escaped(sb, event.label);
+        sb.extend(StringView("\"}"));
+        break;
+    case EventKind::Steal:
+        sb.extend(StringView(",\"args\":{\"count\":"));
+        sb.append("{}}", event.arg);
+        break;
+    default:
+        break;
+    }
+    sb.append('}');
+}
+#endif
+
+} // namespace
+
+uint64_t now() {
+    return s_timer.elapsed_ns();
+}
+
+#if VULL_TRACING
+void record(EventKind kind, uint64_t begin, uint64_t end, const char *label, uint64_t arg) {
+    s_ring_handle.push({
+        .begin = begin,
+        .end = end,
+        .label = label != nullptr ? label : "",
+        .arg = arg,
+        .thread_id = 0,
+        .kind = kind,
+    });
+}
+
+const char *intern(StringView string) {
+    if (string.empty()) {
+        return "";
+    }
+    String copy(string);
+    const char *label = copy.data();
+    ScopedLock lock(s_label_mutex);
+    if (auto existing = s_labels.add(vull::move(copy))) {
+        return existing->data();
+    }
+    // Moving the string into the set keeps its heap allocation.
+    return label;
+}
+#endif
+
+Result<void, StreamError> write_chrome_json(Stream &stream) {
+    StringBuilder sb;
+    sb.extend(StringView("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+#if VULL_TRACING
+    bool first = true;
+    for (const auto &event : collect_events()) {
+        if (!vull::exchange(first, false)) {
+            sb.append(',');
+        }
+        sb.append('\n');
+        append_event(sb, event);
+    }
+#endif
+    sb.extend(StringView("\n]}\n"));
+    const auto string = sb.build();
+    return stream.write(string.view());
+}
+
+} // namespace vull::tracing
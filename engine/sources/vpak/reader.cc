@@ -14,6 +14,7 @@
 #include <vull/support/string_view.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/parallel.hh>
 #include <vull/vpak/pack_file.hh>
 
 #include <string.h>
@@ -49,64 +50,170 @@ struct Context {
 };
 VULL_GLOBAL(thread_local Vector<Context> s_contexts);
 
-} // namespace
-
-ReadStream::ReadStream(Span<uint8_t> data, size_t first_block) : m_data(data), m_block_start(first_block) {
+Context acquire_context() {
     if (s_contexts.empty()) {
-        s_contexts.emplace();
+        return {};
     }
+    auto context = vull::move(s_contexts.last());
+    s_contexts.pop();
+    return context;
+}
+
+uint64_t load_be64(Span<uint8_t> data, size_t offset) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        value = (value << 8u) | data[offset + i];
+    }
+    return value;
+}
 
-    auto &context = s_contexts.last();
+// Decompresses a frame of a seekable entry into buffer, which must be ZSTD_DStreamOutSize bytes.
+size_t decompress_frame(Span<uint8_t> data, uint64_t block_index, size_t frame_index, ZSTD_DCtx *dctx,
+                        uint8_t *buffer) {
+    const auto frame_offset = load_be64(data, block_index + frame_index * sizeof(uint64_t));
+    const auto *frame = data.byte_offset(frame_offset);
+    const auto compressed_size = ZSTD_findFrameCompressedSize(frame, data.size() - frame_offset);
+    VULL_ENSURE(ZSTD_isError(compressed_size) == 0);
+    const auto size = ZSTD_decompressDCtx(dctx, buffer, ZSTD_DStreamOutSize(), frame, compressed_size);
+    VULL_ENSURE(ZSTD_isError(size) == 0);
+    return size;
+}
+
+} // namespace
+
+ReadStream::ReadStream(Span<uint8_t> data, const Entry &entry)
+    : m_data(data), m_first_block(entry.first_block), m_block_index(entry.block_index), m_size(entry.size),
+      m_frame_size(entry.frame_size) {
+    auto context = acquire_context();
     m_dctx = vull::exchange(context.dctx, nullptr);
     m_buffer = vull::exchange(context.buffer, nullptr);
-    s_contexts.pop();
-
-    ZSTD_DCtx_reset(m_dctx, ZSTD_reset_session_only);
-    m_compressed_size = ZSTD_findFrameCompressedSize(m_data.byte_offset(m_block_start), m_data.size() - m_block_start);
+    restart();
 }
 
 ReadStream::~ReadStream() {
     s_contexts.emplace(m_dctx, m_buffer);
 }
 
-Result<size_t, StreamError> ReadStream::read(Span<void> data) {
-    // TODO: Is this loop needed?
-    for (uint32_t bytes_read = 0; bytes_read < data.size();) {
+void ReadStream::restart() {
+    m_buffer_position = 0;
+    m_buffer_head = 0;
+    m_buffer_size = 0;
+    if (m_block_index != 0) {
+        return;
+    }
+    ZSTD_DCtx_reset(m_dctx, ZSTD_reset_session_only);
+    m_block_start = m_first_block;
+    m_offset = 0;
+    m_compressed_size = ZSTD_findFrameCompressedSize(m_data.byte_offset(m_block_start), m_data.size() - m_block_start);
+    m_finished = false;
+}
+
+void ReadStream::fill_buffer() {
+    m_buffer_position += m_buffer_size;
+    m_buffer_head = 0;
+    m_buffer_size = 0;
+    if (m_block_index != 0) {
+        // Each frame is decompressed whole, so the window always starts on a frame boundary.
+        if (m_buffer_position >= m_size) {
+            return;
+        }
+        m_buffer_size = decompress_frame(m_data, m_block_index, m_buffer_position / m_frame_size, m_dctx, m_buffer);
+        return;
+    }
+
+    // Use a temporary buffer to avoid reading back from uncached vulkan memory.
+    ZSTD_outBuffer output{
+        .dst = m_buffer,
+        .size = ZSTD_DStreamOutSize(),
+    };
+    while (output.pos < output.size && !m_finished) {
         ZSTD_inBuffer input{
             .src = m_data.byte_offset(m_block_start + m_offset),
             .size = vull::min(m_compressed_size, ZSTD_CStreamOutSize() - m_offset),
         };
         VULL_ENSURE(input.size > 0);
-
-        // Use a temporary buffer to avoid reading back from uncached vulkan memory.
-        ZSTD_outBuffer output{
-            .dst = m_buffer,
-            // TODO: Always read ZSTD_DStreamOutSize and cache data for next call to read().
-            .size = vull::min(data.size() - bytes_read, ZSTD_DStreamOutSize()),
-        };
         size_t rc = ZSTD_decompressStream(m_dctx, &output, &input);
         VULL_ENSURE(ZSTD_isError(rc) == 0);
-        memcpy(data.byte_offset(bytes_read), m_buffer, output.pos);
-        bytes_read += output.pos;
+        m_finished = rc == 0;
 
         m_compressed_size -= input.pos;
         m_offset += input.pos;
-        if (m_offset >= ZSTD_CStreamOutSize()) {
-            size_t next_offset = m_block_start + ZSTD_CStreamOutSize();
-            m_block_start = (static_cast<uint64_t>(m_data[next_offset]) << 56u) |
-                            (static_cast<uint64_t>(m_data[next_offset + 1]) << 48u) |
-                            (static_cast<uint64_t>(m_data[next_offset + 2]) << 40u) |
-                            (static_cast<uint64_t>(m_data[next_offset + 3]) << 32u) |
-                            (static_cast<uint64_t>(m_data[next_offset + 4]) << 24u) |
-                            (static_cast<uint64_t>(m_data[next_offset + 5]) << 16u) |
-                            (static_cast<uint64_t>(m_data[next_offset + 6]) << 8u) |
-                            (static_cast<uint64_t>(m_data[next_offset + 7]) << 0u);
+        if (m_offset >= ZSTD_CStreamOutSize() && !m_finished) {
+            m_block_start = load_be64(m_data, m_block_start + ZSTD_CStreamOutSize());
             m_compressed_size =
                 ZSTD_findFrameCompressedSize(m_data.byte_offset(m_block_start), m_data.size() - m_block_start);
             m_offset = 0;
         }
     }
-    return static_cast<size_t>(data.size());
+    m_buffer_size = output.pos;
+}
+
+Result<size_t, StreamError> ReadStream::seek(StreamOffset offset, SeekMode mode) {
+    auto position = static_cast<ssize_t>(m_buffer_position + m_buffer_head);
+    switch (mode) {
+    case SeekMode::Set:
+        position = offset;
+        break;
+    case SeekMode::Add:
+        position += offset;
+        break;
+    case SeekMode::End:
+        position = static_cast<ssize_t>(m_size) + offset;
+        break;
+    }
+    if (position < 0 || static_cast<size_t>(position) > m_size) {
+        return StreamError::Truncated;
+    }
+
+    const auto target = static_cast<size_t>(position);
+    if (target < m_buffer_position || target >= m_buffer_position + m_buffer_size) {
+        if (m_block_index != 0) {
+            // Jump straight to the frame containing the target.
+            m_buffer_position = target - target % m_frame_size;
+            m_buffer_size = 0;
+            fill_buffer();
+        } else {
+            // Otherwise decompress up to the target, from the start if it's behind.
+            if (target < m_buffer_position) {
+                restart();
+            }
+            while (target >= m_buffer_position + m_buffer_size) {
+                fill_buffer();
+                if (m_buffer_size == 0) {
+                    break;
+                }
+            }
+        }
+    }
+    m_buffer_head = target - m_buffer_position;
+    return target;
+}
+
+Result<size_t, StreamError> ReadStream::read(Span<void> data) {
+    size_t bytes_read = 0;
+    while (bytes_read < data.size()) {
+        if (m_buffer_head == m_buffer_size) {
+            fill_buffer();
+            if (m_buffer_size == 0) {
+                break;
+            }
+        }
+        const auto to_copy = vull::min(data.size() - bytes_read, m_buffer_size - m_buffer_head);
+        memcpy(data.byte_offset(bytes_read), m_buffer + m_buffer_head, to_copy);
+        m_buffer_head += to_copy;
+        bytes_read += to_copy;
+    }
+    return bytes_read;
+}
+
+Result<uint8_t, StreamError> ReadStream::read_byte() {
+    if (m_buffer_head == m_buffer_size) [[unlikely]] {
+        fill_buffer();
+        if (m_buffer_size == 0) {
+            return StreamError::Truncated;
+        }
+    }
+    return m_buffer[m_buffer_head++];
 }
 
 Reader::Reader(File &&file) {
@@ -130,10 +237,16 @@ Reader::Reader(File &&file) {
 
     m_entries.ensure_size(entry_count);
     for (auto &entry : m_entries) {
-        entry.type = static_cast<EntryType>(VULL_EXPECT(stream.read_byte()));
+        const auto type = VULL_EXPECT(stream.read_byte());
+        entry.type = static_cast<EntryType>(type & ~k_seekable_entry_flag);
         entry.name = VULL_EXPECT(stream.read_string());
         entry.size = VULL_EXPECT(stream.read_varint<uint32_t>());
         entry.first_block = VULL_EXPECT(stream.read_varint<uint64_t>());
+        if ((type & k_seekable_entry_flag) != 0) {
+            entry.frame_size = VULL_EXPECT(stream.read_varint<uint32_t>());
+            entry.block_index = VULL_EXPECT(stream.read_varint<uint64_t>());
+            VULL_ENSURE(entry.frame_size != 0 && entry.frame_size <= ZSTD_DStreamOutSize());
+        }
     }
 
     // mmapping will keep the fd open even when the File is destructed.
@@ -153,8 +266,7 @@ bool Reader::exists(StringView name) const {
 
 UniquePtr<ReadStream> Reader::open(StringView name) const {
     const auto &entry = m_entries[m_phf.hash(name)];
-    return entry.name.view() == name ? vull::make_unique<ReadStream>(m_data, entry.first_block)
-                                     : UniquePtr<ReadStream>();
+    return entry.name.view() == name ? vull::make_unique<ReadStream>(m_data, entry) : UniquePtr<ReadStream>();
 }
 
 Optional<Entry> Reader::stat(StringView name) const {
@@ -162,4 +274,35 @@ Optional<Entry> Reader::stat(StringView name) const {
     return entry.name.view() == name ? entry : Optional<Entry>();
 }
 
+Result<size_t, StreamError> Reader::read_range(const Entry &entry, size_t offset, Span<void> data) const {
+    ReadStream stream(m_data, entry);
+    VULL_TRY(stream.seek(offset, SeekMode::Set));
+    return VULL_TRY(stream.read(data));
+}
+
+Result<void, StreamError> Reader::read_entry_parallel(const Entry &entry, Span<void> data) const {
+    VULL_ASSERT(data.size() >= entry.size);
+    if (!entry.seekable()) {
+        // Only seekable entries are split into independent frames.
+        ReadStream stream(m_data, entry);
+        if (VULL_TRY(stream.read({data.data(), entry.size})) != entry.size) {
+            return StreamError::Truncated;
+        }
+        return {};
+    }
+
+    const auto frame_count = vull::ceil_div(entry.size, entry.frame_size);
+    vull::parallel_for(0, frame_count, 1, [&](uint32_t frame_index) {
+        // Frames are decompressed into the worker's own buffer first as data may be uncached memory, which zstd would
+        // otherwise read back from.
+        auto context = acquire_context();
+        const auto size = decompress_frame(m_data, entry.block_index, frame_index, context.dctx, context.buffer);
+        const auto offset = frame_index * entry.frame_size;
+        VULL_ENSURE(size == vull::min(entry.frame_size, entry.size - offset));
+        memcpy(data.byte_offset(offset), context.buffer, size);
+        s_contexts.push(vull::move(context));
+    });
+    return {};
+}
+
 } // namespace vull::vpak
@@ -1,11 +1,15 @@
 #include <vull/vpak/writer.hh>
 
 #include <vull/container/array.hh>
+#include <vull/container/hash_map.hh>
 #include <vull/container/vector.hh>
 #include <vull/core/log.hh>
 #include <vull/maths/common.hh>
 #include <vull/support/algorithm.hh>
 #include <vull/support/assert.hh>
+#include <vull/support/enum.hh>
+#include <vull/support/hash.hh>
+#include <vull/support/optional.hh>
 #include <vull/support/perfect_hasher.hh>
 #include <vull/support/result.hh>
 #include <vull/support/scoped_lock.hh>
@@ -15,9 +19,12 @@
 #include <vull/support/string_view.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/future.hh>
 #include <vull/tasklet/mutex.hh>
+#include <vull/tasklet/tasklet.hh>
 #include <vull/vpak/pack_file.hh>
 
+#include <string.h>
 #include <zstd.h>
 
 namespace vull::vpak {
@@ -27,6 +34,10 @@ namespace {
 constexpr size_t k_zstd_block_size = ZSTD_COMPRESSBOUND(ZSTD_BLOCKSIZE_MAX) + 3 + 4;
 constexpr size_t k_block_size = k_zstd_block_size + sizeof(size_t);
 
+// Amount of uncompressed data in each frame of a seekable entry. A whole frame, including its header and checksum, is
+// guaranteed to fit in k_zstd_block_size, and its uncompressed data in ZSTD_DStreamOutSize.
+constexpr uint32_t k_frame_size = ZSTD_BLOCKSIZE_MAX;
+
 struct Context {
     ZSTD_CCtx *cctx;
     uint8_t *buffer;
@@ -54,41 +65,92 @@ struct Context {
 };
 VULL_GLOBAL(thread_local Vector<Context> s_contexts);
 
-} // namespace
-
-WriteStream::WriteStream(Writer &writer, UniquePtr<Stream> &&stream, Entry &entry)
-    : m_writer(writer), m_stream(vull::move(stream)), m_entry(entry) {
+Context acquire_context() {
     if (s_contexts.empty()) {
-        s_contexts.emplace();
+        return {};
     }
-
-    auto &context = s_contexts.last();
-    m_cctx = vull::exchange(context.cctx, nullptr);
-    m_buffer = vull::exchange(context.buffer, nullptr);
+    auto context = vull::move(s_contexts.last());
     s_contexts.pop();
+    return context;
+}
 
-    ZSTD_CCtx_reset(m_cctx, ZSTD_reset_session_only);
-    switch (writer.m_clevel) {
+void set_compression_level(ZSTD_CCtx *cctx, CompressionLevel clevel) {
+    switch (clevel) {
     case CompressionLevel::Fast:
-        ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, ZSTD_minCLevel());
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, ZSTD_minCLevel());
         break;
     case CompressionLevel::Normal:
-        ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, 19);
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 19);
         break;
     case CompressionLevel::Ultra:
-        ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, ZSTD_maxCLevel());
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, ZSTD_maxCLevel());
         break;
     }
 }
 
+// Compresses data as a single frame into buffer, which must be k_zstd_block_size bytes.
+size_t compress_frame(ZSTD_CCtx *cctx, Span<const uint8_t> data, uint8_t *buffer) {
+    const auto size = ZSTD_compress2(cctx, buffer, k_zstd_block_size, data.data(), data.size());
+    VULL_ENSURE(ZSTD_isError(size) == 0);
+    return size;
+}
+
+} // namespace
+
+WriteStream::WriteStream(Writer &writer, UniquePtr<Stream> &&stream, Entry &entry, bool seekable)
+    : m_writer(writer), m_stream(vull::move(stream)), m_entry(entry), m_seekable(seekable) {
+    auto context = acquire_context();
+    m_cctx = vull::exchange(context.cctx, nullptr);
+    m_buffer = vull::exchange(context.buffer, nullptr);
+
+    ZSTD_CCtx_reset(m_cctx, ZSTD_reset_session_only);
+    set_compression_level(m_cctx, writer.m_clevel);
+
+    // Seekable frames are small enough that zstd wouldn't split them between threads anyway.
+    ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_nbWorkers, seekable ? 0 : static_cast<int>(writer.m_zstd_worker_count));
+    if (seekable) {
+        m_frame_input.ensure_capacity(k_frame_size);
+    }
+}
+
 WriteStream::~WriteStream() {
     // Ensure that all data has been flushed.
     VULL_ASSERT(m_compress_head == 0);
     s_contexts.emplace(m_cctx, m_buffer);
 }
 
+// Writes a complete zstd frame, or reuses an identical one already written. Since compression is deterministic, equal
+// compressed bytes imply equal contents.
+Result<uint64_t, StreamError> WriteStream::write_deduplicated(Span<const void> data) {
+    const auto hash = XXH3_64bits(data.data(), data.size());
+    if (auto stored = m_writer.find_stored_frame(hash); stored && stored->size == data.size()) {
+        // Compare the bytes to rule out a hash collision.
+        Vector<uint8_t, size_t> stored_bytes;
+        stored_bytes.ensure_size(stored->size);
+        VULL_TRY(m_stream->seek(stored->offset, SeekMode::Set));
+        if (VULL_TRY(m_stream->read(stored_bytes.span())) == stored->size &&
+            memcmp(stored_bytes.data(), data.data(), data.size()) == 0) {
+            return stored->offset;
+        }
+    }
+
+    const auto offset = VULL_TRY(m_writer.allocate(data.size()));
+    VULL_TRY(m_stream->seek(offset, SeekMode::Set));
+    VULL_TRY(m_stream->write(data));
+    m_writer.add_stored_frame(hash, {offset, data.size()});
+    m_compressed_size += data.size();
+    return offset;
+}
+
 Result<void, StreamError> WriteStream::flush_block() {
     const bool last = m_compress_head != k_zstd_block_size;
+    if (last && m_block_link_offset == 0) {
+        // The whole entry is a single frame in a single block, so can be shared with identical entries.
+        m_entry.first_block = VULL_TRY(write_deduplicated({m_buffer, m_compress_head}));
+        m_compress_head = 0;
+        return {};
+    }
+
     size_t block_offset = VULL_TRY(m_writer.allocate(last ? m_compress_head : k_block_size));
     if (m_entry.first_block == 0) {
         m_entry.first_block = block_offset;
@@ -105,7 +167,73 @@ Result<void, StreamError> WriteStream::flush_block() {
     return {};
 }
 
+Result<void, StreamError> WriteStream::commit_frame(Span<const void> frame) {
+    const auto frame_offset = VULL_TRY(write_deduplicated(frame));
+    if (m_entry.first_block == 0) {
+        m_entry.first_block = frame_offset;
+    }
+    m_frame_offsets.push(frame_offset);
+    return {};
+}
+
+Result<void, StreamError> WriteStream::commit_pending_frame() {
+    auto &future = m_pending_frames[m_pending_head];
+    auto frame = VULL_EXPECT(future.await());
+    future = {};
+    m_pending_head = (m_pending_head + 1) % k_max_pending_frames;
+    m_pending_count--;
+    return commit_frame(frame.span());
+}
+
+Result<void, StreamError> WriteStream::submit_frame() {
+    if (Tasklet::current() == nullptr) {
+        const auto size = compress_frame(m_cctx, m_frame_input.span(), m_buffer);
+        m_frame_input.clear();
+        return commit_frame({m_buffer, size});
+    }
+
+    // Frames are committed in order so that the output is deterministic, and the number in flight is bounded.
+    if (m_pending_count == k_max_pending_frames) {
+        VULL_TRY(commit_pending_frame());
+    }
+    auto &future = m_pending_frames[(m_pending_head + m_pending_count++) % k_max_pending_frames];
+    future = vull::schedule_future([input = vull::move(m_frame_input), clevel = m_writer.m_clevel] {
+        auto context = acquire_context();
+        ZSTD_CCtx_reset(context.cctx, ZSTD_reset_session_only);
+        set_compression_level(context.cctx, clevel);
+        ZSTD_CCtx_setParameter(context.cctx, ZSTD_c_nbWorkers, 0);
+        const auto size = compress_frame(context.cctx, input.span(), context.buffer);
+
+        Vector<uint8_t, uint32_t> frame;
+        frame.ensure_size(static_cast<uint32_t>(size));
+        memcpy(frame.data(), context.buffer, size);
+        s_contexts.push(vull::move(context));
+        return frame;
+    });
+    m_frame_input = {};
+    m_frame_input.ensure_capacity(k_frame_size);
+    return {};
+}
+
 float WriteStream::finish() {
+    if (m_seekable) {
+        if (!m_frame_input.empty()) {
+            VULL_EXPECT(submit_frame());
+        }
+        while (m_pending_count > 0) {
+            VULL_EXPECT(commit_pending_frame());
+        }
+        const auto index_size = m_frame_offsets.size() * sizeof(uint64_t);
+        m_entry.block_index = VULL_EXPECT(m_writer.allocate(index_size));
+        m_entry.frame_size = k_frame_size;
+        VULL_EXPECT(m_stream->seek(m_entry.block_index, SeekMode::Set));
+        for (const auto frame_offset : m_frame_offsets) {
+            VULL_EXPECT(m_stream->write_be(frame_offset));
+        }
+        m_compressed_size += index_size;
+        return static_cast<float>(m_compressed_size) / static_cast<float>(m_entry.size) * 100.0f;
+    }
+
     size_t remaining = 0;
     do {
         ZSTD_inBuffer input{};
@@ -127,8 +255,28 @@ float WriteStream::finish() {
     return static_cast<float>(m_compressed_size) / static_cast<float>(m_entry.size) * 100.0f;
 }
 
+Result<void, StreamError> WriteStream::write_seekable(Span<const void> data) {
+    m_entry.size += data.size();
+    for (size_t bytes_written = 0; bytes_written < data.size();) {
+        // Start a new frame every k_frame_size bytes so that each can be decompressed independently.
+        const auto to_copy =
+            vull::min(data.size() - bytes_written, static_cast<size_t>(k_frame_size - m_frame_input.size()));
+        const auto offset = m_frame_input.size();
+        m_frame_input.ensure_size(offset + static_cast<uint32_t>(to_copy));
+        memcpy(m_frame_input.data() + offset, data.byte_offset(bytes_written), to_copy);
+        bytes_written += to_copy;
+        if (m_frame_input.size() == k_frame_size) {
+            VULL_TRY(submit_frame());
+        }
+    }
+    return {};
+}
+
 // TODO: Better input buffering.
 Result<void, StreamError> WriteStream::write(Span<const void> data) {
+    if (m_seekable) {
+        return write_seekable(data);
+    }
     m_entry.size += data.size();
     for (size_t bytes_written = 0; bytes_written < data.size();) {
         ZSTD_inBuffer input{
@@ -154,6 +302,9 @@ Result<void, StreamError> WriteStream::write(Span<const void> data) {
 }
 
 Result<void, StreamError> WriteStream::write_byte(uint8_t byte) {
+    if (m_seekable) {
+        return write_seekable({&byte, 1});
+    }
     m_entry.size++;
     ZSTD_inBuffer input{
         .src = &byte,
@@ -191,7 +342,7 @@ uint64_t Writer::finish() {
     return VULL_EXPECT(m_stream->seek(0, SeekMode::Add));
 }
 
-WriteStream Writer::start_entry(String name, EntryType type) {
+WriteStream Writer::start_entry(String name, EntryType type, bool seekable) {
     auto new_entry = vull::make_unique<Entry>(Entry{
         .name = name,
         .type = type,
@@ -202,11 +353,19 @@ WriteStream Writer::start_entry(String name, EntryType type) {
         if (entry->name == name) {
             vull::warn("[vpak] Overwriting {}", name);
             entry = vull::move(new_entry);
-            return {*this, m_stream->clone_unique(), *entry};
+            return {*this, m_stream->clone_unique(), *entry, seekable};
         }
     }
     auto &entry = *m_entries.emplace(vull::move(new_entry));
-    return {*this, m_stream->clone_unique(), entry};
+    return {*this, m_stream->clone_unique(), entry, seekable};
+}
+
+bool Writer::set_zstd_worker_count(uint32_t count) {
+    if (count > 0 && ZSTD_cParam_getBounds(ZSTD_c_nbWorkers).upperBound == 0) {
+        return false;
+    }
+    m_zstd_worker_count = count;
+    return true;
 }
 
 Result<uint64_t, StreamError> Writer::allocate(size_t size) {
@@ -214,6 +373,21 @@ Result<uint64_t, StreamError> Writer::allocate(size_t size) {
     return VULL_TRY(m_stream->seek(size, SeekMode::Add)) - size;
 }
 
+Optional<Writer::StoredData> Writer::find_stored_frame(uint64_t hash) {
+    ScopedLock lock(m_mutex);
+    if (auto data = m_stored_frames.get(hash)) {
+        return *data;
+    }
+    return {};
+}
+
+void Writer::add_stored_frame(uint64_t hash, StoredData data) {
+    ScopedLock lock(m_mutex);
+    if (!m_stored_frames.contains(hash)) {
+        m_stored_frames.set(hash, data);
+    }
+}
+
 Result<void, StreamError> Writer::read_existing() {
     if (VULL_TRY(m_stream->seek(0, SeekMode::End)) == 0) {
         // File empty, creating a new vpak.
@@ -232,10 +406,15 @@ Result<void, StreamError> Writer::read_existing() {
     m_entries.ensure_size(entry_count);
     for (auto &entry : m_entries) {
         entry = vull::make_unique<Entry>();
-        entry->type = static_cast<EntryType>(VULL_TRY(m_stream->read_byte()));
+        const auto type = VULL_TRY(m_stream->read_byte());
+        entry->type = static_cast<EntryType>(type & ~k_seekable_entry_flag);
         entry->name = VULL_TRY(m_stream->read_string());
         entry->size = VULL_TRY(m_stream->read_varint<uint32_t>());
         entry->first_block = VULL_TRY(m_stream->read_varint<uint64_t>());
+        if ((type & k_seekable_entry_flag) != 0) {
+            entry->frame_size = VULL_TRY(m_stream->read_varint<uint32_t>());
+            entry->block_index = VULL_TRY(m_stream->read_varint<uint64_t>());
+        }
     }
     return {};
 }
@@ -267,10 +446,15 @@ void Writer::write_entry_table() {
     }
     for (const auto &entry : m_entries) {
         // See PackFile.hh for the definition of an entry header.
-        VULL_EXPECT(m_stream->write_byte(static_cast<uint8_t>(entry->type)));
+        const auto flags = entry->seekable() ? k_seekable_entry_flag : 0u;
+        VULL_EXPECT(m_stream->write_byte(static_cast<uint8_t>(vull::to_underlying(entry->type) | flags)));
         VULL_EXPECT(m_stream->write_string(entry->name));
         VULL_EXPECT(m_stream->write_varint(entry->size));
         VULL_EXPECT(m_stream->write_varint(entry->first_block));
+        if (entry->seekable()) {
+            VULL_EXPECT(m_stream->write_varint(entry->frame_size));
+            VULL_EXPECT(m_stream->write_varint(entry->block_index));
+        }
     }
 }
 
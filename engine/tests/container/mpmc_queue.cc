@@ -0,0 +1,134 @@
+#include <vull/container/mpmc_queue.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/support/algorithm.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <pthread.h>
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+TEST_CASE(MpmcQueue, Empty) {
+    auto queue = vull::make_unique<MpmcQueue<unsigned>>();
+    EXPECT_THAT(*queue, is(empty()));
+    EXPECT_THAT(queue->dequeue(), is(null()));
+}
+
+TEST_CASE(MpmcQueue, EnqueueDequeue) {
+    auto queue = vull::make_unique<MpmcQueue<unsigned>>();
+    for (unsigned i = 0; i < 512; i++) {
+        EXPECT_TRUE(queue->enqueue(i));
+    }
+    EXPECT_THAT(*queue, is(not_(empty())));
+    for (unsigned i = 0; i < 512; i++) {
+        EXPECT_THAT(queue->dequeue(), is(equal_to(i)));
+    }
+    EXPECT_THAT(*queue, is(empty()));
+    EXPECT_THAT(queue->dequeue(), is(null()));
+}
+
+TEST_CASE(MpmcQueue, OverCapacity) {
+    auto queue = vull::make_unique<MpmcQueue<unsigned, 1>>();
+    for (unsigned i = 0; i < 2; i++) {
+        EXPECT_TRUE(queue->enqueue(i));
+    }
+    EXPECT_FALSE(queue->enqueue(2u));
+    EXPECT_THAT(queue->dequeue(), is(equal_to(0u)));
+    EXPECT_TRUE(queue->enqueue(2u));
+    EXPECT_THAT(queue->dequeue(), is(equal_to(1u)));
+    EXPECT_THAT(queue->dequeue(), is(equal_to(2u)));
+}
+
+TEST_CASE(MpmcQueue, Threaded) {
+    constexpr uint32_t k_per_producer = 10000;
+    auto queue = vull::make_unique<MpmcQueue<unsigned>>();
+    Vector<pthread_t> producer_threads(2);
+    Vector<pthread_t> consumer_threads(2);
+    Vector<Vector<unsigned>> consumer_popped(consumer_threads.size());
+    Atomic<uint32_t> popped_count;
+
+    struct ProducerData {
+        MpmcQueue<unsigned> &queue;
+        unsigned base;
+    };
+    struct ConsumerData {
+        MpmcQueue<unsigned> &queue;
+        Vector<unsigned> &popped;
+        Atomic<uint32_t> &popped_count;
+        uint32_t total;
+    };
+    Vector<ProducerData> producer_data;
+    for (uint32_t i = 0; i < producer_threads.size(); i++) {
+        producer_data.push({*queue, i * k_per_producer});
+    }
+    Vector<ConsumerData> consumer_data;
+    for (uint32_t i = 0; i < consumer_threads.size(); i++) {
+        consumer_data.push({*queue, consumer_popped[i], popped_count, producer_threads.size() * k_per_producer});
+    }
+
+    for (uint32_t i = 0; i < producer_threads.size(); i++) {
+        ASSERT_THAT(pthread_create(
+                        &producer_threads[i], nullptr,
+                        +[](void *ptr) {
+                            auto *data = static_cast<ProducerData *>(ptr);
+                            for (unsigned j = 0; j < k_per_producer;) {
+                                if (data->queue.enqueue(data->base + j)) {
+                                    j++;
+                                }
+                            }
+                            return static_cast<void *>(nullptr);
+                        },
+                        &producer_data[i]),
+                    is(equal_to(0)));
+    }
+    for (uint32_t i = 0; i < consumer_threads.size(); i++) {
+        ASSERT_THAT(pthread_create(
+                        &consumer_threads[i], nullptr,
+                        +[](void *ptr) {
+                            auto *data = static_cast<ConsumerData *>(ptr);
+                            while (data->popped_count.load() != data->total) {
+                                if (auto elem = data->queue.dequeue()) {
+                                    data->popped.push(*elem);
+                                    data->popped_count.fetch_add(1);
+                                }
+                            }
+                            return static_cast<void *>(nullptr);
+                        },
+                        &consumer_data[i]),
+                    is(equal_to(0)));
+    }
+
+    for (pthread_t thread : producer_threads) {
+        pthread_join(thread, nullptr);
+    }
+    for (pthread_t thread : consumer_threads) {
+        pthread_join(thread, nullptr);
+    }
+    EXPECT_THAT(*queue, is(empty()));
+
+    // Each consumer should see each producer's elements in order.
+    Vector<unsigned> all_popped;
+    for (const auto &popped : consumer_popped) {
+        Vector<unsigned> last_seen(producer_threads.size());
+        for (unsigned elem : popped) {
+            auto &last = last_seen[elem / k_per_producer];
+            EXPECT_TRUE(elem % k_per_producer == 0 || elem > last);
+            last = elem;
+            all_popped.push(elem);
+        }
+    }
+    ASSERT_THAT(all_popped.size(), is(equal_to(producer_threads.size() * k_per_producer)));
+
+    vull::sort(all_popped, [](unsigned a, unsigned b) {
+        return a > b;
+    });
+    for (unsigned i = 0; i < all_popped.size(); i++) {
+        EXPECT_THAT(all_popped[i], is(equal_to(i)));
+    }
+}
@@ -1,8 +1,10 @@
 #include <vull/container/work_stealing_queue.hh>
 
+#include <vull/container/array.hh>
 #include <vull/container/vector.hh>
 #include <vull/support/algorithm.hh>
 #include <vull/support/atomic.hh>
+#include <vull/support/span.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 #include <vull/test/assertions.hh>
@@ -59,6 +61,52 @@ TEST_CASE(WorkStealingQueue, EnqueueSteal) {
     EXPECT_THAT(wsq->steal(), is(null()));
 }
 
+TEST_CASE(WorkStealingQueue, StealBatch) {
+    auto wsq = vull::make_unique<WorkStealingQueue<unsigned>>();
+    for (unsigned i = 0; i < 9; i++) {
+        EXPECT_TRUE(wsq->enqueue(i));
+    }
+
+    // Half of the queue, rounded up, should be stolen oldest first.
+    Array<unsigned, 16> buffer{};
+    EXPECT_THAT(wsq->steal_batch(buffer.span()), is(equal_to(5)));
+    for (unsigned i = 0; i < 5; i++) {
+        EXPECT_THAT(buffer[i], is(equal_to(i)));
+    }
+    EXPECT_THAT(wsq->size(), is(equal_to(4)));
+    EXPECT_THAT(wsq->dequeue(), is(equal_to(8u)));
+
+    EXPECT_THAT(wsq->steal_batch(buffer.span()), is(equal_to(2)));
+    EXPECT_THAT(wsq->steal_batch(buffer.span()), is(equal_to(1)));
+    EXPECT_THAT(buffer[0], is(equal_to(7)));
+    EXPECT_THAT(wsq->steal_batch(buffer.span()), is(equal_to(0)));
+    EXPECT_THAT(*wsq, is(empty()));
+}
+
+TEST_CASE(WorkStealingQueue, StealBatchLimit) {
+    auto wsq = vull::make_unique<WorkStealingQueue<unsigned>>();
+    for (unsigned i = 0; i < 512; i++) {
+        EXPECT_TRUE(wsq->enqueue(i));
+    }
+    Array<unsigned, 8> buffer{};
+    EXPECT_THAT(wsq->steal_batch(buffer.span()), is(equal_to(8)));
+    EXPECT_THAT(buffer[7], is(equal_to(7)));
+    EXPECT_THAT(wsq->size(), is(equal_to(504)));
+}
+
+TEST_CASE(WorkStealingQueue, Wraparound) {
+    auto wsq = vull::make_unique<WorkStealingQueue<unsigned, 2>>();
+    Array<unsigned, 4> buffer{};
+    for (unsigned i = 0; i < 100000; i++) {
+        EXPECT_TRUE(wsq->enqueue(i));
+        EXPECT_TRUE(wsq->enqueue(i + 1));
+        EXPECT_THAT(wsq->steal_batch(buffer.span()), is(equal_to(1)));
+        EXPECT_THAT(buffer[0], is(equal_to(i)));
+        EXPECT_THAT(wsq->steal(), is(equal_to(i + 1)));
+    }
+    EXPECT_THAT(*wsq, is(empty()));
+}
+
 TEST_CASE(WorkStealingQueue, OverCapacity) {
     auto wsq = vull::make_unique<WorkStealingQueue<unsigned, 1>>();
     for (unsigned i = 0; i < 2; i++) {
@@ -94,11 +142,18 @@ TEST_CASE(WorkStealingQueue, Threaded) {
                             auto *data = static_cast<ConsumerData *>(ptr);
                             auto seed = static_cast<unsigned>(time(nullptr));
                             while (data->popped_count.load() != 1024) {
-                                if (rand_r(&seed) % 3 == 0) {
+                                if (int num = rand_r(&seed) % 6; num == 0) {
                                     if (auto elem = data->wsq.steal()) {
                                         data->consumer_popped.push(*elem);
                                         data->popped_count.fetch_add(1);
                                     }
+                                } else if (num == 1) {
+                                    Array<unsigned, 4> buffer{};
+                                    const uint32_t count = data->wsq.steal_batch(buffer.span());
+                                    for (uint32_t i = 0; i < count; i++) {
+                                        data->consumer_popped.push(buffer[i]);
+                                    }
+                                    data->popped_count.fetch_add(count);
                                 }
                             }
                             return static_cast<void *>(nullptr);
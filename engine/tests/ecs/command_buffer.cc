@@ -0,0 +1,183 @@
+#include <vull/ecs/command_buffer.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace vull {
+
+struct Stream;
+
+} // namespace vull
+
+namespace {
+
+struct Foo {
+    VULL_DECLARE_COMPONENT(0);
+    uint32_t value;
+};
+
+struct Bar {
+    VULL_DECLARE_COMPONENT(1);
+    int *destruct_count{nullptr};
+
+    Bar() = default;
+    explicit Bar(int &count) : destruct_count(&count) {}
+    Bar(const Bar &) = delete;
+    Bar(Bar &&other) : destruct_count(vull::exchange(other.destruct_count, nullptr)) {}
+    ~Bar() {
+        if (destruct_count != nullptr) {
+            (*destruct_count)++;
+        }
+    }
+
+    Bar &operator=(const Bar &) = delete;
+    Bar &operator=(Bar &&other) {
+        vull::swap(destruct_count, other.destruct_count);
+        return *this;
+    }
+
+    static Bar deserialise(Stream &) { VULL_ENSURE_NOT_REACHED(); }
+    static void serialise(Bar &, Stream &) {}
+};
+
+// Spawns a new entity for every even Foo, tags every Foo divisible by three with a Bar, and destroys every Foo divisible
+// by five, using the value as the sort key.
+void record(EcsCommandBuffer &buffer, Entity entity, Foo &foo) {
+    if (foo.value % 2 == 0) {
+        auto spawned = buffer.create_entity(foo.value);
+        buffer.add_component<Foo>(foo.value, spawned, foo.value + 1000);
+    }
+    if (foo.value % 3 == 0) {
+        buffer.add_component<Bar>(foo.value, entity);
+    }
+    if (foo.value % 5 == 0) {
+        buffer.destroy_entity(foo.value, entity);
+    }
+}
+
+Vector<uint32_t> run(bool parallel) {
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Bar>();
+    for (uint32_t i = 0; i < 1000; i++) {
+        manager.create_entity().add<Foo>(i);
+    }
+
+    if (parallel) {
+        Scheduler scheduler(4);
+        scheduler.start([&] {
+            EcsCommandBuffer buffer;
+            manager.view<Foo>().parallel_each(16, [&](Entity entity, Foo &foo) {
+                record(buffer, entity, foo);
+            });
+            buffer.apply(manager);
+            scheduler.stop();
+        });
+    } else {
+        EcsCommandBuffer buffer;
+        for (auto [entity, foo] : manager.view<Foo>()) {
+            record(buffer, entity, foo);
+        }
+        buffer.apply(manager);
+    }
+
+    // Flatten the resulting world into (id, value, has bar) triples.
+    Vector<uint32_t> state;
+    for (auto [entity, foo] : manager.view<Foo>()) {
+        state.push(entity);
+        state.push(foo.value);
+        state.push(manager.has_component<Bar>(entity) ? 1 : 0);
+    }
+    return state;
+}
+
+} // namespace
+
+TEST_CASE(EcsCommandBuffer, Apply) {
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Bar>();
+    auto existing = manager.create_entity();
+    existing.add<Foo>(1u);
+    auto doomed = manager.create_entity();
+    doomed.add<Foo>(2u);
+
+    EcsCommandBuffer buffer;
+    auto pending = buffer.create_entity(0);
+    buffer.add_component<Foo>(0, pending, 3u);
+    buffer.add_component<Bar>(0, pending);
+    buffer.remove_component<Foo>(0, existing);
+    buffer.destroy_entity(0, doomed);
+    EXPECT_THAT(buffer.command_count(), is(equal_to(5u)));
+
+    // Nothing should happen until the buffer is applied.
+    EXPECT_TRUE(existing.has<Foo>());
+    EXPECT_TRUE(manager.valid(doomed));
+    EXPECT_THAT(manager.component_count<Foo>(), is(equal_to(2u)));
+
+    buffer.apply(manager);
+    EXPECT_THAT(buffer.command_count(), is(equal_to(0u)));
+    EXPECT_FALSE(existing.has<Foo>());
+    EXPECT_FALSE(doomed.has<Foo>());
+    EXPECT_THAT(manager.component_count<Foo>(), is(equal_to(1u)));
+    EXPECT_THAT(manager.component_count<Bar>(), is(equal_to(1u)));
+    for (auto [entity, foo] : manager.view<Foo>()) {
+        EXPECT_THAT(foo.value, is(equal_to(3u)));
+        EXPECT_TRUE(entity.has<Bar>());
+    }
+}
+
+TEST_CASE(EcsCommandBuffer, SortKeyOrder) {
+    EntityManager manager;
+    manager.register_component<Foo>();
+    auto entity = manager.create_entity();
+
+    // Commands should apply in sort key order, and in recorded order within the same key.
+    EcsCommandBuffer buffer;
+    buffer.add_component<Foo>(2, entity, 2u);
+    buffer.add_component<Foo>(1, entity, 1u);
+    buffer.add_component<Foo>(0, entity, 0u);
+    buffer.remove_component<Foo>(1, entity);
+    buffer.remove_component<Foo>(0, entity);
+    buffer.apply(manager);
+    EXPECT_THAT(entity.get<Foo>().value, is(equal_to(2u)));
+}
+
+TEST_CASE(EcsCommandBuffer, ClearDestructs) {
+    int destruct_count = 0;
+    EntityManager manager;
+    manager.register_component<Bar>();
+    auto entity = manager.create_entity();
+    {
+        EcsCommandBuffer buffer;
+        buffer.add_component<Bar>(0, entity, destruct_count);
+        buffer.add_component<Bar>(1, entity, destruct_count);
+        buffer.clear();
+        EXPECT_THAT(destruct_count, is(equal_to(2)));
+        buffer.add_component<Bar>(0, entity, destruct_count);
+    }
+    EXPECT_THAT(destruct_count, is(equal_to(3)));
+    EXPECT_FALSE(entity.has<Bar>());
+}
+
+TEST_CASE(EcsCommandBuffer, ParallelDeterministic) {
+    const auto serial = run(false);
+    const auto parallel = run(true);
+    ASSERT_THAT(parallel.size(), is(equal_to(serial.size())));
+    for (uint32_t i = 0; i < serial.size(); i++) {
+        EXPECT_THAT(parallel[i], is(equal_to(serial[i])));
+    }
+}
@@ -6,10 +6,13 @@
 #include <vull/support/assert.hh>
 #include <vull/support/tuple.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/scheduler.hh>
 #include <vull/test/assertions.hh>
 #include <vull/test/matchers.hh>
 #include <vull/test/test.hh>
 
+#include <stdint.h>
+
 using namespace vull;
 using namespace vull::test::matchers;
 
@@ -80,6 +83,94 @@ TEST_CASE(Entity, CreateDestroy) {
     }
 }
 
+TEST_CASE(Entity, Recycle) {
+    EntityManager manager;
+    Vector<EntityId> entities;
+    for (int i = 0; i < 8; i++) {
+        entities.push(manager.create_entity());
+    }
+    manager.destroy_entity(entities[5]);
+    manager.destroy_entity(entities[2]);
+    manager.destroy_entity(entities[6]);
+
+    // The lowest free index should be reused first, with a bumped version.
+    auto recycled = manager.create_entity();
+    EXPECT_THAT(entity_index(recycled), is(equal_to(2u)));
+    EXPECT_THAT(entity_version(recycled), is(equal_to(1u)));
+    EXPECT_THAT(entity_index(manager.create_entity()), is(equal_to(5u)));
+    EXPECT_THAT(entity_index(manager.create_entity()), is(equal_to(6u)));
+    EXPECT_THAT(entity_index(manager.create_entity()), is(equal_to(8u)));
+
+    // The stale ID should stay invalid.
+    EXPECT_FALSE(manager.valid(entities[2]));
+    EXPECT_TRUE(manager.valid(recycled));
+}
+
+TEST_CASE(Entity, RetireVersion) {
+    EntityManager manager;
+    EntityId id = manager.create_entity();
+    for (uint32_t i = 0; i < 255; i++) {
+        manager.destroy_entity(id);
+        id = manager.create_entity();
+        EXPECT_THAT(entity_index(id), is(equal_to(0u)));
+    }
+
+    // Out of versions, so the index shouldn't be reused again.
+    EXPECT_THAT(entity_version(id), is(equal_to(255u)));
+    manager.destroy_entity(id);
+    EXPECT_THAT(entity_index(manager.create_entity()), is(equal_to(1u)));
+}
+
+TEST_CASE(Entity, ViewVersionedIds) {
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.create_entity().destroy();
+    auto entity = manager.create_entity();
+    entity.add<Foo>();
+    for (auto [view_entity, foo] : manager.view<Foo>()) {
+        EXPECT_THAT(EntityId(view_entity), is(equal_to(EntityId(entity))));
+    }
+}
+
+TEST_CASE(Entity, Compact) {
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Bar>();
+    manager.register_group<Foo, Bar>();
+
+    Vector<EntityId> entities;
+    for (int i = 0; i < 3000; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Foo>();
+        if (i % 2 == 0) {
+            entity.add<Bar>();
+        }
+        entities.push(entity);
+    }
+    for (uint32_t i = 0; i < 3000; i++) {
+        if (i % 3 != 0) {
+            manager.destroy_entity(entities[i]);
+        }
+    }
+
+    const auto new_indices = manager.compact();
+    ASSERT_THAT(new_indices.size(), is(equal_to(3000u)));
+    for (uint32_t i = 0; i < 3000; i++) {
+        EXPECT_THAT(new_indices[i], is(equal_to(i % 3 == 0 ? i / 3 : k_reserved_entity_index)));
+    }
+
+    // Entities should be renumbered densely, keeping their components.
+    EXPECT_THAT(manager.component_count<Foo>(), is(equal_to(1000u)));
+    for (EntityId id = 0; id < 1000; id++) {
+        EXPECT_TRUE(manager.valid(id));
+        EXPECT_TRUE(manager.has_component<Foo>(id));
+        EXPECT_THAT(manager.has_component<Bar>(id), is(equal_to(id % 2 == 0)));
+    }
+    EXPECT_FALSE(manager.valid(1000));
+    EXPECT_THAT(EntityId(manager.create_entity()), is(equal_to(1000u)));
+    EXPECT_THAT((sum_view<Foo, Bar>(manager).size()), is(equal_to(500u)));
+}
+
 TEST_CASE(Entity, AddRemoveComponent) {
     EntityManager manager;
     manager.register_component<Foo>();
@@ -186,3 +277,202 @@ TEST_CASE(Entity, ViewNoFirstMatch) {
     auto view = manager.view<Foo, Bar>();
     EXPECT_THAT(view.begin(), is(equal_to(view.end())));
 }
+
+TEST_CASE(Entity, ViewParallelReduce) {
+    // The result should match a serial iteration, in the same order.
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Bar>();
+    for (uint32_t i = 0; i < 5000; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Foo>();
+        if (i % 3 == 0) {
+            entity.add<Bar>();
+        }
+    }
+
+    Vector<EntityId> expected;
+    for (auto [entity, foo, bar] : manager.view<Foo, Bar>()) {
+        expected.push(entity);
+    }
+
+    Vector<EntityId> matching;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            matching = manager.view<Foo, Bar>().parallel_reduce<Vector<EntityId>>(
+                16,
+                [](Vector<EntityId> &ids, Entity entity, Foo &, Bar &) {
+                    ids.push(entity);
+                },
+                [](Vector<EntityId> &ids, Vector<EntityId> &&other) {
+                    ids.extend(other);
+                });
+            scheduler.stop();
+        });
+    }
+    ASSERT_THAT(matching.size(), is(equal_to(expected.size())));
+    for (uint32_t i = 0; i < expected.size(); i++) {
+        EXPECT_THAT(matching[i], is(equal_to(expected[i])));
+    }
+}
+
+static void expect_grouped_view(EntityManager &manager, uint32_t entity_count) {
+    // Every entity with both components should be visited exactly once.
+    Vector<uint32_t> visit_counts(entity_count);
+    for (auto [entity, foo, bar] : manager.view<Foo, Bar>()) {
+        EXPECT_TRUE((entity.has<Foo, Bar>()));
+        EXPECT_THAT(&foo, is(equal_to(&entity.get<Foo>())));
+        EXPECT_THAT(&bar, is(equal_to(&entity.get<Bar>())));
+        visit_counts[entity]++;
+    }
+    for (EntityId id = 0; id < entity_count; id++) {
+        const bool has_both = manager.valid(id) && manager.has_component<Foo, Bar>(id);
+        EXPECT_THAT(visit_counts[id], is(equal_to(has_both ? 1u : 0u)));
+    }
+}
+
+TEST_CASE(Entity, Group) {
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Bar>();
+    manager.register_group<Foo, Bar>();
+
+    Vector<Entity> entities;
+    for (uint32_t i = 0; i < 300; i++) {
+        auto entity = manager.create_entity();
+        if (i % 2 == 0) {
+            entity.add<Foo>();
+        }
+        if (i % 3 == 0) {
+            entity.add<Bar>();
+        }
+        entities.push(entity);
+    }
+    expect_grouped_view(manager, entities.size());
+
+    for (uint32_t i = 0; i < entities.size(); i += 5) {
+        if (entities[i].has<Bar>()) {
+            entities[i].remove<Bar>();
+        } else {
+            entities[i].add<Bar>();
+        }
+    }
+    expect_grouped_view(manager, entities.size());
+
+    for (uint32_t i = 0; i < entities.size(); i += 7) {
+        entities[i].destroy();
+    }
+    expect_grouped_view(manager, entities.size());
+}
+
+TEST_CASE(Entity, GroupExistingEntities) {
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Bar>();
+    for (uint32_t i = 0; i < 100; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Bar>();
+        if (i % 4 == 0) {
+            entity.add<Foo>();
+        }
+    }
+    manager.register_group<Foo, Bar>();
+    expect_grouped_view(manager, 100);
+}
+
+TEST_CASE(Entity, ViewSmallestSet) {
+    // Iteration should be driven by the smaller set, regardless of component order.
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Bar>();
+    for (uint32_t i = 0; i < 100; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Foo>();
+        if (i >= 90) {
+            entity.add<Bar>();
+        }
+    }
+    Vector<EntityId> matching;
+    for (auto [entity, foo, bar] : manager.view<Foo, Bar>()) {
+        matching.push(entity);
+    }
+    ASSERT_THAT(matching.size(), is(equal_to(10u)));
+    for (uint32_t i = 0; i < matching.size(); i++) {
+        EXPECT_THAT(matching[i], is(equal_to(EntityId(90 + i))));
+    }
+}
+
+template <typename... Comps>
+static uint32_t count_changed(EntityManager &manager, uint32_t tick) {
+    uint32_t count = 0;
+    for ([[maybe_unused]] auto tuple : manager.view<const Comps...>().changed_since(tick)) {
+        count++;
+    }
+    return count;
+}
+
+TEST_CASE(Entity, ChangedSince) {
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Bar>();
+    Vector<Entity> entities;
+    for (uint32_t i = 0; i < 10; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Foo>();
+        entity.add<Bar>();
+        entities.push(entity);
+    }
+
+    // Everything is new.
+    EXPECT_THAT(count_changed<Foo>(manager, 0), is(equal_to(10u)));
+    auto tick = manager.advance_tick();
+    EXPECT_THAT(count_changed<Foo>(manager, tick), is(equal_to(0u)));
+    EXPECT_THAT((count_changed<Foo, Bar>(manager, tick)), is(equal_to(0u)));
+
+    // Immutable access shouldn't count as a change.
+    [[maybe_unused]] const auto &foo = entities[0].get<Foo>();
+    for ([[maybe_unused]] auto tuple : manager.view<const Foo, const Bar>()) {
+    }
+    EXPECT_THAT(count_changed<Foo>(manager, tick), is(equal_to(0u)));
+
+    [[maybe_unused]] auto &bar = entities[3].get_mut<Bar>();
+    entities[5].try_get_mut<Foo>();
+    EXPECT_THAT(count_changed<Foo>(manager, tick), is(equal_to(1u)));
+    EXPECT_THAT(count_changed<Bar>(manager, tick), is(equal_to(1u)));
+    EXPECT_TRUE(manager.changed_since<Foo>(entities[5], tick));
+    EXPECT_FALSE(manager.changed_since<Bar>(entities[5], tick));
+    EXPECT_THAT((count_changed<Foo, Bar>(manager, tick)), is(equal_to(2u)));
+
+    // Mutable view access marks everything iterated.
+    tick = manager.advance_tick();
+    for ([[maybe_unused]] auto tuple : manager.view<Foo, const Bar>()) {
+    }
+    EXPECT_THAT(count_changed<Foo>(manager, tick), is(equal_to(10u)));
+    EXPECT_THAT(count_changed<Bar>(manager, tick), is(equal_to(0u)));
+}
+
+TEST_CASE(Entity, ChangedSinceGroup) {
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Bar>();
+    manager.register_group<Foo, Bar>();
+    Vector<Entity> entities;
+    for (uint32_t i = 0; i < 10; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Foo>();
+        entity.add<Bar>();
+        entities.push(entity);
+    }
+
+    const auto tick = manager.advance_tick();
+    EXPECT_THAT((count_changed<Foo, Bar>(manager, tick)), is(equal_to(0u)));
+
+    // Change ticks should move along with the components when the group is reordered.
+    entities[2].get_mut<Foo>();
+    entities[0].remove<Bar>();
+    EXPECT_THAT((count_changed<Foo, Bar>(manager, tick)), is(equal_to(1u)));
+    for (auto [entity, foo, bar] : manager.view<const Foo, const Bar>().changed_since(tick)) {
+        EXPECT_THAT(entity, is(equal_to(entities[2])));
+    }
+}
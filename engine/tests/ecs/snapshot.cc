@@ -0,0 +1,262 @@
+#include <vull/ecs/snapshot.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/span_stream.hh>
+#include <vull/support/stream.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+class VectorStream final : public Stream {
+    Vector<uint8_t> m_bytes;
+
+public:
+    Result<void, StreamError> write(Span<const void> data) override {
+        const auto *bytes = static_cast<const uint8_t *>(data.data());
+        for (size_t i = 0; i < data.size(); i++) {
+            m_bytes.push(bytes[i]);
+        }
+        return {};
+    }
+
+    Span<const void> span() const { return {m_bytes.data(), m_bytes.size()}; }
+};
+
+struct Position {
+    VULL_DECLARE_COMPONENT(0);
+    uint32_t x;
+    uint32_t y;
+};
+
+struct Velocity {
+    VULL_DECLARE_COMPONENT(1);
+    uint32_t x;
+};
+
+// Not trivially copyable, so not captured by snapshots.
+struct Name {
+    VULL_DECLARE_COMPONENT(2);
+    Vector<char> chars;
+
+    static Name deserialise(Stream &) { VULL_ENSURE_NOT_REACHED(); }
+    static void serialise(Name &, Stream &) {}
+};
+
+void populate(EntityManager &manager, uint32_t count) {
+    manager.register_component<Position>();
+    manager.register_component<Velocity>();
+    manager.register_component<Name>();
+    for (uint32_t i = 0; i < count; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Position>(i, i * 2);
+        if (i % 3 == 0) {
+            entity.add<Velocity>(i);
+        }
+    }
+}
+
+// Flattens the world into (id, x, y, velocity or ~0) tuples.
+Vector<uint32_t> flatten(EntityManager &manager) {
+    Vector<uint32_t> state;
+    for (auto [entity, position] : manager.view<const Position>()) {
+        state.push(entity);
+        state.push(position.x);
+        state.push(position.y);
+        state.push(entity.has<Velocity>() ? entity.get<Velocity>().x : ~0u);
+    }
+    return state;
+}
+
+void expect_same(const Vector<uint32_t> &lhs, const Vector<uint32_t> &rhs) {
+    ASSERT_THAT(lhs.size(), is(equal_to(rhs.size())));
+    for (uint32_t i = 0; i < lhs.size(); i++) {
+        EXPECT_THAT(lhs[i], is(equal_to(rhs[i])));
+    }
+}
+
+void mutate(EntityManager &manager) {
+    manager.get_mut_component<Position>(10).x = 1234;
+    manager.remove_component<Velocity>(3);
+    manager.add_component<Velocity>(4, 99u);
+    manager.destroy_entity(20);
+    auto entity = manager.create_entity();
+    entity.add<Position>(7u, 7u);
+    entity.add<Name>();
+    manager.create_entity().add<Position>(8u, 8u);
+}
+
+} // namespace
+
+TEST_CASE(Snapshot, Restore) {
+    EntityManager manager;
+    populate(manager, 1000);
+    const auto original = flatten(manager);
+    const auto snapshot = manager.snapshot();
+
+    mutate(manager);
+    EXPECT_THAT(manager.get_component<Position>(10).x, is(equal_to(1234u)));
+    manager.restore(snapshot);
+    expect_same(flatten(manager), original);
+    EXPECT_TRUE(manager.valid(20));
+    EXPECT_THAT(manager.component_count<Name>(), is(equal_to(0u)));
+
+    // The entity created after the snapshot was taken shouldn't survive the restore.
+    EXPECT_THAT(EntityId(manager.create_entity()), is(equal_to(1000u)));
+}
+
+TEST_CASE(Snapshot, RestoreTwice) {
+    EntityManager manager;
+    populate(manager, 600);
+    const auto first = manager.snapshot();
+    const auto first_state = flatten(manager);
+    mutate(manager);
+    const auto second = manager.snapshot(&first);
+    const auto second_state = flatten(manager);
+
+    manager.restore(first);
+    expect_same(flatten(manager), first_state);
+    manager.restore(second);
+    expect_same(flatten(manager), second_state);
+    manager.restore(first);
+    expect_same(flatten(manager), first_state);
+}
+
+TEST_CASE(Snapshot, RestoreGroup) {
+    EntityManager manager;
+    populate(manager, 600);
+    manager.register_group<Position, Velocity>();
+    const auto snapshot = manager.snapshot();
+    const auto original = flatten(manager);
+    mutate(manager);
+    manager.restore(snapshot);
+    expect_same(flatten(manager), original);
+
+    uint32_t count = 0;
+    for (auto [entity, position, velocity] : manager.view<Position, Velocity>()) {
+        EXPECT_THAT(velocity.x, is(equal_to(position.x)));
+        count++;
+    }
+    EXPECT_THAT(count, is(equal_to(200u)));
+}
+
+TEST_CASE(Snapshot, RestoreLaterComponent) {
+    EntityManager manager;
+    manager.register_component<Position>();
+    for (uint32_t i = 0; i < 100; i++) {
+        manager.create_entity().add<Position>(i, i * 2);
+    }
+    const auto snapshot = manager.snapshot();
+
+    manager.register_component<Velocity>();
+    const auto original = flatten(manager);
+    manager.add_component<Velocity>(4, 99u);
+    manager.restore(snapshot);
+    expect_same(flatten(manager), original);
+    EXPECT_THAT(manager.component_count<Velocity>(), is(equal_to(0u)));
+}
+
+TEST_CASE(Snapshot, RestoreLaterGroup) {
+    EntityManager manager;
+    populate(manager, 600);
+    const auto snapshot = manager.snapshot();
+
+    manager.register_group<Position, Velocity>();
+    const auto original = flatten(manager);
+    mutate(manager);
+    manager.restore(snapshot);
+    expect_same(flatten(manager), original);
+
+    uint32_t count = 0;
+    for (auto [entity, position, velocity] : manager.view<Position, Velocity>()) {
+        EXPECT_THAT(velocity.x, is(equal_to(position.x)));
+        count++;
+    }
+    EXPECT_THAT(count, is(equal_to(200u)));
+}
+
+TEST_CASE(Snapshot, SharesUnchangedChunks) {
+    EntityManager manager;
+    populate(manager, 4096);
+    const auto first = manager.snapshot();
+    const auto full_size = first.unique_memory_usage();
+
+    // Nothing changed, so everything should be shared.
+    const auto second = manager.snapshot(&first);
+    EXPECT_THAT(second.unique_memory_usage(&first), is(equal_to(0u)));
+
+    // Only the one chunk holding the changed position should be copied.
+    manager.get_mut_component<Position>(1000).y = 5;
+    const auto third = manager.snapshot(&second);
+    const auto chunk_size = WorldSnapshot::k_chunk_size * (sizeof(EntityId) + sizeof(Position));
+    EXPECT_THAT(third.unique_memory_usage(&second), is(equal_to(chunk_size)));
+    EXPECT_TRUE(full_size > chunk_size * 16);
+}
+
+TEST_CASE(Snapshot, Diff) {
+    EntityManager manager;
+    populate(manager, 2000);
+    const auto first = manager.snapshot();
+    mutate(manager);
+    const auto second = manager.snapshot(&first);
+    const auto second_state = flatten(manager);
+
+    VectorStream stream;
+    EXPECT_FALSE(write_snapshot_diff(first, second, stream).is_error());
+    // Only the chunks touched by mutate should be written.
+    EXPECT_TRUE(stream.span().size() < second.unique_memory_usage() / 2);
+
+    SpanStream read_stream(stream.span());
+    auto result = read_snapshot_diff(first, read_stream);
+    ASSERT_FALSE(result.is_error());
+    auto reconstructed = result.disown_value();
+    EXPECT_THAT(reconstructed.tick(), is(equal_to(second.tick())));
+
+    manager.restore(first);
+    manager.restore(reconstructed);
+    expect_same(flatten(manager), second_state);
+}
+
+TEST_CASE(Snapshot, DiffUnchanged) {
+    EntityManager manager;
+    populate(manager, 2000);
+    const auto first = manager.snapshot();
+    const auto second = manager.snapshot(&first);
+
+    VectorStream stream;
+    EXPECT_FALSE(write_snapshot_diff(first, second, stream).is_error());
+    EXPECT_TRUE(stream.span().size() < 32);
+
+    SpanStream read_stream(stream.span());
+    auto result = read_snapshot_diff(first, read_stream);
+    ASSERT_FALSE(result.is_error());
+    EXPECT_THAT(result.value().unique_memory_usage(&first), is(equal_to(0u)));
+}
+
+TEST_CASE(Snapshot, DiffTruncated) {
+    EntityManager manager;
+    populate(manager, 100);
+    const auto first = manager.snapshot();
+    manager.get_mut_component<Position>(5).x = 0;
+    const auto second = manager.snapshot(&first);
+
+    VectorStream stream;
+    EXPECT_FALSE(write_snapshot_diff(first, second, stream).is_error());
+    SpanStream read_stream({stream.span().data(), stream.span().size() - 1});
+    auto result = read_snapshot_diff(first, read_stream);
+    ASSERT_TRUE(result.is_error());
+    EXPECT_TRUE(result.error().has<StreamError>());
+}
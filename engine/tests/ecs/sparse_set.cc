@@ -0,0 +1,100 @@
+#include <vull/ecs/sparse_set.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+TEST_CASE(SparseSet, HighIndex) {
+    SparseSet<uint32_t> set;
+    set.initialise<float>();
+    set.emplace<float>(1u << 30, 1.0f);
+    set.emplace<float>(5, 2.0f);
+    EXPECT_TRUE(set.contains(1u << 30));
+    EXPECT_TRUE(set.contains(5));
+    EXPECT_FALSE(set.contains(0));
+    EXPECT_FALSE(set.contains(6));
+    EXPECT_FALSE(set.contains((1u << 30) - 1));
+    EXPECT_FALSE(set.contains((1u << 30) + 1));
+    EXPECT_FALSE(set.contains(~0u - 1));
+    EXPECT_THAT(set.at<float>(1u << 30), is(equal_to(1.0f)));
+    EXPECT_THAT(set.at<float>(5), is(equal_to(2.0f)));
+    EXPECT_THAT(set.size(), is(equal_to(2u)));
+}
+
+TEST_CASE(SparseSet, Remove) {
+    SparseSet<uint32_t> set;
+    set.initialise<uint32_t>();
+    for (uint32_t i = 0; i < 4096; i++) {
+        set.emplace<uint32_t>(i * 3, i);
+    }
+
+    // Remove every other element, which moves the last element into the hole each time.
+    for (uint32_t i = 0; i < 4096; i += 2) {
+        set.remove(i * 3);
+    }
+    EXPECT_THAT(set.size(), is(equal_to(2048u)));
+    for (uint32_t i = 0; i < 4096; i++) {
+        EXPECT_THAT(set.contains(i * 3), is(equal_to(i % 2 == 1)));
+        if (i % 2 == 1) {
+            EXPECT_THAT(set.at<uint32_t>(i * 3), is(equal_to(i)));
+        }
+    }
+}
+
+TEST_CASE(SparseSet, EmptyPageReused) {
+    // Emptying a page should free it, and adding to its range again should work as normal.
+    SparseSet<uint32_t> set;
+    set.initialise<uint32_t>();
+    set.emplace<uint32_t>(100000, 1u);
+    set.emplace<uint32_t>(100001, 2u);
+    set.remove(100000);
+    set.remove(100001);
+    EXPECT_TRUE(set.empty());
+    EXPECT_FALSE(set.contains(100000));
+    EXPECT_FALSE(set.contains(100001));
+
+    set.emplace<uint32_t>(100001, 3u);
+    EXPECT_FALSE(set.contains(100000));
+    EXPECT_TRUE(set.contains(100001));
+    EXPECT_THAT(set.at<uint32_t>(100001), is(equal_to(3u)));
+}
+
+TEST_CASE(SparseSet, ShrinkStorage) {
+    SparseSet<uint32_t> set;
+    set.initialise<uint32_t>();
+    for (uint32_t i = 0; i < 1024; i++) {
+        set.emplace<uint32_t>(i, i);
+    }
+    const auto full_usage = set.memory_usage();
+    for (uint32_t i = 0; i < 1000; i++) {
+        set.remove(i);
+    }
+    EXPECT_TRUE(set.memory_usage() < full_usage);
+    for (uint32_t i = 1000; i < 1024; i++) {
+        EXPECT_THAT(set.at<uint32_t>(i), is(equal_to(i)));
+    }
+}
+
+TEST_CASE(SparseSet, Remap) {
+    SparseSet<uint32_t> set;
+    set.initialise<uint32_t>();
+    set.emplace<uint32_t>(5000, 1u);
+    set.emplace<uint32_t>(3, 2u);
+    Vector<uint32_t> mapping;
+    mapping.ensure_size(5001, ~0u);
+    mapping[5000] = 0;
+    mapping[3] = 1;
+    set.remap(mapping.span());
+    set.shrink_to_fit();
+    EXPECT_FALSE(set.contains(5000));
+    EXPECT_FALSE(set.contains(3));
+    EXPECT_THAT(set.at<uint32_t>(0), is(equal_to(1u)));
+    EXPECT_THAT(set.at<uint32_t>(1), is(equal_to(2u)));
+    EXPECT_THAT(*set.dense_begin(), is(equal_to(0u)));
+}
@@ -0,0 +1,137 @@
+#include <vull/ecs/system_graph.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/scoped_lock.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/tasklet/mutex.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/tasklet/tasklet.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+struct Foo {
+    VULL_DECLARE_COMPONENT(0);
+    uint32_t value;
+};
+
+struct Bar {
+    VULL_DECLARE_COMPONENT(1);
+    uint32_t value;
+};
+
+void run_graph(SystemGraph &graph, uint32_t run_count = 1) {
+    Scheduler scheduler(4);
+    scheduler.start([&] {
+        for (uint32_t i = 0; i < run_count; i++) {
+            graph.run();
+        }
+        scheduler.stop();
+    });
+}
+
+uint32_t index_of(const Vector<StringView> &order, StringView name) {
+    for (uint32_t i = 0; i < order.size(); i++) {
+        if (order[i] == name) {
+            return i;
+        }
+    }
+    return order.size();
+}
+
+} // namespace
+
+TEST_CASE(SystemGraph, ConflictOrder) {
+    // Conflicting systems should run in the order they were added, regardless of the run.
+    SystemGraph graph;
+    Mutex mutex;
+    Vector<StringView> order;
+    auto record = [&](StringView name) {
+        return [&, name] {
+            ScopedLock lock(mutex);
+            order.push(name);
+        };
+    };
+    graph.add_system("write-foo", record("write-foo")).writes<Foo>();
+    graph.add_system("read-foo", record("read-foo")).reads<Foo>();
+    graph.add_system("read-foo-2", record("read-foo-2")).reads<Foo>();
+    graph.add_system("write-bar", record("write-bar")).writes<Bar>().reads<Foo>();
+    graph.add_system("write-foo-bar", record("write-foo-bar")).writes<Foo, Bar>();
+    auto &last = graph.add_system("last", record("last"));
+    last.after(*graph.systems()[4]);
+
+    for (uint32_t i = 0; i < 20; i++) {
+        order.clear();
+        run_graph(graph);
+        ASSERT_THAT(order.size(), is(equal_to(6u)));
+        EXPECT_THAT(order[0], is(equal_to(StringView("write-foo"))));
+        EXPECT_TRUE(index_of(order, "read-foo") < index_of(order, "write-foo-bar"));
+        EXPECT_TRUE(index_of(order, "read-foo-2") < index_of(order, "write-foo-bar"));
+        EXPECT_TRUE(index_of(order, "write-bar") < index_of(order, "write-foo-bar"));
+        EXPECT_THAT(order[4], is(equal_to(StringView("write-foo-bar"))));
+        EXPECT_THAT(order[5], is(equal_to(StringView("last"))));
+    }
+}
+
+TEST_CASE(SystemGraph, Concurrent) {
+    // Systems which only read the same component should be able to run at the same time.
+    SystemGraph graph;
+    Atomic<uint32_t> running;
+    Atomic<uint32_t> max_running;
+    for (uint32_t i = 0; i < 4; i++) {
+        graph
+            .add_system("read-foo",
+                        [&] {
+                            const auto count = running.fetch_add(1) + 1;
+                            if (count > max_running.load()) {
+                                max_running.store(count);
+                            }
+                            Timer timer;
+                            while (max_running.load() < 2 && timer.elapsed() < 2.0f) {
+                                vull::preemption_point();
+                            }
+                            running.fetch_sub(1);
+                        })
+            .reads<Foo>();
+    }
+    run_graph(graph);
+    EXPECT_TRUE(max_running.load() >= 2);
+}
+
+TEST_CASE(SystemGraph, ViewSystem) {
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Bar>();
+    for (uint32_t i = 0; i < 1000; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Foo>(i);
+        entity.add<Bar>(0u);
+    }
+
+    SystemGraph graph;
+    graph.add_view_system<Foo>("double-foo", manager, 64, [](Entity, Foo &foo) {
+        foo.value *= 2;
+    });
+    graph.add_view_system<Foo, Bar>("copy-foo", manager, 64, [](Entity, Foo &foo, Bar &bar) {
+        bar.value = foo.value;
+    });
+    run_graph(graph, 2);
+    for (auto [entity, foo, bar] : manager.view<Foo, Bar>()) {
+        EXPECT_THAT(bar.value, is(equal_to(EntityId(entity) * 4)));
+    }
+    for (const auto &system : graph.systems()) {
+        EXPECT_TRUE(system->time() >= 0.0f);
+    }
+}
@@ -0,0 +1,170 @@
+#include <vull/ecs/world.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/span_stream.hh>
+#include <vull/support/stream.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+class VectorStream final : public Stream {
+    Vector<uint8_t> m_bytes;
+
+public:
+    Result<void, StreamError> write(Span<const void> data) override {
+        const auto *bytes = static_cast<const uint8_t *>(data.data());
+        for (size_t i = 0; i < data.size(); i++) {
+            m_bytes.push(bytes[i]);
+        }
+        return {};
+    }
+
+    Span<const void> span() const { return {m_bytes.data(), m_bytes.size()}; }
+};
+
+struct Position {
+    VULL_DECLARE_COMPONENT(0);
+    float x;
+    float y;
+};
+
+// Has custom serialisation, so takes the per-object path.
+struct Health {
+    VULL_DECLARE_COMPONENT(1);
+    uint32_t value;
+
+    static Health deserialise(Stream &stream) { return {VULL_EXPECT(stream.read_varint<uint32_t>())}; }
+    static void serialise(Health &health, Stream &stream) { VULL_EXPECT(stream.write_varint(health.value)); }
+};
+
+void register_components(World &world) {
+    world.register_component<Position>();
+    world.register_component<Health>();
+}
+
+} // namespace
+
+TEST_CASE(World, RoundTrip) {
+    VectorStream stream;
+    {
+        World world;
+        register_components(world);
+        for (uint32_t i = 0; i < 100; i++) {
+            auto entity = world.create_entity();
+            entity.add<Position>(static_cast<float>(i), static_cast<float>(i * 2));
+            if (i % 3 == 0) {
+                entity.add<Health>(i);
+            }
+        }
+        EXPECT_FALSE(world.serialise(stream).is_error());
+    }
+
+    World world;
+    register_components(world);
+    SpanStream read_stream(stream.span());
+    EXPECT_FALSE(world.deserialise(read_stream).is_error());
+    EXPECT_THAT(world.component_count<Position>(), is(equal_to(100u)));
+    EXPECT_THAT(world.component_count<Health>(), is(equal_to(34u)));
+    for (EntityId id = 0; id < 100; id++) {
+        EXPECT_THAT(world.get_component<Position>(id).x, is(equal_to(static_cast<float>(id))));
+        EXPECT_THAT(world.get_component<Position>(id).y, is(equal_to(static_cast<float>(id * 2))));
+        EXPECT_THAT(world.has_component<Health>(id), is(equal_to(id % 3 == 0)));
+        if (id % 3 == 0) {
+            EXPECT_THAT(world.get_component<Health>(id).value, is(equal_to(id)));
+        }
+    }
+}
+
+TEST_CASE(World, LoadVersion1) {
+    // A version 1 world with two entities, both with a Position and only the second with a Health.
+    VectorStream stream;
+    EXPECT_FALSE(stream.write_varint(2u).is_error());
+    EXPECT_FALSE(stream.write_varint(2u).is_error());
+    EXPECT_FALSE(stream.write_varint(2u).is_error());
+    const Position positions[2]{{1.0f, 2.0f}, {3.0f, 4.0f}};
+    EXPECT_FALSE(stream.write({positions, sizeof(positions)}).is_error());
+    EXPECT_FALSE(stream.write_varint(1u).is_error());
+    EXPECT_FALSE(stream.write_varint(0u).is_error());
+    EXPECT_FALSE(stream.write_varint(1u).is_error());
+    EXPECT_FALSE(stream.write_varint(500u).is_error());
+    EXPECT_FALSE(stream.write_varint(1u).is_error());
+
+    World world;
+    register_components(world);
+    SpanStream read_stream(stream.span());
+    EXPECT_FALSE(world.deserialise(read_stream).is_error());
+    EXPECT_THAT(world.get_component<Position>(0).y, is(equal_to(4.0f)));
+    EXPECT_THAT(world.get_component<Position>(1).x, is(equal_to(1.0f)));
+    EXPECT_FALSE(world.has_component<Health>(0));
+    EXPECT_THAT(world.get_component<Health>(1).value, is(equal_to(500u)));
+}
+
+TEST_CASE(World, UnsupportedVersion) {
+    VectorStream stream;
+    EXPECT_FALSE(stream.write_varint(World::k_version_marker).is_error());
+    EXPECT_FALSE(stream.write_varint(World::k_version + 1).is_error());
+
+    World world;
+    register_components(world);
+    SpanStream read_stream(stream.span());
+    auto result = world.deserialise(read_stream);
+    ASSERT_TRUE(result.is_error());
+    EXPECT_TRUE(result.error().has<WorldError>());
+}
+
+TEST_CASE(World, Truncated) {
+    VectorStream stream;
+    {
+        World world;
+        register_components(world);
+        world.create_entity().add<Position>(1.0f, 2.0f);
+        EXPECT_FALSE(world.serialise(stream).is_error());
+    }
+
+    World world;
+    register_components(world);
+    const auto span = stream.span();
+    SpanStream read_stream({span.data(), span.size() - 1});
+    EXPECT_TRUE(world.deserialise(read_stream).is_error());
+}
+
+TEST_CASE(World, RoundTripFreeEntities) {
+    VectorStream stream;
+    EntityId recycled;
+    {
+        World world;
+        register_components(world);
+        for (uint32_t i = 0; i < 4; i++) {
+            world.create_entity().add<Position>(static_cast<float>(i), 0.0f);
+        }
+        world.destroy_entity(1);
+        world.destroy_entity(2);
+        recycled = world.create_entity();
+        EXPECT_FALSE(world.serialise(stream).is_error());
+    }
+
+    // Destroyed entities should stay destroyed, and recycled entities should keep their version.
+    World world;
+    register_components(world);
+    SpanStream read_stream(stream.span());
+    EXPECT_FALSE(world.deserialise(read_stream).is_error());
+    EXPECT_TRUE(world.valid(0));
+    EXPECT_TRUE(world.valid(recycled));
+    EXPECT_FALSE(world.valid(1));
+    EXPECT_FALSE(world.valid(2));
+    EXPECT_TRUE(world.valid(3));
+    EXPECT_THAT(world.component_count<Position>(), is(equal_to(2u)));
+    EXPECT_THAT(entity_index(world.create_entity()), is(equal_to(2u)));
+}
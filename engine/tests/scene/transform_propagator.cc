@@ -0,0 +1,144 @@
+#include <vull/scene/transform_propagator.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/command_buffer.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/epsilon.hh>
+#include <vull/maths/mat.hh>
+#include <vull/maths/quat.hh>
+#include <vull/maths/vec.hh>
+#include <vull/scene/transform.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+constexpr auto k_root = ~EntityId(0);
+
+Mat4f recursive_matrix(EntityManager &manager, EntityId entity) {
+    const auto &transform = manager.get_component<Transform>(entity);
+    if (transform.parent() == k_root) {
+        return transform.matrix();
+    }
+    return recursive_matrix(manager, transform.parent()) * transform.matrix();
+}
+
+void expect_matrices(EntityManager &manager) {
+    for (auto [entity, transform, world_transform] : manager.view<const Transform, const WorldTransform>()) {
+        const auto expected = recursive_matrix(manager, entity);
+        for (uint32_t i = 0; i < 4; i++) {
+            EXPECT_TRUE(vull::fuzzy_equal(world_transform.matrix()[i], expected[i]));
+        }
+    }
+}
+
+uint32_t changed_count(EntityManager &manager, uint32_t tick) {
+    uint32_t count = 0;
+    for ([[maybe_unused]] auto tuple : manager.view<const WorldTransform>().changed_since(tick)) {
+        count++;
+    }
+    return count;
+}
+
+// Runs the propagator as a frame would, applying its commands and advancing the tick afterwards. Returns the number of
+// world transforms which were changed.
+uint32_t run_frame(TransformPropagator &propagator, EntityManager &manager) {
+    const auto tick = manager.tick();
+    EcsCommandBuffer commands;
+    propagator.update(manager, commands);
+    commands.apply(manager);
+    manager.advance_tick();
+    return changed_count(manager, tick - 1);
+}
+
+} // namespace
+
+TEST_CASE(TransformPropagator, Hierarchy) {
+    EntityManager manager;
+    manager.register_component<Transform>();
+    manager.register_component<WorldTransform>();
+
+    // A deep chain, with each link also having a leaf child. Children are created before their parents so that the
+    // entity order doesn't match the hierarchy order.
+    constexpr uint32_t depth = 64;
+    Vector<Entity> chain;
+    for (uint32_t i = 0; i < depth; i++) {
+        chain.push(manager.create_entity());
+    }
+    for (uint32_t i = 0; i < depth; i++) {
+        const auto parent = i + 1 < depth ? EntityId(chain[i + 1]) : k_root;
+        chain[i].add<Transform>(parent, Vec3f(1.0f, 0.0f, 0.0f), vull::angle_axis(0.1f, Vec3f(0.0f, 1.0f, 0.0f)),
+                                Vec3f(1.01f));
+        auto leaf = manager.create_entity();
+        leaf.add<Transform>(chain[i], Vec3f(0.0f, 2.0f, 0.0f));
+    }
+
+    TransformPropagator propagator;
+    EXPECT_THAT(run_frame(propagator, manager), is(equal_to(depth * 2)));
+    EXPECT_THAT(manager.component_count<WorldTransform>(), is(equal_to(depth * 2)));
+    expect_matrices(manager);
+
+    // Changes are looked at again by the next update, after which nothing should be recomputed.
+    EXPECT_THAT(run_frame(propagator, manager), is(equal_to(depth * 2)));
+    EXPECT_THAT(run_frame(propagator, manager), is(equal_to(0u)));
+
+    // Moving a node should only update its subtree, which is every node below it in the chain, its leaf and those of
+    // the nodes below it.
+    chain[9].get_mut<Transform>().set_position(Vec3f(5.0f));
+    EXPECT_THAT(run_frame(propagator, manager), is(equal_to(20u)));
+    expect_matrices(manager);
+    EXPECT_THAT(run_frame(propagator, manager), is(equal_to(20u)));
+    EXPECT_THAT(run_frame(propagator, manager), is(equal_to(0u)));
+
+    // Reparenting to the root.
+    chain[20].remove<Transform>();
+    chain[20].add<Transform>(k_root, Vec3f(0.0f, 0.0f, 3.0f));
+    run_frame(propagator, manager);
+    expect_matrices(manager);
+
+    // Destroying a node should make its children roots.
+    manager.destroy_entity(chain[40]);
+    for (auto [entity, transform] : manager.view<Transform>()) {
+        if (transform.parent() == chain[40]) {
+            transform = Transform(k_root, transform.position(), transform.rotation(), transform.scale());
+        }
+    }
+    run_frame(propagator, manager);
+    expect_matrices(manager);
+}
+
+TEST_CASE(TransformPropagator, RecycledEntity) {
+    EntityManager manager;
+    manager.register_component<Transform>();
+    manager.register_component<WorldTransform>();
+
+    auto parent = manager.create_entity();
+    parent.add<Transform>(k_root, Vec3f(1.0f, 0.0f, 0.0f));
+    auto child = manager.create_entity();
+    child.add<Transform>(parent, Vec3f(0.0f, 2.0f, 0.0f));
+
+    TransformPropagator propagator;
+    run_frame(propagator, manager);
+    expect_matrices(manager);
+
+    // Recreating the child reuses its index with a new version.
+    manager.destroy_entity(child);
+    auto recycled = manager.create_entity();
+    EXPECT_THAT(entity_index(recycled), is(equal_to(entity_index(child))));
+    EXPECT_THAT(entity_version(recycled), is(equal_to(1u)));
+    recycled.add<Transform>(parent, Vec3f(0.0f, 3.0f, 0.0f));
+    run_frame(propagator, manager);
+    expect_matrices(manager);
+
+    recycled.get_mut<Transform>().set_position(Vec3f(4.0f));
+    run_frame(propagator, manager);
+    EXPECT_TRUE(manager.has_component<WorldTransform>(recycled));
+    expect_matrices(manager);
+}
@@ -0,0 +1,86 @@
+#include <vull/tasklet/condition_variable.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/support/scoped_lock.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/mutex.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/tasklet/tasklet.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+TEST_CASE(ConditionVariable, ProducerConsumer) {
+    constexpr uint32_t k_item_count = 1000;
+    Vector<uint32_t> consumed;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            Mutex mutex;
+            ConditionVariable not_empty;
+            Vector<uint32_t> queue;
+            Latch latch(1);
+            vull::schedule([&] {
+                for (uint32_t i = 0; i < k_item_count; i++) {
+                    ScopedLock lock(mutex);
+                    not_empty.wait(mutex, [&] {
+                        return !queue.empty();
+                    });
+                    consumed.push(queue.take_last());
+                }
+                latch.count_down();
+            });
+            for (uint32_t i = 0; i < k_item_count; i++) {
+                {
+                    ScopedLock lock(mutex);
+                    queue.push(i);
+                }
+                not_empty.notify_one();
+                if (i % 8 == 0) {
+                    vull::pump_work();
+                }
+            }
+            latch.wait();
+            scheduler.stop();
+        });
+    }
+    ASSERT_THAT(consumed.size(), is(equal_to(k_item_count)));
+}
+
+TEST_CASE(ConditionVariable, NotifyAll) {
+    constexpr uint32_t k_waiter_count = 16;
+    uint32_t woken_count = 0;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            Mutex mutex;
+            ConditionVariable cv;
+            bool ready = false;
+            Latch latch(k_waiter_count);
+            for (uint32_t i = 0; i < k_waiter_count; i++) {
+                vull::schedule([&] {
+                    ScopedLock lock(mutex);
+                    cv.wait(mutex, [&] {
+                        return ready;
+                    });
+                    woken_count++;
+                    lock.unlock();
+                    latch.count_down();
+                });
+            }
+            {
+                ScopedLock lock(mutex);
+                ready = true;
+            }
+            cv.notify_all();
+            latch.wait();
+            scheduler.stop();
+        });
+    }
+    EXPECT_THAT(woken_count, is(equal_to(k_waiter_count)));
+}
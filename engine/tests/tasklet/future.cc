@@ -0,0 +1,155 @@
+#include <vull/tasklet/future.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/result.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+enum class TestError {
+    Bad,
+};
+
+template <typename F>
+void run_on_scheduler(F &&fn, uint32_t thread_count = 2) {
+    Scheduler scheduler(thread_count);
+    scheduler.start([&] {
+        fn();
+        scheduler.stop();
+    });
+}
+
+} // namespace
+
+TEST_CASE(Future, Value) {
+    run_on_scheduler([] {
+        auto future = vull::schedule_future([]() -> Result<uint32_t, TestError> {
+            return 5u;
+        });
+        EXPECT_THAT(future.await(), is(success(equal_to(5u))));
+        EXPECT_TRUE(future.is_ready());
+    });
+}
+
+TEST_CASE(Future, Error) {
+    run_on_scheduler([] {
+        auto future = vull::schedule_future([]() -> Result<uint32_t, TestError> {
+            return TestError::Bad;
+        });
+        auto result = future.await();
+        ASSERT_TRUE(result.is_error());
+        EXPECT_THAT(result.error(), is(equal_to(TestError::Bad)));
+    });
+}
+
+TEST_CASE(Future, PlainValue) {
+    run_on_scheduler([] {
+        auto future = vull::schedule_future([] {
+            return 10;
+        });
+        EXPECT_THAT(future.await().value(), is(equal_to(10)));
+    });
+}
+
+TEST_CASE(Future, Promise) {
+    run_on_scheduler([] {
+        Promise<uint32_t> promise;
+        auto future = promise.future();
+        EXPECT_FALSE(future.is_ready());
+        promise.fulfil(20u);
+        EXPECT_TRUE(future.is_ready());
+        EXPECT_THAT(future.await().value(), is(equal_to(20u)));
+    });
+}
+
+TEST_CASE(Future, WhenAll) {
+    run_on_scheduler([] {
+        Atomic<uint32_t> sum;
+        Vector<Future<uint32_t, TestError>> futures;
+        for (uint32_t i = 0; i < 100; i++) {
+            futures.push(vull::schedule_future([&sum, i]() -> Result<uint32_t, TestError> {
+                sum.fetch_add(i);
+                return i;
+            }));
+        }
+        auto result = vull::when_all(futures.span()).await();
+        EXPECT_FALSE(result.is_error());
+        EXPECT_THAT(sum.load(), is(equal_to(4950u)));
+        for (uint32_t i = 0; i < futures.size(); i++) {
+            EXPECT_THAT(futures[i].await(), is(success(equal_to(i))));
+        }
+    });
+}
+
+TEST_CASE(Future, WhenAllEmpty) {
+    run_on_scheduler([] {
+        Vector<Future<void>> futures;
+        auto result = vull::when_all(futures.span()).await();
+        EXPECT_FALSE(result.is_error());
+    });
+}
+
+TEST_CASE(Future, WhenAllError) {
+    run_on_scheduler([] {
+        Promise<void, TestError> failing;
+        Promise<void, TestError> pending;
+        Vector<Future<void, TestError>> futures;
+        futures.push(pending.future());
+        futures.push(failing.future());
+
+        auto all = vull::when_all(futures.span());
+        failing.fulfil(TestError::Bad);
+
+        // The first error is propagated without waiting on the other future, which gets cancelled.
+        auto result = all.await();
+        ASSERT_TRUE(result.is_error());
+        EXPECT_THAT(result.error(), is(equal_to(TestError::Bad)));
+        EXPECT_TRUE(pending.is_cancelled());
+        pending.abandon();
+    });
+}
+
+TEST_CASE(Future, WhenAny) {
+    run_on_scheduler([] {
+        Vector<Promise<uint32_t>> promises(3);
+        Vector<Future<uint32_t>> futures;
+        for (auto &promise : promises) {
+            futures.push(promise.future());
+        }
+
+        auto any = vull::when_any(futures.span());
+        promises[1].fulfil(7u);
+        EXPECT_THAT(any.await().value(), is(equal_to(1u)));
+        EXPECT_THAT(futures[1].await().value(), is(equal_to(7u)));
+        EXPECT_TRUE(futures[0].is_cancelled());
+        EXPECT_TRUE(futures[2].is_cancelled());
+        promises[0].abandon();
+        promises[2].abandon();
+    });
+}
+
+TEST_CASE(Future, CancelBeforeRun) {
+    // With a single thread, the scheduled tasklet can't start until we wait on it.
+    run_on_scheduler(
+        [] {
+            Atomic<bool> ran;
+            auto future = vull::schedule_future([&ran] {
+                ran.store(true);
+            });
+            future.cancel();
+            future.wait();
+            EXPECT_TRUE(future.is_ready());
+            EXPECT_FALSE(ran.load());
+        },
+        1);
+}
@@ -0,0 +1,109 @@
+#include <vull/tasklet/parallel.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/support/atomic.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+TEST_CASE(Parallel, ForVisitsOnce) {
+    constexpr uint32_t k_count = 100000;
+    Vector<Atomic<uint32_t>> visits(k_count);
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            vull::parallel_for(0, k_count, 64, [&](uint32_t index) {
+                visits[index].fetch_add(1);
+            });
+            scheduler.stop();
+        });
+    }
+    uint32_t bad_count = 0;
+    for (const auto &visit : visits) {
+        bad_count += visit.load() != 1 ? 1 : 0;
+    }
+    EXPECT_THAT(bad_count, is(equal_to(0u)));
+}
+
+TEST_CASE(Parallel, ForEmptyRange) {
+    uint32_t call_count = 0;
+    {
+        Scheduler scheduler(1);
+        scheduler.start([&] {
+            vull::parallel_for(10, 10, 1, [&](uint32_t) {
+                call_count++;
+            });
+            scheduler.stop();
+        });
+    }
+    EXPECT_THAT(call_count, is(equal_to(0u)));
+}
+
+TEST_CASE(Parallel, ForOutsideScheduler) {
+    // Should fall back to a plain loop.
+    uint32_t sum = 0;
+    vull::parallel_for(0, 100, 8, [&](uint32_t index) {
+        sum += index;
+    });
+    EXPECT_THAT(sum, is(equal_to(4950u)));
+}
+
+TEST_CASE(Parallel, ReduceInOrder) {
+    // Partial results should always be combined in index order, regardless of how the range was split.
+    constexpr uint32_t k_count = 20000;
+    Vector<uint32_t> indices;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            indices = vull::parallel_reduce<Vector<uint32_t>>(
+                0, k_count, 16,
+                [](Vector<uint32_t> &accumulator, uint32_t index) {
+                    accumulator.push(index);
+                },
+                [](Vector<uint32_t> &accumulator, Vector<uint32_t> &&other) {
+                    accumulator.extend(other);
+                });
+            scheduler.stop();
+        });
+    }
+    ASSERT_THAT(indices.size(), is(equal_to(k_count)));
+    uint32_t out_of_order_count = 0;
+    for (uint32_t i = 0; i < k_count; i++) {
+        out_of_order_count += indices[i] != i ? 1 : 0;
+    }
+    EXPECT_THAT(out_of_order_count, is(equal_to(0u)));
+}
+
+TEST_CASE(Parallel, Nested) {
+    constexpr uint32_t k_outer_count = 64;
+    constexpr uint32_t k_inner_count = 1000;
+    uint64_t sum = 0;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            sum = vull::parallel_reduce<uint64_t>(
+                0, k_outer_count, 1,
+                [](uint64_t &outer_sum, uint32_t) {
+                    outer_sum += vull::parallel_reduce<uint64_t>(
+                        0, k_inner_count, 8,
+                        [](uint64_t &inner_sum, uint32_t index) {
+                            inner_sum += index;
+                        },
+                        [](uint64_t &inner_sum, uint64_t &&other) {
+                            inner_sum += other;
+                        });
+                },
+                [](uint64_t &outer_sum, uint64_t &&other) {
+                    outer_sum += other;
+                });
+            scheduler.stop();
+        });
+    }
+    EXPECT_THAT(sum, is(equal_to(uint64_t(k_outer_count) * (k_inner_count * (k_inner_count - 1) / 2))));
+}
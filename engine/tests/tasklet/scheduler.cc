@@ -0,0 +1,83 @@
+#include <vull/tasklet/scheduler.hh>
+
+#include <vull/container/array.hh>
+#include <vull/container/vector.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/tasklet.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+TEST_CASE(Scheduler, PriorityOrder) {
+    // With a single worker, queued work should be picked strictly by priority once the root tasklet waits.
+    Vector<TaskletPriority> order;
+    {
+        Scheduler scheduler(1);
+        scheduler.start([&] {
+            Latch latch(3);
+            for (auto priority : Array{TaskletPriority::Background, TaskletPriority::Normal, TaskletPriority::Critical}) {
+                vull::schedule(
+                    [&, priority] {
+                        order.push(priority);
+                        latch.count_down();
+                    },
+                    priority);
+            }
+            latch.wait();
+            scheduler.stop();
+        });
+    }
+    ASSERT_THAT(order.size(), is(equal_to(3u)));
+    EXPECT_THAT(order[0], is(equal_to(TaskletPriority::Critical)));
+    EXPECT_THAT(order[1], is(equal_to(TaskletPriority::Normal)));
+    EXPECT_THAT(order[2], is(equal_to(TaskletPriority::Background)));
+}
+
+static bool run_preemption(TaskletPriority priority, bool past_deadline) {
+    // Schedule critical work from a lower priority tasklet on a single worker, then hit a preemption point.
+    bool critical_ran_first = false;
+    {
+        Scheduler scheduler(1);
+        scheduler.start([&] {
+            if (past_deadline) {
+                scheduler.set_frame_deadline(0.0f);
+            }
+            Latch latch(2);
+            bool critical_ran = false;
+            vull::schedule(
+                [&] {
+                    vull::schedule(
+                        [&] {
+                            critical_ran = true;
+                            latch.count_down();
+                        },
+                        TaskletPriority::Critical);
+                    vull::preemption_point();
+                    critical_ran_first = critical_ran;
+                    latch.count_down();
+                },
+                priority);
+            latch.wait();
+            scheduler.stop();
+        });
+    }
+    return critical_ran_first;
+}
+
+TEST_CASE(Scheduler, BackgroundPreempted) {
+    EXPECT_TRUE(run_preemption(TaskletPriority::Background, false));
+}
+
+TEST_CASE(Scheduler, NormalPreemptedPastDeadline) {
+    EXPECT_FALSE(run_preemption(TaskletPriority::Normal, false));
+    EXPECT_TRUE(run_preemption(TaskletPriority::Normal, true));
+}
+
+TEST_CASE(Scheduler, CriticalNotPreempted) {
+    EXPECT_FALSE(run_preemption(TaskletPriority::Critical, true));
+}
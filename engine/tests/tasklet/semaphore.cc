@@ -0,0 +1,79 @@
+#include <vull/tasklet/semaphore.hh>
+
+#include <vull/support/atomic.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/tasklet/tasklet.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+TEST_CASE(Semaphore, TryAcquire) {
+    Semaphore semaphore(2);
+    EXPECT_TRUE(semaphore.try_acquire());
+    EXPECT_TRUE(semaphore.try_acquire());
+    EXPECT_FALSE(semaphore.try_acquire());
+    semaphore.release(2);
+    EXPECT_THAT(semaphore.count(), is(equal_to(2u)));
+}
+
+TEST_CASE(Semaphore, Limit) {
+    // No more than the initial count of tasklets should ever be inside at once.
+    constexpr uint32_t k_limit = 3;
+    constexpr uint32_t k_tasklet_count = 64;
+    Atomic<uint32_t> inside_count;
+    Atomic<uint32_t> max_inside_count;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            Semaphore semaphore(k_limit);
+            Latch latch(k_tasklet_count);
+            for (uint32_t i = 0; i < k_tasklet_count; i++) {
+                vull::schedule([&] {
+                    semaphore.acquire();
+                    const auto count = inside_count.fetch_add(1) + 1;
+                    auto max_count = max_inside_count.load();
+                    while (count > max_count && !max_inside_count.compare_exchange(max_count, count)) {
+                    }
+                    vull::pump_work();
+                    inside_count.fetch_sub(1);
+                    semaphore.release();
+                    latch.count_down();
+                });
+            }
+            latch.wait();
+            EXPECT_THAT(semaphore.count(), is(equal_to(k_limit)));
+            scheduler.stop();
+        });
+    }
+    EXPECT_TRUE(max_inside_count.load() <= k_limit);
+}
+
+TEST_CASE(Semaphore, ReleaseMany) {
+    // A single release of many should wake that many waiters.
+    constexpr uint32_t k_waiter_count = 8;
+    Atomic<uint32_t> acquired_count;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            Semaphore semaphore(0);
+            Latch latch(k_waiter_count);
+            for (uint32_t i = 0; i < k_waiter_count; i++) {
+                vull::schedule([&] {
+                    semaphore.acquire();
+                    acquired_count.fetch_add(1);
+                    latch.count_down();
+                });
+            }
+            semaphore.release(k_waiter_count);
+            latch.wait();
+            scheduler.stop();
+        });
+    }
+    EXPECT_THAT(acquired_count.load(), is(equal_to(k_waiter_count)));
+}
@@ -0,0 +1,103 @@
+#include <vull/tasklet/shared_mutex.hh>
+
+#include <vull/support/atomic.hh>
+#include <vull/support/scoped_lock.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/tasklet/tasklet.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+TEST_CASE(SharedMutex, TryLock) {
+    SharedMutex mutex;
+    EXPECT_TRUE(mutex.try_lock_shared());
+    EXPECT_TRUE(mutex.try_lock_shared());
+    EXPECT_FALSE(mutex.try_lock());
+    mutex.unlock_shared();
+    mutex.unlock_shared();
+    EXPECT_TRUE(mutex.try_lock());
+    EXPECT_FALSE(mutex.try_lock_shared());
+    EXPECT_FALSE(mutex.try_lock());
+    mutex.unlock();
+    EXPECT_TRUE(mutex.try_lock_shared());
+    mutex.unlock_shared();
+}
+
+TEST_CASE(SharedMutex, ConcurrentReaders) {
+    // Every reader holds the lock until all readers have it, which would deadlock if readers excluded each other.
+    constexpr uint32_t k_reader_count = 16;
+    Atomic<uint32_t> done_count;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            SharedMutex mutex;
+            Latch all_locked(k_reader_count);
+            Latch done(k_reader_count);
+            for (uint32_t i = 0; i < k_reader_count; i++) {
+                vull::schedule([&] {
+                    SharedScopedLock lock(mutex);
+                    all_locked.count_down();
+                    all_locked.wait();
+                    done_count.fetch_add(1);
+                    lock.unlock();
+                    done.count_down();
+                });
+            }
+            done.wait();
+            scheduler.stop();
+        });
+    }
+    EXPECT_THAT(done_count.load(), is(equal_to(k_reader_count)));
+}
+
+TEST_CASE(SharedMutex, Contended) {
+    // Writers check that no reader is inside, readers check that no writer is inside.
+    constexpr uint32_t k_tasklet_count = 64;
+    constexpr uint32_t k_iteration_count = 200;
+    uint32_t counter = 0;
+    Atomic<uint32_t> reader_count;
+    Atomic<bool> writer_inside;
+    Atomic<uint32_t> violation_count;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            SharedMutex mutex;
+            Latch latch(k_tasklet_count);
+            for (uint32_t i = 0; i < k_tasklet_count; i++) {
+                vull::schedule([&, writer = i % 4 == 0] {
+                    for (uint32_t j = 0; j < k_iteration_count; j++) {
+                        if (writer) {
+                            ScopedLock lock(mutex);
+                            if (writer_inside.exchange(true) || reader_count.load() != 0) {
+                                violation_count.fetch_add(1);
+                            }
+                            counter++;
+                            writer_inside.store(false);
+                        } else {
+                            SharedScopedLock lock(mutex);
+                            reader_count.fetch_add(1);
+                            if (writer_inside.load()) {
+                                violation_count.fetch_add(1);
+                            }
+                            reader_count.fetch_sub(1);
+                        }
+                        if (j % 16 == 0) {
+                            vull::pump_work();
+                        }
+                    }
+                    latch.count_down();
+                });
+            }
+            latch.wait();
+            scheduler.stop();
+        });
+    }
+    EXPECT_THAT(violation_count.load(), is(equal_to(0u)));
+    EXPECT_THAT(counter, is(equal_to(k_tasklet_count / 4 * k_iteration_count)));
+}
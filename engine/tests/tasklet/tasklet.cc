@@ -0,0 +1,173 @@
+#include <vull/tasklet/tasklet.hh>
+
+#include <vull/container/array.hh>
+#include <vull/container/vector.hh>
+#include <vull/support/algorithm.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+#include <unistd.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+TEST_CASE(Tasklet, GuardPage) {
+    auto *tasklet = Tasklet::create();
+    ASSERT_TRUE(tasklet != nullptr);
+    const auto base = reinterpret_cast<uintptr_t>(tasklet);
+    const auto page_size = static_cast<uintptr_t>(getpagesize());
+    EXPECT_FALSE(tasklet->is_guard_page(base));
+    EXPECT_TRUE(tasklet->is_guard_page(base + page_size));
+    EXPECT_TRUE(tasklet->is_guard_page(base + page_size + 100));
+    EXPECT_FALSE(tasklet->is_guard_page(base + page_size * 2));
+}
+
+static uint32_t recurse(uint32_t depth) {
+    volatile uint8_t scratch[256];
+    scratch[0] = static_cast<uint8_t>(depth);
+    return depth == 0 ? scratch[0] : recurse(depth - 1) + scratch[0];
+}
+
+TEST_CASE(Tasklet, GrowStack) {
+    // Use far more stack than is committed up front, both one frame at a time and in one large frame.
+    uint32_t sum = 0;
+    uint32_t big_frame_sum = 0;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            Latch latch(2);
+            vull::schedule([&] {
+                sum = recurse(1500);
+                latch.count_down();
+            });
+            vull::schedule([&] {
+                volatile uint8_t scratch[524288];
+                for (uint32_t i = 0; i < sizeof(scratch); i += 4096) {
+                    scratch[i] = 1;
+                }
+                for (uint32_t i = 0; i < sizeof(scratch); i += 4096) {
+                    big_frame_sum += scratch[i];
+                }
+                latch.count_down();
+            });
+            latch.wait();
+            scheduler.stop();
+        });
+    }
+    uint32_t expected = 0;
+    for (uint32_t depth = 0; depth <= 1500; depth++) {
+        expected += depth & 0xffu;
+    }
+    EXPECT_THAT(sum, is(equal_to(expected)));
+    EXPECT_THAT(big_frame_sum, is(equal_to(128u)));
+}
+
+namespace {
+
+class DestructCounter {
+    Atomic<uint32_t> *m_count;
+
+public:
+    explicit DestructCounter(Atomic<uint32_t> &count) : m_count(&count) {}
+    DestructCounter(const DestructCounter &) = delete;
+    DestructCounter(DestructCounter &&other) : m_count(vull::exchange(other.m_count, nullptr)) {}
+    ~DestructCounter() {
+        if (m_count != nullptr) {
+            m_count->fetch_add(1);
+        }
+    }
+
+    DestructCounter &operator=(const DestructCounter &) = delete;
+    DestructCounter &operator=(DestructCounter &&) = delete;
+};
+
+} // namespace
+
+TEST_CASE(Tasklet, CapturesDestroyed) {
+    // Move-only captures, both small enough to be stored inline and too large.
+    constexpr uint32_t count = 100;
+    Atomic<uint32_t> destruct_count;
+    Atomic<uint32_t> large_sum;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            Latch latch(count * 2);
+            for (uint32_t i = 0; i < count; i++) {
+                vull::schedule([&, counter = DestructCounter(destruct_count)] {
+                    latch.count_down();
+                });
+                Array<uint8_t, 8192> large{};
+                large[8191] = 1;
+                vull::schedule([&, large, counter = DestructCounter(destruct_count)] {
+                    large_sum.fetch_add(large[8191]);
+                    latch.count_down();
+                });
+            }
+            latch.wait();
+            scheduler.stop();
+        });
+    }
+    EXPECT_THAT(destruct_count.load(), is(equal_to(count * 2)));
+    EXPECT_THAT(large_sum.load(), is(equal_to(count)));
+}
+
+TEST_CASE(Tasklet, ManyLive) {
+    // Many more tasklets than fit in a single magazine, all alive at the same time.
+    constexpr uint32_t count = 2000;
+    Atomic<uint32_t> started;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            Latch release(1);
+            Latch done(count);
+            for (uint32_t i = 0; i < count; i++) {
+                vull::schedule([&] {
+                    started.fetch_add(1);
+                    release.wait();
+                    done.count_down();
+                });
+            }
+            release.count_down();
+            done.wait();
+            scheduler.stop();
+        });
+    }
+    EXPECT_THAT(started.load(), is(equal_to(count)));
+}
+
+TEST_CASE(Tasklet, Reuse) {
+    // Tasklets run one after the other should reuse a small number of stacks.
+    Vector<uintptr_t> addresses;
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            for (uint32_t i = 0; i < 1000; i++) {
+                Latch latch(1);
+                vull::schedule([&] {
+                    addresses.push(reinterpret_cast<uintptr_t>(Tasklet::current()));
+                    latch.count_down();
+                });
+                latch.wait();
+            }
+            scheduler.stop();
+        });
+    }
+    ASSERT_THAT(addresses.size(), is(equal_to(1000u)));
+
+    vull::sort(addresses, [](uintptr_t lhs, uintptr_t rhs) {
+        return lhs > rhs;
+    });
+    uint32_t unique_count = 1;
+    for (uint32_t i = 1; i < addresses.size(); i++) {
+        if (addresses[i] != addresses[i - 1]) {
+            unique_count++;
+        }
+    }
+    EXPECT_TRUE(unique_count <= 64);
+}
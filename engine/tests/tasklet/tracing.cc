@@ -0,0 +1,123 @@
+#include <vull/tasklet/tracing.hh>
+
+#include <vull/json/parser.hh>
+#include <vull/json/tree.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/stream.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/string_view.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/tasklet/tasklet.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+class StringStream final : public Stream {
+    StringBuilder m_builder;
+
+public:
+    Result<void, StreamError> write(Span<const void> data) override {
+        m_builder.extend(StringView(static_cast<const char *>(data.data()), data.size()));
+        return {};
+    }
+
+    String build() { return m_builder.build(); }
+};
+
+} // namespace
+
+TEST_CASE(Tracing, ChromeJson) {
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            tracing::Zone zone("test zone");
+            Latch latch(16);
+            for (uint32_t i = 0; i < 16; i++) {
+                vull::schedule([&] {
+                    latch.count_down();
+                });
+            }
+            latch.wait();
+            scheduler.stop();
+        });
+    }
+
+    StringStream stream;
+    EXPECT_FALSE(tracing::write_chrome_json(stream).is_error());
+    const auto string = stream.build();
+    auto value = VULL_EXPECT(json::parse(string));
+    ASSERT_TRUE(value["traceEvents"].has<json::Array>());
+    const auto &events = VULL_ASSUME(value["traceEvents"].get<json::Array>());
+#if VULL_TRACING
+    bool found_zone = false;
+    bool found_tasklet = false;
+    for (uint32_t i = 0; i < events.size(); i++) {
+        const auto name = VULL_ASSUME(events[i]["name"].get<String>()).view();
+        found_zone |= name == "test zone";
+        found_tasklet |= name == "tasklet";
+    }
+    EXPECT_TRUE(found_zone);
+    EXPECT_TRUE(found_tasklet);
+#else
+    EXPECT_TRUE(events.empty());
+#endif
+}
+
+TEST_CASE(Tracing, SchedulerCounters) {
+    SchedulerStats stats{};
+    {
+        Scheduler scheduler(2);
+        scheduler.start([&] {
+            Latch latch(64);
+            for (uint32_t i = 0; i < 64; i++) {
+                vull::schedule([&] {
+                    latch.count_down();
+                });
+            }
+            latch.wait();
+            stats = scheduler.stats();
+            scheduler.stop();
+        });
+    }
+    // At least the root tasklet and each scheduled tasklet were scheduled and switched to. The root tasklet may also be
+    // rescheduled after waiting on the latch.
+    EXPECT_TRUE(stats.scheduled_count >= 65);
+    EXPECT_TRUE(stats.context_switch_count >= stats.scheduled_count);
+    EXPECT_THAT(stats.pool_exhausted_count, is(equal_to(0u)));
+}
+
+TEST_CASE(Tracing, InternedLabel) {
+    const char *label;
+    {
+        String name("interned zone");
+        label = tracing::intern(name);
+        tracing::Zone zone(label);
+    }
+#if VULL_TRACING
+    EXPECT_TRUE(tracing::intern(String("interned zone")) == label);
+
+    // The zone's label should still be readable after the original string is gone.
+    StringStream stream;
+    EXPECT_FALSE(tracing::write_chrome_json(stream).is_error());
+    const auto string = stream.build();
+    auto value = VULL_EXPECT(json::parse(string));
+    const auto &events = VULL_ASSUME(value["traceEvents"].get<json::Array>());
+    bool found_zone = false;
+    for (uint32_t i = 0; i < events.size(); i++) {
+        found_zone |= VULL_ASSUME(events[i]["name"].get<String>()).view() == "interned zone";
+    }
+    EXPECT_TRUE(found_zone);
+#else
+    EXPECT_TRUE(StringView(label).empty());
+#endif
+}
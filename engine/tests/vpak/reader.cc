@@ -0,0 +1,140 @@
+#include <vull/vpak/reader.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/platform/file.hh>
+#include <vull/platform/file_stream.hh>
+#include <vull/support/optional.hh>
+#include <vull/support/result.hh>
+#include <vull/support/stream.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+#include <vull/vpak/pack_file.hh>
+#include <vull/vpak/writer.hh>
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+// Spans several seekable frames, with a partial last frame.
+constexpr uint32_t k_entry_size = 300000;
+
+uint8_t pattern(uint32_t offset) {
+    return static_cast<uint8_t>((offset * 7u) ^ (offset >> 11u));
+}
+
+File create_pack(bool seekable) {
+    auto file = File::from_fd(memfd_create("vull-test", 0));
+    vpak::Writer writer(vull::make_unique<FileStream>(file.create_stream()), vpak::CompressionLevel::Fast);
+    Vector<uint8_t> data;
+    for (uint32_t i = 0; i < k_entry_size; i++) {
+        data.push(pattern(i));
+    }
+    auto entry = writer.start_entry("entry", vpak::EntryType::Blob, seekable);
+    VULL_EXPECT(entry.write(data.span()));
+    entry.finish();
+    writer.finish();
+    return file;
+}
+
+void expect_range(vpak::ReadStream &stream, uint32_t offset, uint32_t size) {
+    Vector<uint8_t> data;
+    data.ensure_size(size);
+    auto bytes_read = stream.read(data.span());
+    ASSERT_FALSE(bytes_read.is_error());
+    ASSERT_THAT(bytes_read.value(), is(equal_to(size)));
+    for (uint32_t i = 0; i < size; i++) {
+        ASSERT_THAT(data[i], is(equal_to(pattern(offset + i))));
+    }
+}
+
+void check_seeks(vpak::Reader &reader) {
+    auto stream = reader.open("entry");
+    ASSERT_TRUE(static_cast<bool>(stream));
+    expect_range(*stream, 0, k_entry_size);
+
+    // Forward past a frame boundary, backwards, and relative to the current position and the end.
+    EXPECT_THAT(VULL_EXPECT(stream->seek(200000, SeekMode::Set)), is(equal_to(200000u)));
+    expect_range(*stream, 200000, 1000);
+    EXPECT_THAT(VULL_EXPECT(stream->seek(10, SeekMode::Set)), is(equal_to(10u)));
+    expect_range(*stream, 10, 140000);
+    EXPECT_THAT(VULL_EXPECT(stream->seek(-1000, SeekMode::Add)), is(equal_to(139010u)));
+    expect_range(*stream, 139010, 5);
+    EXPECT_THAT(VULL_EXPECT(stream->seek(-16, SeekMode::End)), is(equal_to(k_entry_size - 16)));
+    expect_range(*stream, k_entry_size - 16, 16);
+    EXPECT_TRUE(stream->read_byte().is_error());
+    EXPECT_TRUE(stream->seek(1, SeekMode::End).is_error());
+}
+
+void check_read_parallel(bool seekable) {
+    vpak::Reader reader(create_pack(seekable));
+    const auto entry = *reader.stat("entry");
+    Vector<uint8_t> data;
+    data.ensure_size(k_entry_size);
+    {
+        Scheduler scheduler(4);
+        scheduler.start([&] {
+            VULL_EXPECT(reader.read_entry_parallel(entry, data.span()));
+            scheduler.stop();
+        });
+    }
+    uint32_t bad_count = 0;
+    for (uint32_t i = 0; i < k_entry_size; i++) {
+        bad_count += data[i] != pattern(i) ? 1 : 0;
+    }
+    EXPECT_THAT(bad_count, is(equal_to(0u)));
+}
+
+} // namespace
+
+TEST_CASE(VpakReader, Seek) {
+    vpak::Reader reader(create_pack(false));
+    EXPECT_FALSE(reader.stat("entry")->seekable());
+    check_seeks(reader);
+}
+
+TEST_CASE(VpakReader, SeekSeekable) {
+    vpak::Reader reader(create_pack(true));
+    EXPECT_TRUE(reader.stat("entry")->seekable());
+    check_seeks(reader);
+}
+
+TEST_CASE(VpakReader, ReadRange) {
+    vpak::Reader reader(create_pack(true));
+    const auto entry = *reader.stat("entry");
+    uint8_t data[512];
+    EXPECT_THAT(VULL_EXPECT(reader.read_range(entry, 131000, {data, sizeof(data)})), is(equal_to(512u)));
+    for (uint32_t i = 0; i < sizeof(data); i++) {
+        EXPECT_THAT(data[i], is(equal_to(pattern(131000 + i))));
+    }
+
+    // Reading past the end should give a short read.
+    EXPECT_THAT(VULL_EXPECT(reader.read_range(entry, k_entry_size - 12, {data, sizeof(data)})), is(equal_to(12u)));
+}
+
+TEST_CASE(VpakReader, ReadEntryParallel) {
+    check_read_parallel(false);
+    check_read_parallel(true);
+}
+
+TEST_CASE(VpakReader, AppendKeepsIndex) {
+    auto file = create_pack(true);
+    {
+        vpak::Writer writer(vull::make_unique<FileStream>(file.create_stream()), vpak::CompressionLevel::Fast);
+        auto entry = writer.start_entry("other", vpak::EntryType::Blob);
+        VULL_EXPECT(entry.write_byte(5));
+        entry.finish();
+        writer.finish();
+    }
+    vpak::Reader reader(vull::move(file));
+    EXPECT_TRUE(reader.stat("entry")->seekable());
+    EXPECT_FALSE(reader.stat("other")->seekable());
+    check_seeks(reader);
+}
@@ -0,0 +1,157 @@
+#include <vull/vpak/writer.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/platform/file.hh>
+#include <vull/platform/file_stream.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/stream.hh>
+#include <vull/support/string.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+#include <vull/vpak/pack_file.hh>
+#include <vull/vpak/reader.hh>
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+// Enough frames to fill the pending frame queue, with a partial last frame.
+constexpr uint32_t k_entry_size = 3000000;
+
+Vector<uint8_t> make_data() {
+    Vector<uint8_t> data;
+    data.ensure_size(k_entry_size);
+    for (uint32_t i = 0; i < k_entry_size; i++) {
+        data[i] = static_cast<uint8_t>((i * 7u) ^ (i >> 13u));
+    }
+    return data;
+}
+
+void write_pack(File &file, bool seekable, uint32_t zstd_worker_count = 0) {
+    vpak::Writer writer(vull::make_unique<FileStream>(file.create_stream()), vpak::CompressionLevel::Normal);
+    // Leaves the writer single threaded if zstd doesn't support multithreading.
+    writer.set_zstd_worker_count(zstd_worker_count);
+    auto entry = writer.start_entry("entry", vpak::EntryType::Blob, seekable);
+    VULL_EXPECT(entry.write(make_data().span()));
+    entry.finish();
+    writer.finish();
+}
+
+void write_entry(vpak::Writer &writer, String name, Span<const void> data, bool seekable) {
+    auto entry = writer.start_entry(vull::move(name), vpak::EntryType::Blob, seekable);
+    VULL_EXPECT(entry.write(data));
+    entry.finish();
+}
+
+Vector<uint8_t> read_file(const File &file) {
+    auto stream = file.create_stream();
+    Vector<uint8_t> bytes;
+    bytes.ensure_size(static_cast<uint32_t>(VULL_EXPECT(stream.seek(0, SeekMode::End))));
+    VULL_EXPECT(stream.seek(0, SeekMode::Set));
+    VULL_EXPECT(stream.read(bytes.span()));
+    return bytes;
+}
+
+void expect_entry(File &&file) {
+    vpak::Reader reader(vull::move(file));
+    const auto entry = *reader.stat("entry");
+    ASSERT_THAT(entry.size, is(equal_to(k_entry_size)));
+    Vector<uint8_t> bytes;
+    bytes.ensure_size(k_entry_size);
+    VULL_EXPECT(reader.read_entry_parallel(entry, bytes.span()));
+
+    const auto expected = make_data();
+    uint32_t bad_count = 0;
+    for (uint32_t i = 0; i < k_entry_size; i++) {
+        bad_count += bytes[i] != expected[i] ? 1 : 0;
+    }
+    EXPECT_THAT(bad_count, is(equal_to(0u)));
+}
+
+} // namespace
+
+TEST_CASE(VpakWriter, ParallelFrames) {
+    auto serial_file = File::from_fd(memfd_create("vull-test", 0));
+    write_pack(serial_file, true);
+
+    auto parallel_file = File::from_fd(memfd_create("vull-test", 0));
+    {
+        Scheduler scheduler(4);
+        scheduler.start([&] {
+            write_pack(parallel_file, true);
+            scheduler.stop();
+        });
+    }
+
+    // The frames should be committed in order, giving the same pack as a serial write.
+    const auto serial_bytes = read_file(serial_file);
+    const auto parallel_bytes = read_file(parallel_file);
+    ASSERT_THAT(parallel_bytes.size(), is(equal_to(serial_bytes.size())));
+    uint32_t mismatch_count = 0;
+    for (uint32_t i = 0; i < serial_bytes.size(); i++) {
+        mismatch_count += parallel_bytes[i] != serial_bytes[i] ? 1 : 0;
+    }
+    EXPECT_THAT(mismatch_count, is(equal_to(0u)));
+    expect_entry(vull::move(parallel_file));
+}
+
+TEST_CASE(VpakWriter, Deduplicate) {
+    const auto data = make_data();
+    auto file = File::from_fd(memfd_create("vull-test", 0));
+    {
+        vpak::Writer writer(vull::make_unique<FileStream>(file.create_stream()), vpak::CompressionLevel::Fast);
+        write_entry(writer, "a", data.span(), true);
+        write_entry(writer, "b", data.span(), true);
+
+        // Shares all but the last frame with a and b.
+        auto entry = writer.start_entry("c", vpak::EntryType::Blob, true);
+        VULL_EXPECT(entry.write({data.data(), 1000000}));
+        VULL_EXPECT(entry.write_byte(1));
+        entry.finish();
+
+        // Small entries which aren't seekable are a single frame, so can also be shared.
+        write_entry(writer, "d", {data.data(), 1000}, false);
+        write_entry(writer, "e", {data.data(), 1000}, false);
+        writer.finish();
+    }
+
+    // The fast compression level barely compresses, so a pack holding more than one copy of the data would be much
+    // bigger than this.
+    EXPECT_TRUE(read_file(file).size() < k_entry_size + 200000);
+
+    vpak::Reader reader(vull::move(file));
+    const auto a = *reader.stat("a");
+    const auto b = *reader.stat("b");
+    const auto c = *reader.stat("c");
+    EXPECT_THAT(b.first_block, is(equal_to(a.first_block)));
+    EXPECT_THAT(c.first_block, is(equal_to(a.first_block)));
+    EXPECT_THAT(reader.stat("e")->first_block, is(equal_to(reader.stat("d")->first_block)));
+
+    Vector<uint8_t> bytes;
+    bytes.ensure_size(k_entry_size);
+    VULL_EXPECT(reader.read_entry_parallel(b, bytes.span()));
+    uint32_t bad_count = 0;
+    for (uint32_t i = 0; i < k_entry_size; i++) {
+        bad_count += bytes[i] != data[i] ? 1 : 0;
+    }
+    EXPECT_THAT(bad_count, is(equal_to(0u)));
+
+    VULL_EXPECT(reader.read_entry_parallel(c, bytes.span()));
+    EXPECT_THAT(bytes[999999], is(equal_to(data[999999])));
+    EXPECT_THAT(bytes[1000000], is(equal_to(1u)));
+}
+
+TEST_CASE(VpakWriter, ZstdWorkers) {
+    auto file = File::from_fd(memfd_create("vull-test", 0));
+    write_pack(file, false, 2);
+    expect_entry(vull::move(file));
+}
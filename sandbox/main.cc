@@ -6,6 +6,8 @@
 #include <vull/core/application.hh>
 #include <vull/core/input.hh>
 #include <vull/core/window.hh>
+#include <vull/ecs/command_buffer.hh>
+#include <vull/ecs/system_graph.hh>
 #include <vull/ecs/world.hh>
 #include <vull/graphics/default_renderer.hh>
 #include <vull/graphics/deferred_renderer.hh>
@@ -21,6 +23,7 @@
 #include <vull/physics/rigid_body.hh>
 #include <vull/platform/timer.hh>
 #include <vull/scene/scene.hh>
+#include <vull/scene/transform.hh>
 #include <vull/support/args_parser.hh>
 #include <vull/support/function.hh>
 #include <vull/support/optional.hh>
@@ -30,6 +33,8 @@
 #include <vull/support/string_view.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/tasklet/tasklet.hh>
 #include <vull/ui/element.hh>
 #include <vull/ui/font.hh>
 #include <vull/ui/font_atlas.hh>
@@ -60,6 +65,9 @@
 
 using namespace vull;
 
+// CPU time for a frame, past which normal priority work also makes way for the frame's critical work.
+constexpr float k_frame_budget = 1.0f / 60.0f;
+
 static void sandbox_main(bool enable_validation, StringView scene_name) {
     Window window({}, {}, true);
     vk::Context context(enable_validation);
@@ -87,6 +95,7 @@ static void sandbox_main(bool enable_validation, StringView scene_name) {
     auto &world = scene.world();
     world.register_component<RigidBody>();
     world.register_component<Collider>();
+    world.register_group<RigidBody, Collider, Transform>();
 
     FreeCamera free_camera(window.aspect_ratio());
     free_camera.set_position(50.0f);
@@ -158,14 +167,40 @@ static void sandbox_main(bool enable_validation, StringView scene_name) {
                                                vkb::QueryPipelineStatisticFlags::FragmentShaderInvocations |
                                                vkb::QueryPipelineStatisticFlags::ComputeShaderInvocations);
 
+    // The frame loop itself is on the critical path, whereas texture streaming runs in the background.
+    Tasklet::current()->set_priority(TaskletPriority::Critical);
+    auto &scheduler = Scheduler::current();
+
+    // Physics and the camera don't share any state, so can be stepped alongside each other.
+    float dt = 0.0f;
+    EcsCommandBuffer commands;
+    SystemGraph system_graph;
+    system_graph
+        .add_system("step-physics",
+                    [&] {
+                        physics_engine.step(world, dt);
+                    })
+        .writes<RigidBody, Collider, Transform>();
+    system_graph.add_system("update-camera", [&] {
+        free_camera.update(window, dt);
+    });
+    system_graph
+        .add_system("update-transforms",
+                    [&] {
+                        scene.update_transforms(commands);
+                    })
+        .reads<Transform>()
+        .writes<WorldTransform>();
+
     Timer frame_timer;
     cpu_time_graph.new_bar();
     while (!window.should_close()) {
         Timer acquire_frame_timer;
         auto &frame = frame_pacer.request_frame();
         cpu_time_graph.push_section("acquire-frame", acquire_frame_timer.elapsed());
+        scheduler.set_frame_deadline(k_frame_budget);
 
-        float dt = frame_timer.elapsed();
+        dt = frame_timer.elapsed();
         frame_timer.reset();
 
         // Poll input.
@@ -192,13 +227,14 @@ static void sandbox_main(bool enable_validation, StringView scene_name) {
                 .set_text(vull::format(pipeline_statistics_strings[i], pipeline_statistics[i]));
         }
 
-        // Step physics.
-        Timer physics_timer;
-        physics_engine.step(world, dt);
-        cpu_time_graph.push_section("step-physics", physics_timer.elapsed());
+        system_graph.run();
+        for (const auto &system : system_graph.systems()) {
+            cpu_time_graph.push_section(system->name(), system->time());
+        }
 
-        // Update camera.
-        free_camera.update(window, dt);
+        // Sync point: apply the structural changes recorded by the systems and start a new tick for change detection.
+        commands.apply(world);
+        world.advance_tick();
 
         Timer ui_timer;
         ui::Painter ui_painter;
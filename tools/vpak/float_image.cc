@@ -15,6 +15,7 @@
 #include <vull/support/span.hh>
 #include <vull/support/stream.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/parallel.hh>
 
 #include <bc5enc.hh>
 #include <bc7enc.hh>
@@ -23,6 +24,11 @@
 namespace vull {
 namespace {
 
+// Rows of a resample and 4x4 blocks of a compression are independent, so are split up between tasklets. Each tasklet
+// handles at least this many of them.
+constexpr uint32_t k_resample_row_grain = 16;
+constexpr uint32_t k_compress_block_grain = 8;
+
 void resample_1d(const FixedBuffer<float> &source, FixedBuffer<float> &target, Vec2u source_size, uint32_t target_width,
                  uint32_t channel_count, Filter filter) {
     auto program = MadLut::instance()->lookup(source_size, target_width, filter);
@@ -32,7 +38,7 @@ void resample_1d(const FixedBuffer<float> &source, FixedBuffer<float> &target, V
         program = build_mad_program(source_size, target_width, filter);
     }
 
-    for (uint32_t row = 0; row < source_size.y(); row++) {
+    vull::parallel_for(0, source_size.y(), k_resample_row_grain, [&](uint32_t row) {
         const auto row_target_offset = row * target_width * channel_count;
         const auto row_source_offset = row * source_size.x() * channel_count;
         for (const auto &inst : program) {
@@ -43,7 +49,7 @@ void resample_1d(const FixedBuffer<float> &source, FixedBuffer<float> &target, V
                     source[row_source_offset + inst_source_offset + i] * inst.weight;
             }
         }
-    }
+    });
 }
 
 } // namespace
@@ -71,63 +77,65 @@ FloatImage FloatImage::from_unorm(Span<const uint8_t> bitmap, Vec2u size, uint32
 }
 
 Result<void, StreamError> FloatImage::block_compress_bc5(Stream &stream, FixedBuffer<float> &buffer, Vec2u size) const {
-    for (uint32_t block_y = 0; block_y < size.y(); block_y += 4) {
-        for (uint32_t block_x = 0; block_x < size.x(); block_x += 4) {
-            // 32-byte (4x4 * 2 bytes per pixel) input.
-            Array<uint8_t, 32> source_block{};
-
-            // Extract block.
-            for (uint32_t y = 0; y < 4 && block_y + y < size.y(); y++) {
-                const auto *row_data = &buffer[(block_y + y) * size.x() * m_channel_count];
-                for (uint32_t x = 0; x < 4 && block_x + x < size.x(); x++) {
-                    const auto *pixel = &row_data[(block_x + x) * m_channel_count];
-                    source_block[y * 8 + x * 2] = uint8_t(pixel[0] * 255.0f);
-                    source_block[y * 8 + x * 2 + 1] = uint8_t(pixel[1] * 255.0f);
-                }
+    const auto block_count = (size + 3u) / 4u;
+    auto compressed = FixedBuffer<uint8_t>::create_uninitialised(block_count.x() * block_count.y() * 16);
+    vull::parallel_for(0, block_count.x() * block_count.y(), k_compress_block_grain, [&](uint32_t block_index) {
+        const auto block_x = (block_index % block_count.x()) * 4;
+        const auto block_y = (block_index / block_count.x()) * 4;
+
+        // 32-byte (4x4 * 2 bytes per pixel) input.
+        Array<uint8_t, 32> source_block{};
+
+        // Extract block.
+        for (uint32_t y = 0; y < 4 && block_y + y < size.y(); y++) {
+            const auto *row_data = &buffer[(block_y + y) * size.x() * m_channel_count];
+            for (uint32_t x = 0; x < 4 && block_x + x < size.x(); x++) {
+                const auto *pixel = &row_data[(block_x + x) * m_channel_count];
+                source_block[y * 8 + x * 2] = uint8_t(pixel[0] * 255.0f);
+                source_block[y * 8 + x * 2 + 1] = uint8_t(pixel[1] * 255.0f);
             }
-
-            // 128-bit compressed block.
-            // TODO: Use encode_bc5_hq for --ultra
-            Array<uint8_t, 16> compressed_block;
-            rgbcx::encode_bc5(compressed_block.data(), source_block.data(), 0, 1, 2);
-            VULL_TRY(stream.write(compressed_block.span()));
         }
-    }
-    return {};
+
+        // 128-bit compressed block.
+        // TODO: Use encode_bc5_hq for --ultra
+        rgbcx::encode_bc5(&compressed[block_index * 16], source_block.data(), 0, 1, 2);
+    });
+    return stream.write(compressed.span());
 }
 
 Result<void, StreamError> FloatImage::block_compress_bc7(Stream &stream, FixedBuffer<float> &buffer, Vec2u size) const {
     bc7enc_compress_block_params params{};
     bc7enc_compress_block_params_init(&params);
 
-    for (uint32_t block_y = 0; block_y < size.y(); block_y += 4) {
-        for (uint32_t block_x = 0; block_x < size.x(); block_x += 4) {
-            // 64-byte (4x4 * 4 bytes per pixel) input.
-            Array<uint8_t, 64> source_block{};
-
-            // Extract block.
-            for (uint32_t y = 0; y < 4 && block_y + y < size.y(); y++) {
-                const auto *row_data = &buffer[(block_y + y) * size.x() * m_channel_count];
-                for (uint32_t x = 0; x < 4 && block_x + x < size.x(); x++) {
-                    const auto *pixel = &row_data[(block_x + x) * m_channel_count];
-                    source_block[y * 16 + x * 4] = uint8_t(pixel[0] * 255.0f);
-                    source_block[y * 16 + x * 4 + 1] = uint8_t(pixel[1] * 255.0f);
-                    source_block[y * 16 + x * 4 + 2] = uint8_t(pixel[2] * 255.0f);
-                    if (m_channel_count == 4) {
-                        source_block[y * 16 + x * 4 + 3] = uint8_t(pixel[3] * 255.0f);
-                    } else {
-                        source_block[y * 16 + x * 4 + 3] = 255;
-                    }
+    const auto block_count = (size + 3u) / 4u;
+    auto compressed = FixedBuffer<uint8_t>::create_uninitialised(block_count.x() * block_count.y() * 16);
+    vull::parallel_for(0, block_count.x() * block_count.y(), k_compress_block_grain, [&](uint32_t block_index) {
+        const auto block_x = (block_index % block_count.x()) * 4;
+        const auto block_y = (block_index / block_count.x()) * 4;
+
+        // 64-byte (4x4 * 4 bytes per pixel) input.
+        Array<uint8_t, 64> source_block{};
+
+        // Extract block.
+        for (uint32_t y = 0; y < 4 && block_y + y < size.y(); y++) {
+            const auto *row_data = &buffer[(block_y + y) * size.x() * m_channel_count];
+            for (uint32_t x = 0; x < 4 && block_x + x < size.x(); x++) {
+                const auto *pixel = &row_data[(block_x + x) * m_channel_count];
+                source_block[y * 16 + x * 4] = uint8_t(pixel[0] * 255.0f);
+                source_block[y * 16 + x * 4 + 1] = uint8_t(pixel[1] * 255.0f);
+                source_block[y * 16 + x * 4 + 2] = uint8_t(pixel[2] * 255.0f);
+                if (m_channel_count == 4) {
+                    source_block[y * 16 + x * 4 + 3] = uint8_t(pixel[3] * 255.0f);
+                } else {
+                    source_block[y * 16 + x * 4 + 3] = 255;
                 }
             }
-
-            // 128-bit compressed block.
-            Array<uint8_t, 16> compressed_block;
-            bc7enc_compress_block(compressed_block.data(), source_block.data(), &params);
-            VULL_TRY(stream.write(compressed_block.span()));
         }
-    }
-    return {};
+
+        // 128-bit compressed block.
+        bc7enc_compress_block(&compressed[block_index * 16], source_block.data(), &params);
+    });
+    return stream.write(compressed.span());
 }
 
 Result<void, StreamError> FloatImage::block_compress(Stream &stream, bool bc5) {
@@ -147,10 +155,10 @@ void FloatImage::build_mipchain(Filter filter) {
     const auto mip_count = vull::log2(vull::max(m_size.x(), m_size.y())) + 1u;
     m_mip_buffers.ensure_size(mip_count);
 
-    auto mip_size = m_size;
-    for (uint32_t mip_level = 1; mip_level < mip_count; mip_level++) {
+    // Each mip is resampled from the base level, so they can all be built at once.
+    vull::parallel_for(1, mip_count, 1, [&](uint32_t mip_level) {
         auto &buffer = m_mip_buffers[mip_level];
-        mip_size = vull::max(mip_size >> 1u, Vec2u(1u));
+        const auto mip_size = vull::max(m_size >> mip_level, Vec2u(1u));
 
         buffer = FixedBuffer<float>::create_zeroed(mip_size.x() * m_size.y() * m_channel_count);
         resample_1d(m_mip_buffers.first(), buffer, m_size, mip_size.x(), m_channel_count, filter);
@@ -176,7 +184,7 @@ void FloatImage::build_mipchain(Filter filter) {
             memcpy(dst, src, m_channel_count * sizeof(float));
         }
         buffer = vull::move(new_buffer);
-    }
+    });
 }
 
 void FloatImage::colours_to_vectors() {
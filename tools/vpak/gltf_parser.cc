@@ -25,7 +25,7 @@
 #include <vull/support/scoped_lock.hh>
 #include <vull/support/span_stream.hh>
 #include <vull/support/string_builder.hh>
-#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/future.hh>
 #include <vull/tasklet/mutex.hh>
 #include <vull/tasklet/scheduler.hh>
 #include <vull/tasklet/tasklet.hh>
@@ -85,7 +85,7 @@ public:
     Result<void, GltfParser::Error, StreamError, json::TreeError> process_scene(const json::Object &scene,
                                                                                 StringView name);
 
-    Result<void, GltfParser::Error, StreamError, json::TreeError> convert();
+    Result<void, GltfParser::Error, StreamError, json::TreeError, PngError> convert();
 };
 
 Result<Tuple<uint64_t, uint64_t>, GltfParser::Error, json::TreeError>
@@ -247,7 +247,7 @@ Converter::process_texture(TextureType type, const String &path, Optional<uint64
         float_image.drop_mips(1);
     }
 
-    auto stream = m_pack_writer.start_entry(path, vpak::EntryType::Image);
+    auto stream = m_pack_writer.start_entry(path, vpak::EntryType::Image, true);
     VULL_TRY(stream.write_byte(vull::to_underlying(vpak_format)));
     VULL_TRY(stream.write_byte(vull::to_underlying(mag_filter)));
     VULL_TRY(stream.write_byte(vull::to_underlying(min_filter)));
@@ -462,11 +462,13 @@ Converter::process_primitive(const json::Object &primitive, String &&name) {
     meshopt_optimizeVertexFetch(vertices.data(), indices.data(), indices.size(), vertices.data(), vertices.size(),
                                 sizeof(Vertex));
 
-    auto vertex_data_entry = m_pack_writer.start_entry(vull::format("/meshes/{}/vertex", name), vpak::EntryType::Blob);
+    auto vertex_data_entry =
+        m_pack_writer.start_entry(vull::format("/meshes/{}/vertex", name), vpak::EntryType::Blob, true);
     VULL_TRY(vertex_data_entry.write(vertices.span()));
     vertex_data_entry.finish();
 
-    auto index_data_entry = m_pack_writer.start_entry(vull::format("/meshes/{}/index", name), vpak::EntryType::Blob);
+    auto index_data_entry =
+        m_pack_writer.start_entry(vull::format("/meshes/{}/index", name), vpak::EntryType::Blob, true);
     VULL_TRY(index_data_entry.write(indices.span()));
     index_data_entry.finish();
 
@@ -585,26 +587,19 @@ Result<void, GltfParser::Error, StreamError, json::TreeError> Converter::process
     return {};
 }
 
-Result<void, GltfParser::Error, StreamError, json::TreeError> Converter::convert() {
+Result<void, GltfParser::Error, StreamError, json::TreeError, PngError> Converter::convert() {
     const auto &material_array = VULL_TRY(m_document["materials"].get<json::Array>());
-    Latch material_latch(material_array.size());
+    Vector<Future<void, GltfParser::Error, StreamError, json::TreeError, PngError>> material_futures;
+    material_futures.ensure_capacity(material_array.size());
     for (uint32_t i = 0; i < material_array.size(); i++) {
         const auto &material = VULL_TRY(material_array[i].get<json::Object>());
-        vull::schedule([this, &material_latch, &material, index = i] {
-            // TODO(tasklet): Need a future system to propagate errors.
-            VULL_EXPECT(process_material(material, index));
-            material_latch.count_down();
-        });
+        material_futures.push(vull::schedule_future([this, &material, index = i] {
+            return process_material(material, index);
+        }));
     }
 
     const auto &mesh_array = VULL_TRY(m_document["meshes"].get<json::Array>());
-    uint32_t total_primitive_count = 0;
-    for (uint32_t i = 0; i < mesh_array.size(); i++) {
-        const auto &primitive_array = VULL_TRY(mesh_array[i]["primitives"].get<json::Array>());
-        total_primitive_count += primitive_array.size();
-    }
-
-    Latch mesh_latch(total_primitive_count);
+    Vector<Future<void, GltfParser::Error, StreamError, json::TreeError>> mesh_futures;
     for (uint64_t i = 0; i < mesh_array.size(); i++) {
         // TODO: Spec doesn't require meshes to have a name (do what process_material does).
         const auto &mesh = VULL_TRY(mesh_array[i].get<json::Object>());
@@ -612,16 +607,25 @@ Result<void, GltfParser::Error, StreamError, json::TreeError> Converter::convert
         const auto &primitive_array = VULL_TRY(mesh["primitives"].get<json::Array>());
         for (uint64_t j = 0; j < primitive_array.size(); j++) {
             const auto &primitive = VULL_TRY(primitive_array[j].get<json::Object>());
-            vull::schedule([this, &mesh_latch, &primitive, name = vull::format("{}.{}", mesh_name, j)]() mutable {
-                // TODO(tasklet): Need a future system to propagate errors.
-                VULL_EXPECT(process_primitive(primitive, vull::move(name)));
-                mesh_latch.count_down();
-            });
+            mesh_futures.push(
+                vull::schedule_future([this, &primitive, name = vull::format("{}.{}", mesh_name, j)]() mutable {
+                    return process_primitive(primitive, vull::move(name));
+                }));
         }
     }
 
-    material_latch.wait();
-    mesh_latch.wait();
+    // On the first error, the remaining jobs are cancelled, but any already running ones still reference this
+    // converter, so everything must settle before returning.
+    auto material_result = vull::when_all(material_futures.span());
+    auto mesh_result = vull::when_all(mesh_futures.span());
+    for (const auto &future : material_futures) {
+        future.wait();
+    }
+    for (const auto &future : mesh_futures) {
+        future.wait();
+    }
+    VULL_TRY(material_result.await());
+    VULL_TRY(mesh_result.await());
     return {};
 }
 
@@ -661,7 +665,7 @@ Result<void, GltfParser::Error, StreamError> GltfParser::parse_glb() {
     return {};
 }
 
-Result<void, GltfParser::Error, StreamError, json::ParseError, json::TreeError>
+Result<void, GltfParser::Error, StreamError, json::ParseError, json::TreeError, PngError>
 GltfParser::convert(vpak::Writer &pack_writer, bool max_resolution, bool reproducible) {
     auto document = VULL_TRY(json::parse(m_json));
     if (auto generator = document["asset"]["generator"].get<String>()) {
@@ -678,14 +682,16 @@ GltfParser::convert(vpak::Writer &pack_writer, bool max_resolution, bool reprodu
     Converter converter(m_binary_blob.span(), pack_writer, document, max_resolution);
 
     // Use only one thread if reproducible, otherwise let scheduler decide.
+    Promise<void, Error, StreamError, json::TreeError, PngError> convert_promise;
+    auto convert_future = convert_promise.future();
     {
         Scheduler scheduler(reproducible ? 1 : 0);
         scheduler.start([&] {
-            // TODO(tasklet): Need a future system to propagate errors.
-            VULL_EXPECT(converter.convert());
+            convert_promise.fulfil(converter.convert());
             scheduler.stop();
         });
     }
+    VULL_TRY(convert_future.await());
 
     if (!document["scenes"]) {
         return {};
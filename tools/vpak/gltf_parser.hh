@@ -1,5 +1,7 @@
 #pragma once
 
+#include "png_stream.hh"
+
 #include <vull/container/fixed_buffer.hh>
 #include <vull/json/parser.hh> // TODO: Only need ParseError.
 #include <vull/json/tree.hh>   // TODO: Only need JsonError.
@@ -34,8 +36,8 @@ public:
         UnsupportedSparseAccessor,
     };
     Result<void, Error, StreamError> parse_glb();
-    Result<void, Error, StreamError, json::ParseError, json::TreeError> convert(vpak::Writer &pack_writer,
-                                                                                bool max_resolution, bool reproducible);
+    Result<void, Error, StreamError, json::ParseError, json::TreeError, PngError>
+    convert(vpak::Writer &pack_writer, bool max_resolution, bool reproducible);
 
     const String &json() const { return m_json; }
 };
@@ -115,6 +115,12 @@ int add(const Vector<StringView> &args) {
 
     auto vpak_file = VULL_EXPECT(vull::open_file(vpak_path, OpenMode::Create | OpenMode::Read | OpenMode::Write));
     vpak::Writer pack_writer(vull::make_unique<FileStream>(vpak_file.create_stream()), compression_level);
+
+    // Entries are written one at a time outside of a tasklet, so let zstd use every core instead.
+    const auto core_count = static_cast<uint32_t>(vull::max(sysconf(_SC_NPROCESSORS_ONLN), 1L));
+    if (!pack_writer.set_zstd_worker_count(core_count)) {
+        vull::warn("[main] zstd built without multithreading support, compressing on a single thread");
+    }
     for (auto [input_path, entry_name] : inputs) {
         auto input_file_or_error = vull::open_file(input_path, OpenMode::Read);
         if (input_file_or_error.is_error()) {
@@ -342,6 +348,7 @@ int stat(const Vector<StringView> &args) {
     }
     vull::println("Size: {} bytes (uncompressed)", entry->size);
     vull::println("Type: {}", type_string(entry->type));
+    vull::println("Seekable: {}", entry->seekable() ? "yes" : "no");
     return EXIT_SUCCESS;
 }
 